@@ -11,14 +11,27 @@
 // Silicon Labs included files
 #include "em_timer.h"
 #include "em_cmu.h"
+#include "em_core.h"
+#include "em_assert.h"
 
 
 // developer includes files
+#include "sleep_routines.h"
 
 
 //***********************************************************************************
 // defined macros
 //***********************************************************************************
+// one-shot timer service on TIMER1
+#define HW_TIMER                TIMER1              // timer peripheral backing the one-shot service
+#define HW_TIMER_CLOCK          cmuClock_TIMER1     // CMU clock of the one-shot timer
+#define HW_TIMER_IRQn           TIMER1_IRQn         // NVIC interrupt of the one-shot timer
+#define HW_TIMER_PRESCALE       timerPrescale256    // HFPER / 256: 8us ticks, ~262ms reach at 32MHz
+#define HW_TIMER_DIV            256                 // divider matching HW_TIMER_PRESCALE
+#define HW_TIMER_TOP            0xFFFF              // free running 16-bit counter
+#define HW_TIMER_MAX_TICKS      0x8000              // longest delay; keeps CCV ahead of CNT unambiguous
+#define HW_TIMER_CH_COUNT       4                   // one-shot channels, one per CC channel (TRM 19.3.2)
+#define HW_TIMER_EM             EM2                 // HFPER timers stop in EM2, block it while armed
 
 
 //***********************************************************************************
@@ -35,6 +48,10 @@
 // function prototypes
 //***********************************************************************************
 void timer_delay(uint32_t ms_delay);
+void hw_timer_open(void);
+void hw_timer_start(uint32_t ch, uint32_t us_delay, void (*expired_cb)(uint32_t ch));
+void hw_timer_cancel(uint32_t ch);
+uint32_t hw_timer_remaining(uint32_t ch);
 
 
 #endif
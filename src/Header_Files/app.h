@@ -20,21 +20,36 @@
 #include "scheduler.h"
 #include "sleep_routines.h"
 #include "si7021.h"
+#include "stats.h"
+#include "rules.h"
 
 
 //***********************************************************************************
 // defined macros
 //***********************************************************************************
-#define PWM_PER             3.0                       // PWM period in seconds
-#define PWM_ACT_PER         0.25                      // PWM active period in seconds
-#define LETIMER0_COMP0_CB   0x00000001                // 0b0000 0001
-#define LETIMER0_COMP1_CB   0x00000002                // 0b0000 0010
-#define LETIMER0_UF_CB      0x00000004                // 0b0000 0100
+#define APP_SAMPLE_PER      3.0                       // Si7021 sample period in seconds
+#define APP_POWER_LEAD      0.25                      // power gating: Si7021 power-up ahead of each sample, in seconds
+#define APP_SAMPLE_TICKS    (uint32_t)(APP_SAMPLE_PER * LETIMER_HZ)  // sample period in LETIMER0 ticks
+#define APP_POWER_TICKS     (uint32_t)(APP_POWER_LEAD * LETIMER_HZ)  // power-up lead in LETIMER0 ticks
+#define APP_POWER_ON_CB     0x00000002                // 0b0000 0010; Si7021 power-up timer
+#define APP_SAMPLE_CB       0x00000004                // 0b0000 0100; Si7021 sample timer
 #define GPIO_ODD_IRQ_CB     0x80                      // 0b1000 0000; unique odd bit for BTN1
 #define GPIO_EVEN_IRQ_CB    0x40                      // 0b0100 0000; unique even bit for BTN0
 #define SI7021_HUM_READ_CB  0x20                      // 0b0010 0000; unique read bit for Si7021 callback
 #define SI7021_WRITE_CB     0x10                      // 0b0001 0000; unique write bit for Si7021 callback
-#define RH_LED_ON           30.0                      // Comparison value to determine whether or not to ASSERT LED1
+#define RH_LED_ON           3000                      // RH (0.01 %RH) at which LED1 is asserted
+#define RH_LED_HYST         100                       // LED1 is de-asserted once RH falls 1.00 %RH below RH_LED_ON
+#define APP_CH_RH           0                         // rule channel: relative humidity (0.01 %RH)
+#define APP_CH_T            1                         // rule channel: temperature (0.01 C)
+#define APP_RULE_LED1       0                         // rule table entry driving LED1 from RH
+#define APP_RULE_COUNT      1                         // entries in the rule table
+#define APP_SI7021_RES      si7021_res_rh8_t12        // 0.5 %RH steps are ample for the RH_LED_ON threshold; 6.9 ms conversions
+// Si7021 power gating: compiler directive to power the sensor down after each
+// sample and back up APP_POWER_LEAD ahead of the next one.
+// The power-up surge outweighs the sensor's standby current below sample
+// periods of roughly 20-340 s at 25 C, so it is off for the 3 s APP_SAMPLE_PER
+//#define APP_SI7021_POWER_GATING
+#define APP_RH_EWMA_SHIFT   3                         // RH EWMA weight 1/8: ~24 s time constant at one sample per 3 s
 
 //***********************************************************************************
 // enums
@@ -50,11 +65,10 @@
 // function prototypes
 //***********************************************************************************
 void app_peripheral_setup(void);
-void scheduled_letimer0_uf_cb(void);
-void scheduled_letimer0_comp0_cb(void);
-void scheduled_letimer0_comp1_cb(void);
-void scheduled_gpio_even_irq_cb(void);
-void scheduled_gpio_odd_irq_cb(void);
+void scheduled_sample_cb(void);
+void scheduled_power_on_cb(void);
+void scheduled_gpio_even_irq_cb(const SCHEDULER_EVENT_STRUCT *event);
+void scheduled_gpio_odd_irq_cb(const SCHEDULER_EVENT_STRUCT *event);
 void scheduled_si7021_hum_read_cb(void);
 
 #endif
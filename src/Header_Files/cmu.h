@@ -19,6 +19,9 @@
 //***********************************************************************************
 // defined macros
 //***********************************************************************************
+// core cycle counter (DWT CYCCNT, ARMv7-M ARM C1.8.8); free running, wraps every 2^32 cycles
+#define CMU_CYCLES()        (DWT->CYCCNT)
+#define CMU_HZ_PER_MHZ      1000000                 // core clock Hz per cycle-per-us
 
 
 //***********************************************************************************
@@ -35,6 +38,8 @@
 // function prototypes
 //***********************************************************************************
 void cmu_open(void);
+uint32_t cmu_us_to_cycles(uint32_t us);
+uint32_t cmu_cycles_to_us(uint32_t cycles);
 
 
 #endif
@@ -15,9 +15,11 @@
 // developer included files
 #include "cmu.h"
 #include "sleep_routines.h"
-#include "si7021.h"
-#include "app.h"
+#include "scheduler.h"
+#include "brd_config.h"
+#include "ldma.h"
 #include "HW_delay.h"
+#include "letimer.h"
 
 
 //***********************************************************************************
@@ -36,26 +38,88 @@
 #define I2C_BUS_BUSY      true                        // Set when bus is busy
 // I2C State Machine transit buffer [txdata]
 #define I2C_ADDR_RW_SHIFT 1                           // Left shift addr before or'ing r/w bit
+#define I2C_READ_BIT      0x01                        // READ BIT = 1 (UM10204 3.1.10)
+#define I2C_WRITE_BIT     0x00                        // WRITE BIT = 0 (UM10204 3.1.10)
 // I2C data bytes [data]
 #define MSBYTE_SHIFT      0X08                        // Left shift a byte in data register to accept another byte as LSB
-#define READ_2_BYTES      2                           // number of bytes expected for a read
+// I2C interrupts
+#define I2C_IEN_MASK      (I2C_IEN_ACK | I2C_IEN_NACK | I2C_IEN_RXDATAV | I2C_IEN_MSTOP | I2C_IEN_CLTO) // state machine interrupt sources
+// I2C transaction queue
+#define I2C_QUEUE_DEPTH   8                           // pending transactions per I2Cn peripheral (power of 2)
+#define I2C_QUEUE_MASK    (I2C_QUEUE_DEPTH - 1)       // wrap mask for queue indexes
+// I2C LDMA mode: compiler directive to move multi-byte TXDATA/RXDATA traffic to LDMA.
+// The host simulator runs it (test_i2c_ldma), but it stays off until it has
+// been checked on the board: a logic analyzer capture of the last-byte NACK
+// of Si7021 reads at 100 and 400 kHz, with the LDMA done interrupt held off
+// by another interrupt, and a soak of the application with both masters
+// moving their transfers on the LDMA at once
+//#define I2C_LDMA_MODE
+
+#ifdef I2C_LDMA_MODE
+  #define I2C_LDMA_MIN_BYTES        4                 // shortest phase (bytes) worth handing to the LDMA
+  #define I2C_LDMA_RX_CPU_BYTES     2                 // bytes at the end of a read left to the CPU (ACK, then NACK)
+  #define I2C_LDMA_DESCS            2                 // descriptors per transfer: bytes, then the CTRL write
+  #define I2C_LDMA_RX_CH(n)         (2 * (n))         // LDMA channel servicing I2Cn RXDATA
+  #define I2C_LDMA_TX_CH(n)         (2 * (n) + 1)     // LDMA channel servicing I2Cn TXDATA
+  #define I2C_LDMA_CH_INSTANCE(ch)  ((ch) >> 1)       // I2Cn instance owning an LDMA channel
+#endif
+// I2C instances
+#define I2C_INSTANCE_STRIDE   ((uintptr_t)I2C1 - (uintptr_t)I2C0)                   // register block spacing (RM 4.2 memory map)
+#define I2C_INSTANCE_NUM(i2c) (((uintptr_t)(i2c) - (uintptr_t)I2C0) / I2C_INSTANCE_STRIDE) // I2Cn -> n without comparisons
+// I2C bus speed profiles
+#define I2C_PROFILE_LEVELS      3                     // speed levels per profile; each derated level halves the frequency
+#define I2C_PROFILE_REFFREQ     0                     // reference clock for CLKDIV: 0 uses the current HFPER frequency
+#define I2C_DERATE_CLHR         i2cClockHLRStandard   // CLHR of derated levels: 4:4 has the most margin (TRM 16.3.7.5)
+#define I2C_DERATE_ERRORS       3                     // consecutive failed transactions before a profile derates
+// I2C performance counters: compiler directive to count bus events, time
+// interrupts with the DWT cycle counter and transactions with the LETIMER0
+// time base (letimer_timer_open() must have been called). Costs one counter
+// update per event and two time reads per interrupt and per transaction
+//#define I2C_PERF_COUNTERS
+
+#ifdef I2C_PERF_COUNTERS
+  #define I2C_PERF_BINS         16                    // log2 histogram bins; bin n counts values in [2^n, 2^(n+1))
+#endif
 // I2C Energy Modes
 #define I2C_EM_BLOCK      EM2                         // I2C Cannot go below EM2
-// I2C Timer Delays
-#define I2C_80MS_DELAY    80                          // 80ms Delay for user with Timer delay to avoid RWM sync issues
+// I2C status polling
+#define I2C_TXBL_TIMEOUT  1000                        // max STATUS reads while waiting for TXBL before asserting
+// I2C NACK retry
+#define I2C_NACK_BACKOFF_US     1000                  // delay before the first retry after a NACK (us)
+#define I2C_NACK_BACKOFF_MAX_US 16000                 // backoff doubles per retry up to this delay (us)
+#define I2C_RETRY_TIMER_CH(n)   (n)                   // HW_delay one-shot channel timing I2Cn retries
+#define I2C_RETRY_TIMER_INSTANCE(ch) (ch)             // I2Cn instance owning a one-shot channel
+// I2C bus recovery (UM10204 3.1.16)
+#define I2C_RECOVERY_CLOCKS     9                     // SCL pulses to free a slave holding SDA low
+#define I2C_RECOVERY_HALF_US    5                     // half SCL period while bit-banging (100 kHz)
+#define I2C_RECOVERY_STRETCH_US 1000                  // max time a slave may hold SCL low during recovery
+#define I2C_RESET_TIMEOUT_US    1000                  // max wait for MSTOP after a bus reset
+#define I2C_CLTO                I2C_CTRL_CLTO_1024PCC // default clock low timeout: fail a transfer wedged by a held SCL
 
 //***********************************************************************************
 // enums
 //***********************************************************************************
 typedef enum
 {
-  req_res,          /* Request resource: Send 7-bit slave addr + r/w-bit (TRM 16.3.7.6: 0x57) */
-  command_tx,       /* Transmit command to device (TRM 16.3.7.6: 0x97)*/
-  data_req,         /* Send data request  (TRM 16.3.7.6: 0xD7) */
-  data_rx,          /* Data received (TRM 16.3.7.6)*/
+  req_res,          /* Request resource: Send 7-bit slave addr + w-bit (TRM 16.3.7.6: 0x57) */
+  command_tx,       /* Transmit tx buffer to device (TRM 16.3.7.6: 0x97)*/
+  data_req,         /* Send data request: 7-bit slave addr + r-bit (TRM 16.3.7.6: 0xD7) */
+  data_rx,          /* Data received into rx buffer (TRM 16.3.7.6)*/
   m_stop,           /* STOP bit sent */
+  nack_stop,        /* STOP bit sent after the slave NACKed */
+  retry_wait,       /* Bus released; waiting out the backoff before retrying */
 }I2C_MACHINE_STATES_Typedef;
 
+// I2C transaction completion status
+typedef enum
+{
+  i2c_status_idle,      /* Descriptor has never been submitted */
+  i2c_status_pending,   /* Transaction is queued or running and has not completed */
+  i2c_status_ok,        /* Transaction completed; all bytes transferred */
+  i2c_status_nack,      /* Transaction abandoned; slave still NACKing after every retry */
+  i2c_status_bus_error, /* Transaction abandoned; SCL held low, bus recovered */
+}I2C_STATUS_Typedef;
+
 //***********************************************************************************
 // structs
 //***********************************************************************************
@@ -71,24 +135,122 @@ typedef struct
   uint32_t              sda_loc0; // SDA route to GPIO port/pin
   uint32_t              scl_pen;  // enable SCL pin
   uint32_t              sda_pen;  // enable SDA pin
+  GPIO_Port_TypeDef     scl_port; // SCL GPIO port, bit-banged during bus recovery
+  uint32_t              scl_pin;  // SCL GPIO pin
+  GPIO_Port_TypeDef     sda_port; // SDA GPIO port, sampled during bus recovery
+  uint32_t              sda_pin;  // SDA GPIO pin
+  uint32_t              clto;     // clock low timeout (I2C_CLTO; I2C_CTRL_CLTO_OFF for long clock stretching)
 }I2C_OPEN_STRUCT;
 
 
+// I2C bus speed setting: register values precomputed by i2c_profile_init()
+typedef struct
+{
+    uint32_t                      clkdiv;                 // CLKDIV register value
+    uint32_t                      clhr;                   // CTRL.CLHR field, in place
+}I2C_SPEED_STRUCT;
+
+
+// I2C bus speed profile for one device (or group of devices). Level 0 is
+// the requested speed; the profile steps down a level after repeated errors
+typedef struct
+{
+    I2C_SPEED_STRUCT              level[I2C_PROFILE_LEVELS]; // fastest first
+    volatile uint32_t             level_now;              // level currently in use
+    volatile uint32_t             error_run;              // consecutive failed transactions at this level
+}I2C_PROFILE_STRUCT;
+
+
+// I2C transaction descriptor. Describes any write, read or write-then-read
+// transaction; owned by the caller and must outlive the transaction
+typedef struct I2C_TRANSACTION
+{
+    uint32_t                      slave_addr;             // 7-bit address of the slave device
+    const uint8_t                *tx_buf;                 // bytes to write to the slave (NULL when tx_len is 0)
+    uint32_t                      tx_len;                 // number of bytes to write
+    uint8_t                      *rx_buf;                 // buffer for bytes read from the slave (NULL when rx_len is 0)
+    uint32_t                      rx_len;                 // number of bytes to read
+    bool                          repeated_start;         // true: repeated START between write and read; false: STOP then START
+    uint32_t                      i2c_cb;                 // I2C call back event to request upon completion (0 for none)
+    uint32_t                      nack_retries;           // times to retry the transaction after a NACK before failing it
+    void                        (*done_cb)(struct I2C_TRANSACTION *txn); // called from the I2Cn IRQ on completion (NULL for none)
+    I2C_PROFILE_STRUCT           *profile;                // bus speed profile (NULL for the bus default set at open)
+    volatile I2C_STATUS_Typedef   status;                 // completion status, written by the state machine
+}I2C_TRANSACTION_STRUCT;
+
+
+#ifdef I2C_PERF_COUNTERS
+// I2C performance counters of one I2Cn peripheral; read with i2c_perf_snapshot()
+typedef struct
+{
+    uint32_t                      txn_ok;                 // transactions completed
+    uint32_t                      txn_nack;               // transactions failed after all NACK retries
+    uint32_t                      txn_bus_error;          // transactions failed by a clock low timeout
+    uint32_t                      queue_full;             // submissions rejected by a full queue
+    uint32_t                      nacks;                  // NACKs received
+    uint32_t                      retries;                // NACK retries scheduled
+    uint32_t                      derates;                // speed profile derates
+    uint32_t                      recoveries;             // bus recoveries run
+    uint32_t                      isr_count;              // I2Cn interrupts serviced
+    uint32_t                      isr_max_cycles;         // longest I2Cn interrupt (core cycles)
+    uint32_t                      txn_max_ticks;          // longest transaction, start to completion (LETIMER_HZ ticks)
+    uint32_t                      isr_hist[I2C_PERF_BINS]; // I2Cn interrupt duration, log2 core cycles
+    uint32_t                      txn_hist[I2C_PERF_BINS]; // transaction duration incl. retry backoff and sleep, log2 LETIMER_HZ ticks
+}I2C_PERF_STRUCT;
+#endif
+
+
+// I2C struct describing the fixed resources of one I2Cn peripheral.
+// Instantiated as a private const table in i2c.c
+typedef struct
+{
+    I2C_TypeDef                  *I2Cn;                   // pointer to I2C peripheral (I2C0 or I2C1)
+    CMU_Clock_TypeDef             clock;                  // I2Cn CMU clock
+    IRQn_Type                     irqn;                   // I2Cn NVIC interrupt
+#ifdef I2C_LDMA_MODE
+    uint32_t                      ldma_rx_ch;             // LDMA channel for RXDATA
+    uint32_t                      ldma_tx_ch;             // LDMA channel for TXDATA
+    LDMA_PeripheralSignal_t       ldma_rx_signal;         // RXDATAV request signal
+    LDMA_PeripheralSignal_t       ldma_tx_signal;         // TXBL request signal
+#endif
+}I2C_INSTANCE_STRUCT;
+
+
 // I2C struct for managing the I2C state machine. Instantiated as a private
-// data struct in i2c.c
+// data table in i2c.c, one entry per I2Cn peripheral
 typedef struct
 {
+    const I2C_INSTANCE_STRUCT    *inst;                   // fixed resources of this peripheral
+    GPIO_Port_TypeDef             scl_port;               // SCL GPIO port, for bus recovery
+    uint32_t                      scl_pin;                // SCL GPIO pin
+    GPIO_Port_TypeDef             sda_port;               // SDA GPIO port, for bus recovery
+    uint32_t                      sda_pin;                // SDA GPIO pin
     I2C_TypeDef                  *I2Cn;                   // pointer to I2C peripheral (I2C0 or I2C1)
     I2C_MACHINE_STATES_Typedef    curr_state;             // tracks the current state of the state machine
-    uint32_t                      slave_addr;             // pointer to the address of slave device currently being communicated with
-    volatile uint32_t             tx_cmd;                 // transmit command register
-    uint32_t                      r_w;                    // set read/write bit
     volatile bool                 busy;                   // True when bus is busy; False when bus is available
     volatile const uint32_t      *rxdata;                 // pointer to receiver buffer address
     volatile uint32_t            *txdata;                 // pointer to transmit buffer address
-    volatile uint16_t            *data;                   // store state machine received/transmit data
-    uint32_t                      num_bytes;              // number of bytes expected
-    uint32_t                      i2c_cb;                 // I2C call back event to request upon completion of I2C operation
+    I2C_TRANSACTION_STRUCT       *txn;                    // transaction currently being run
+    I2C_PROFILE_STRUCT           *profile;                // speed profile of the current transaction
+    uint32_t                      tx_index;               // number of tx_buf bytes sent
+    uint32_t                      rx_index;               // number of rx_buf bytes received
+    uint32_t                      retries_left;           // NACK retries remaining for the current transaction
+    uint32_t                      backoff_us;             // delay before the next NACK retry (us)
+    I2C_TRANSACTION_STRUCT       *queue[I2C_QUEUE_DEPTH]; // transactions waiting for the bus
+    uint32_t                      q_head;                 // index of the oldest queued transaction
+    uint32_t                      q_count;                // number of queued transactions
+    uint32_t                      recovery_count;         // number of bus recoveries run
+    uint32_t                      recovery_us;            // duration of the last bus recovery (us)
+    bool                          isolated;               // True while SCL/SDA are disconnected by i2c_pins_enable()
+    uint32_t                      route_pen;              // SCL/SDA ROUTEPEN bits to restore when the pins are reconnected
+#ifdef I2C_PERF_COUNTERS
+    I2C_PERF_STRUCT               perf;                   // performance counters
+    uint32_t                      txn_start;              // letimer_timer_now() when the current transaction started
+#endif
+#ifdef I2C_LDMA_MODE
+    bool                          ldma_active;            // True while an LDMA channel is moving the current phase
+    LDMA_Descriptor_t             ldma_desc[I2C_LDMA_DESCS]; // descriptor chain of the running transfer
+#endif
 }I2C_STATE_MACHINE_STRUCT;
 
 
@@ -96,7 +258,12 @@ typedef struct
 // function prototypes
 //***********************************************************************************
 void i2c_open(I2C_TypeDef *i2c, I2C_OPEN_STRUCT *app_i2c_struct);
-void i2c_init_sm(I2C_TypeDef *i2c, uint32_t slave_addr, uint32_t r_w,
-               volatile uint16_t *read_result, uint32_t si7021_cb);
+bool i2c_init_sm(I2C_TypeDef *i2c, I2C_TRANSACTION_STRUCT *txn);
+void i2c_profile_init(I2C_TypeDef *i2c, I2C_PROFILE_STRUCT *profile, uint32_t freq, I2C_ClockHLR_TypeDef clhr);
+void i2c_recovery_get(I2C_TypeDef *i2c, uint32_t *count, uint32_t *last_us);
+void i2c_pins_enable(I2C_TypeDef *i2c, bool enable);
+#ifdef I2C_PERF_COUNTERS
+void i2c_perf_snapshot(I2C_TypeDef *i2c, I2C_PERF_STRUCT *snapshot, bool reset);
+#endif
 
 #endif
@@ -0,0 +1,44 @@
+#ifndef LDMA_HG
+#define LDMA_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdbool.h>
+#include <stddef.h>
+
+// Silicon Labs included files
+#include "em_ldma.h"
+#include "em_assert.h"
+
+// developer included files
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define LDMA_CH_COUNT     DMA_CHAN_COUNT      // number of LDMA channels (EFM32PG12 DS 3.10)
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void ldma_open(void);
+void ldma_start(uint32_t ch, const LDMA_TransferCfg_t *cfg,
+                const LDMA_Descriptor_t *desc, void (*done_cb)(uint32_t ch));
+void ldma_stop(uint32_t ch);
+
+
+#endif
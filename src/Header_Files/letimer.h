@@ -32,6 +32,10 @@
 #define REP0                0x00      // repeat0 set value
 #define REP1                0x01      // repeat1 set value
 #define REP_PWM_MODE        0x01      // repeat set PWM mode
+#define LETIMER_TIMER_MAX       8                         // software timers armed at once
+#define LETIMER_TIMER_SYNC_TICKS 3                        // LFCLK cycles a COMP1 write takes to reach the counter
+#define LETIMER_TIMER_MIN_TICKS (LETIMER_TIMER_SYNC_TICKS + 1) // nearest compare armed ahead of CNT, so the write lands first
+#define LETIMER_TIMER_HORIZON   (_LETIMER_CNT_MASK >> 1)  // farthest compare armed; the tick count is resynchronized at least this often
 
 
 //***********************************************************************************
@@ -60,12 +64,35 @@ typedef struct {
 	uint32_t    uf_cb;                // underflow callback register
 } APP_LETIMER_PWM_TypeDef ;
 
+// one software timer on the LETIMER0 time base; owned by the caller
+typedef struct
+{
+    uint32_t    deadline;             // tick of the next expiry
+    uint32_t    period;               // ticks between expiries (0 for one-shot)
+    uint32_t    cb;                   // callback event scheduled at each expiry
+    uint32_t    slot;                 // deadline heap position + 1 while armed; 0 when idle
+} LETIMER_TIMER_STRUCT;
+
+// LETIMER0 wakeup counters; read with letimer_wake_snapshot()
+typedef struct
+{
+    uint32_t    wakeups;              // LETIMER0 interrupts serviced
+    uint32_t    expiries;             // software timer expiries
+    uint32_t    idle_wakeups;         // COMP1 matches that expired no timer (horizon, or a cancelled deadline)
+    uint32_t    comp1_writes;         // COMP1 reprogrammed
+} LETIMER_WAKE_STRUCT;
+
 
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
 void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_letimer_struct);
 void letimer_start(LETIMER_TypeDef *letimer, bool enable);
+void letimer_timer_open(LETIMER_TypeDef *letimer, bool debug_run);
+uint32_t letimer_timer_now(void);
+void letimer_timer_start(LETIMER_TIMER_STRUCT *timer, uint32_t delay, uint32_t period, uint32_t cb);
+void letimer_timer_cancel(LETIMER_TIMER_STRUCT *timer);
+void letimer_wake_snapshot(LETIMER_WAKE_STRUCT *snapshot, bool reset);
 
 
 #endif
@@ -0,0 +1,66 @@
+#ifndef RULES_HG
+#define RULES_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Silicon Labs included files
+#include "em_assert.h"
+
+
+// developer included files
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+// direction in which a rule's value becomes active
+typedef enum
+{
+  rule_rising,              /* active at or above threshold; inactive below threshold - hysteresis */
+  rule_falling,             /* active at or below threshold; inactive above threshold + hysteresis */
+}RULE_DIRECTION_Typedef;
+
+// state of a rule
+typedef enum
+{
+  rule_state_unknown,       /* no value evaluated yet; the first value always fires the action */
+  rule_state_inactive,      /* value is on the inactive side of the band */
+  rule_state_active,        /* value is on the active side of the band */
+}RULE_STATE_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+// one threshold rule; integer values in the units of its channel
+typedef struct
+{
+    uint32_t                channel;                // sample stream the rule watches
+    RULE_DIRECTION_Typedef  direction;              // side of the threshold that is active
+    int32_t                 threshold;              // value at which the rule becomes active
+    int32_t                 hysteresis;             // band the value must cross back through to release
+    void                  (*action)(bool active);   // called on each state transition only
+    RULE_STATE_Typedef      state;                  // current state, maintained by rules_eval()
+}RULE_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void rules_init(RULE_STRUCT *rules, uint32_t count);
+void rules_eval(RULE_STRUCT *rules, uint32_t count, uint32_t channel, int32_t value);
+
+
+#endif
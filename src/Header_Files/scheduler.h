@@ -6,21 +6,30 @@
 // Include files
 //***********************************************************************************
 // system included files
+#include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 
 
 // Silicon Labs included files
 #include "em_assert.h"
+#include "em_device.h"
 #include "em_core.h"
 #include "em_emu.h"
 
 // developer included files
+#include "cmu.h"
 
 
 //*******************************************************
 // defined macros
 //*******************************************************
-#define CLEAR_SCHEDULED_EVENTS           (uint32_t)(0x00); // mask to clear all scheduled events
+#define CLEAR_SCHEDULED_EVENTS           (uint32_t)(0x00)  // mask to clear all scheduled events
+#define SCHEDULER_EVENTS                 32                // one event per bit of the event mask
+#define SCHEDULER_EVENT_BIT(events)      (31 - __CLZ(events)) // highest set bit: the highest priority pending event
+#define SCHEDULER_QUEUE_DEPTH            16                // queued events held at once (power of 2)
+#define SCHEDULER_QUEUE_MASK             (SCHEDULER_QUEUE_DEPTH - 1) // wrap mask for queue positions
 
 
 //***********************************************************************************
@@ -31,6 +40,28 @@
 //***********************************************************************************
 // structs
 //***********************************************************************************
+// one queued event; posted with scheduler_post(), never coalesced
+typedef struct
+{
+    uint32_t                event;                  // event bit, as passed to add_scheduled_event()
+    uint32_t                payload;                // event data; its meaning is set by the event
+    uint32_t                timestamp;              // CMU_CYCLES() when posted
+}SCHEDULER_EVENT_STRUCT;
+
+// one slot of the event queue
+typedef struct
+{
+    atomic_uint             seq;                    // queue position the slot is free for, or position + 1 once filled
+    SCHEDULER_EVENT_STRUCT  event;                  // queued event
+}SCHEDULER_SLOT_STRUCT;
+
+// event queue counters; read with scheduler_queue_snapshot()
+typedef struct
+{
+    uint32_t                posted;                 // events queued
+    uint32_t                overflows;              // events dropped by a full queue
+    uint32_t                high_water;             // most events queued at once
+}SCHEDULER_QUEUE_STRUCT;
 
 
 //***********************************************************************************
@@ -40,6 +71,11 @@ void scheduler_open(void);
 void add_scheduled_event(uint32_t event);
 void remove_scheduled_event(uint32_t event);
 uint32_t get_scheduled_events(void);
+void scheduler_register(uint32_t event, void (*handler)(void));
+void scheduler_register_queued(uint32_t event, void (*handler)(const SCHEDULER_EVENT_STRUCT *event));
+bool scheduler_post(uint32_t event, uint32_t payload);
+bool scheduler_dispatch(void);
+void scheduler_queue_snapshot(SCHEDULER_QUEUE_STRUCT *snapshot, bool reset);
 
 
 #endif
@@ -9,9 +9,11 @@
 // included files
 //***********************************************************************************
 // system included files
+#include <stddef.h>
 
 
 // Silicon Labs included files
+#include "em_gpio.h"
 
 
 // developer included files
@@ -22,13 +24,74 @@
 //***********************************************************************************
 // defined macros
 //***********************************************************************************
-#define DELAY80MS              0X50     // 80ms delay for [worst case] timer delay (DS Table 2 (cont.) pg 5)
+#define SI7021_POWERUP_US      80000    // power-up time, worst case over temperature (DS Table 2 (cont.) pg 5)
 #define REFFREQ                0X00     // Set to zero to use I2C frequency
 #define SI7021_ADDR            0x40     // Si7021 peripheral device address
 #define SI7021_I2C_READ        0X01     // READ BIT = 1; Si7021 TRM 5.1
 #define SI7021_I2C_WRITE       0X00     // WRITE BIT = 0; Si7021 TRM 5.1
-#define SI7021_I2C_IEN_MASK    0x1E0    // Enable ACK, NACK, RXDATAV and MSTOP interrupt flags
-#define RESET_READ_RESULT      0        // Use when resetting the read_result static variable
+#define SI7021_CMD_BYTES       1        // command bytes written ahead of a read
+#define SI7021_TX_BYTES        2        // size of the transmit buffer (command + register value)
+#define SI7021_RH_BYTES        2        // RH measurement bytes: MS byte, LS byte (Si7021 TRM 5.1)
+// Si7021 checksum: compiler directive to read and verify the CRC byte of every RH measurement
+#define SI7021_CRC_CHECK
+#define SI7021_CRC_POLY        0x31     // x^8 + x^5 + x^4 + 1, initialized to 0x00 (Si7021-A20 DS 5.1)
+
+#ifdef SI7021_CRC_CHECK
+  #define SI7021_RH_READ_BYTES (SI7021_RH_BYTES + 1) // MS byte, LS byte, checksum
+#else
+  #define SI7021_RH_READ_BYTES SI7021_RH_BYTES       // MS byte, LS byte
+#endif
+#define SI7021_T_BYTES         2        // T measurement bytes: MS byte, LS byte (Si7021 TRM 5.1.2)
+#define SI7021_FREQ            I2C_FREQ_FAST_MAX      // Si7021 bus speed profile: 400 kHz max (Si7021-A20 DS Table 3)
+#define SI7021_CLHR            i2cClockHLRAsymetric   // 6:3 meets the fast-mode low/high times (TRM 16.3.7.5)
+#define SI7021_NACK_RETRIES    5        // NACK retries for command writes (1+2+4+8+16 ms of backoff)
+#define SI7021_FETCH_RETRIES   2        // NACK retries for a result fetch; the conversion has already elapsed
+#define SI7021_PROBE_RETRIES   1        // NACK retries of the identity probe; the sensor has already powered up
+// Si7021 code conversion in fixed point: hundredths of %RH / degC (Si7021-A20 DS 5.1.1, 5.1.2)
+#define SI7021_CODE_SHIFT      16       // formulas divide the 16-bit code by 65536
+#define SI7021_RH_CENTI_SCALE  12500    // 125 %RH in hundredths
+#define SI7021_RH_CENTI_OFFSET 600      // 6 %RH in hundredths
+#define SI7021_T_CENTI_SCALE   17572    // 175.72 degC in hundredths
+#define SI7021_T_CENTI_OFFSET  4685     // 46.85 degC in hundredths
+// Si7021 user register 1 (Si7021-A20 DS 6.1)
+#define SI7021_REG1_RESET      0x3A     // power-up value: 12-bit RH, 14-bit T, heater off
+#define SI7021_REG1_RES_MASK   0x81     // measurement resolution: RES1 (D7), RES0 (D0)
+#define SI7021_REG1_BYTES      2        // write_reg1 command + register value
+#define SI7021_RES_COUNT       4        // measurement resolutions
+#define SI7021_RES_INDEX(res)  ((((res) >> 6) & 0x02) | ((res) & 0x01)) // RES1:RES0 -> 0..3
+// Si7021 electronic serial number and firmware revision (Si7021-A20 DS 5.5, 5.6)
+#define SI7021_ID_CMD_BYTES    2        // every identity read starts with a 2 byte command
+#define SI7021_SNA_READ_BYTES  8        // SNA_3, CRC, SNA_2, CRC, SNA_1, CRC, SNA_0, CRC
+#define SI7021_SNA_STRIDE      2        // one serial byte per checksum
+#define SI7021_SNB_READ_BYTES  6        // SNB_3, SNB_2, CRC, SNB_1, SNB_0, CRC
+#define SI7021_SNB_STRIDE      3        // two serial bytes per checksum
+#define SI7021_FW_READ_BYTES   1        // firmware revision
+#define SI7021_DEV_SI7013      0x0D     // SNB_3 device identification
+#define SI7021_DEV_SI7020      0x14
+#define SI7021_DEV_SI7021      0x15
+#define SI7021_DEV_ENG_0       0x00     // engineering samples
+#define SI7021_DEV_ENG_1       0xFF
+#define SI7021_FW_1_0          0xFF     // firmware revision 1.0
+#define SI7021_FW_2_0          0x20     // firmware revision 2.0
+// Si7021 capabilities, derived from the device identification
+#define SI7021_CAP_RH          0x01     // relative humidity measurement
+#define SI7021_CAP_T           0x02     // temperature measurement
+#define SI7021_CAP_HEATER      0x04     // on-chip heater
+#define SI7021_CAP_THERMISTOR  0x08     // external thermistor input (Si7013)
+#define SI7021_TIMER_CH        2        // HW_delay one-shot channel timing conversions of every sensor
+#define SI7021_POWER_TIMER_CH  3        // HW_delay one-shot channel timing the power-up of the sensors
+// Si7021 sensor registry
+#define SI7021_SENSOR_MAX      4        // registered sensors, across all I2Cn peripherals
+#define SI7021_TXN_SENSOR(txn) ((SI7021_SENSOR_STRUCT *)((uint8_t *)(txn) - offsetof(SI7021_SENSOR_STRUCT, txn)))
+// Si7021 measurement mode: compiler directive to use Hold Master Mode, where the
+// sensor stretches SCL through the conversion instead of a timed fetch
+//#define SI7021_HOLD_MASTER
+
+#ifdef SI7021_HOLD_MASTER
+  #define SI7021_CLTO          I2C_CTRL_CLTO_OFF        // SCL is held low for the whole conversion
+#else
+  #define SI7021_CLTO          I2C_CLTO                 // default clock low timeout
+#endif
 
 
 //***********************************************************************************
@@ -55,17 +118,96 @@ typedef enum
   reset                 = 0xFE  /* Reset */
 }SI7021_I2C_COMMAND_Typedef;
 
+// Si7021 result of the latest measurement
+typedef enum
+{
+  si7021_status_ok,         /* Latest measurement is valid */
+  si7021_status_bus_error,  /* Sensor did not answer; values are from an earlier measurement */
+  si7021_status_crc_error,  /* Checksum mismatch; sample discarded, values are from an earlier measurement */
+  si7021_status_absent,     /* Identity probe failed at open; the sensor is never addressed again */
+}SI7021_STATUS_Typedef;
+
+// Si7021 result of the open-time identity probe
+typedef enum
+{
+  si7021_probe_pending,     /* Probe queued or in progress */
+  si7021_probe_ok,          /* Supported part identified; identity cached */
+  si7021_probe_absent,      /* No answer on the bus */
+  si7021_probe_invalid,     /* Identity checksum mismatch */
+  si7021_probe_unsupported, /* Answered with an unknown device identification */
+}SI7021_PROBE_Typedef;
+
+// Si7021 measurement resolutions: user register 1 RES1 (D7) and RES0 (D0) (Si7021-A20 DS Table 17)
+typedef enum
+{
+  si7021_res_rh12_t14   = 0x00, /* 12-bit RH, 14-bit T (power-up default) */
+  si7021_res_rh8_t12    = 0x01, /* 8-bit RH, 12-bit T */
+  si7021_res_rh10_t13   = 0x80, /* 10-bit RH, 13-bit T */
+  si7021_res_rh11_t11   = 0x81, /* 11-bit RH, 11-bit T */
+}SI7021_RESOLUTION_Typedef;
+
 //***********************************************************************************
 // structs
 //***********************************************************************************
+// Si7021 identity, read once by the open-time probe
+typedef struct
+{
+    SI7021_PROBE_Typedef            probe;                          // probe result; the rest is valid once si7021_probe_ok
+    uint32_t                        serial_a;                       // SNA_3..SNA_0
+    uint32_t                        serial_b;                       // SNB_3..SNB_0
+    uint8_t                         device;                         // device identification (SNB_3)
+    uint8_t                         fw_rev;                         // firmware revision code
+    uint32_t                        caps;                           // SI7021_CAP_ flags of the device
+}SI7021_ID_STRUCT;
+
+// one registered Si7021: its bus, address, result storage and in-flight measurement
+typedef struct
+{
+    I2C_TypeDef                    *i2c;                            // I2Cn peripheral the sensor is on
+    uint32_t                        addr;                           // 7-bit slave address
+    uint32_t                        sample_cb;                      // callback event of a si7021_sample_all() measurement
+    uint32_t                        read_cb;                        // callback event of the measurement in progress (0 for none)
+    uint8_t                         tx_buf[SI7021_TX_BYTES];        // command bytes sent to the sensor
+    uint8_t                         id_buf[SI7021_SNA_READ_BYTES];  // identity bytes (and checksums) as read by the probe
+    SI7021_ID_STRUCT                id;                             // cached identity and capabilities
+    uint8_t                         read_buf[SI7021_RH_READ_BYTES]; // RH bytes (and checksum) as read, before validation
+    uint8_t                         rh_buf[SI7021_RH_BYTES];        // RH bytes of the latest valid measurement
+    uint8_t                         t_buf[SI7021_T_BYTES];          // temperature bytes captured with the last RH measurement
+    I2C_TRANSACTION_STRUCT          txn;                            // transaction descriptor handed to the I2C driver
+    I2C_PROFILE_STRUCT              profile;                        // bus speed profile of every transaction to the sensor
+    bool                            with_t;                         // true when the measurement in progress also reads T
+    volatile bool                   busy;                           // true from a request until its last transaction completes
+    bool                            deferred;                       // txn is waiting for the sensor to power up
+    bool                            sample_pending;                 // si7021_sample_all() arrived while busy; sample once idle
+    volatile SI7021_STATUS_Typedef  result;                         // result of the latest measurement
+    uint8_t                         reg1;                           // shadow of user register 1; the sensor is never read back
+    uint8_t                         reg1_pending;                   // user register 1 value being written
+    uint8_t                         reg1_want;                      // user register 1 value to restore after a power cycle
+    bool                            reg1_restore;                   // reg1_want is to be written once the sensor is idle
+    uint32_t                        reg1_cb;                        // callback event of the deferred user register 1 write
+    bool                            converting;                     // true while waiting out a No Hold Master Mode conversion
+    uint32_t                        conv_left_us;                   // conversion time left when the shared timer was last serviced
+}SI7021_SENSOR_STRUCT;
 
 
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
+void si7021_power_on(bool timed);
+void si7021_power_ready(void);
+bool si7021_power_off(void);
 void si7021_i2c_open(I2C_TypeDef *i2c);
-void si7021_i2c_read(I2C_TypeDef *i2c, uint32_t si7021_cb);
-void si7021_i2c_write(I2C_TypeDef *i2c, uint32_t si7021_cb);
-float si7021_calc_RH(void);
+uint32_t si7021_register(I2C_TypeDef *i2c, uint32_t addr, uint32_t si7021_cb);
+uint32_t si7021_sample_all(void);
+void si7021_i2c_read(uint32_t sensor, uint32_t si7021_cb);
+void si7021_i2c_read_rh_t(uint32_t sensor, uint32_t si7021_cb);
+void si7021_i2c_write(uint32_t sensor, SI7021_I2C_COMMAND_Typedef cmd, uint32_t si7021_cb);
+bool si7021_set_resolution(uint32_t sensor, SI7021_RESOLUTION_Typedef res, uint32_t si7021_cb);
+SI7021_STATUS_Typedef si7021_status(uint32_t sensor);
+const SI7021_ID_STRUCT *si7021_identity(uint32_t sensor);
+float si7021_calc_RH(uint32_t sensor);
+float si7021_calc_T(uint32_t sensor);
+int32_t si7021_calc_RH_centi(uint32_t sensor);
+int32_t si7021_calc_T_centi(uint32_t sensor);
 
 #endif
@@ -0,0 +1,75 @@
+#ifndef STATS_HG
+#define STATS_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Silicon Labs included files
+#include "em_assert.h"
+
+
+// developer included files
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define STATS_WINDOW          32                        // samples in the sliding window (power of 2)
+#define STATS_WINDOW_MASK     (STATS_WINDOW - 1)        // wrap mask for ring and deque indexes
+#define STATS_EWMA_FRAC       8                         // fraction bits kept by the EWMA accumulator
+#define STATS_EWMA_SHIFT_MAX  15                        // slowest EWMA: alpha = 1/32768
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+// streaming statistics of one sample stream; all state is fixed size
+typedef struct
+{
+    int32_t     ring[STATS_WINDOW];         // most recent samples, indexed by sequence number
+    uint32_t    seq;                        // sequence number of the next sample
+    uint32_t    count;                      // samples in the window (saturates at STATS_WINDOW)
+    int64_t     sum;                        // sum of the samples in the window
+    int64_t     sum_sq;                     // sum of the squared samples in the window
+    uint32_t    min_q[STATS_WINDOW];        // window minimum candidates: sequence numbers, values ascending
+    uint32_t    min_head;                   // oldest min_q entry (the window minimum)
+    uint32_t    min_tail;                   // one past the newest min_q entry
+    uint32_t    max_q[STATS_WINDOW];        // window maximum candidates: sequence numbers, values descending
+    uint32_t    max_head;                   // oldest max_q entry (the window maximum)
+    uint32_t    max_tail;                   // one past the newest max_q entry
+    uint32_t    ewma_shift;                 // EWMA weight of a new sample: 1/2^ewma_shift
+    int32_t     ewma;                       // EWMA with STATS_EWMA_FRAC fraction bits
+}STATS_STRUCT;
+
+// aggregate values of a STATS_STRUCT, in the units of the samples
+typedef struct
+{
+    uint32_t    count;                      // samples in the window
+    int32_t     min;                        // window minimum
+    int32_t     max;                        // window maximum
+    int32_t     mean;                       // window mean, rounded toward zero
+    int32_t     variance;                   // window population variance, in squared sample units
+    int32_t     ewma;                       // exponentially weighted moving average of every sample
+}STATS_SUMMARY_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void stats_init(STATS_STRUCT *stats, uint32_t ewma_shift);
+void stats_add(STATS_STRUCT *stats, int32_t sample);
+bool stats_summary(const STATS_STRUCT *stats, STATS_SUMMARY_STRUCT *summary);
+
+
+#endif
@@ -7,7 +7,7 @@
  *   4/19/2020; edited 10/11/2022
  * @brief
  *   Driver to handle hardware delays for use with Si7021 Temperature &
- *   Humidity Sensor
+ *   Humidity Sensor, plus interrupt driven one-shot timers on TIMER1
  ******************************************************************************/
 
 //***********************************************************************************
@@ -19,6 +19,10 @@
 //***********************************************************************************
 // static/private data
 //***********************************************************************************
+static bool hw_timer_opened;                                      // true once TIMER1 is configured
+static uint32_t hw_timer_ticks_per_ms;                            // TIMER1 ticks per millisecond
+static volatile uint32_t hw_timer_armed;                          // bit n set while channel n is armed
+static void (*hw_timer_expired_cb[HW_TIMER_CH_COUNT])(uint32_t ch); // per-channel expiry callbacks
 
 
 //***********************************************************************************
@@ -77,3 +81,234 @@ void timer_delay(uint32_t ms_delay)
 	// disable TIMER0 CMU clock
 	CMU_ClockEnable(cmuClock_TIMER0, false);
 }
+
+
+/***************************************************************************//**
+ * @brief
+ *  Opens the one-shot timer service.
+ *
+ * @details
+ *  Configures TIMER1 as a free running 16-bit up counter with every CC
+ *  channel in compare mode. Each CC channel is an independent one-shot
+ *  timer. The counter only runs while at least one channel is armed. Safe
+ *  to call from every driver that uses a channel; only the first call
+ *  initializes.
+ ******************************************************************************/
+void hw_timer_open(void)
+{
+  // instantiate local TIMER structs
+  TIMER_Init_TypeDef hw_timer_init = TIMER_INIT_DEFAULT;
+  TIMER_InitCC_TypeDef hw_timer_cc_init = TIMER_INITCC_DEFAULT;
+
+  // only initialize once
+  if(hw_timer_opened)
+  {
+      return;
+  }
+
+  // enable the TIMER1 CMU clock
+  CMU_ClockEnable(HW_TIMER_CLOCK, true);
+
+  // set init values; counter is started when a channel is armed
+  hw_timer_init.enable = false;
+  hw_timer_init.mode = timerModeUp;
+  hw_timer_init.prescale = HW_TIMER_PRESCALE;
+  hw_timer_init.debugRun = false;
+
+  // initialize TIMER1
+  TIMER_Init(HW_TIMER, &hw_timer_init);
+  TIMER_TopSet(HW_TIMER, HW_TIMER_TOP);
+
+  // every CC channel is a compare channel
+  hw_timer_cc_init.mode = timerCCModeCompare;
+  for(uint32_t ch = 0; ch < HW_TIMER_CH_COUNT; ch++)
+  {
+      TIMER_InitCC(HW_TIMER, ch, &hw_timer_cc_init);
+  }
+
+  // tick rate used to convert delays into counts
+  hw_timer_ticks_per_ms = CMU_ClockFreqGet(HW_TIMER_CLOCK) / HW_TIMER_DIV / 1000;
+
+  // clear stale flags and enable the NVIC interrupt
+  HW_TIMER->IFC = _TIMER_IFC_MASK;
+  NVIC_EnableIRQ(HW_TIMER_IRQn);
+
+  hw_timer_opened = true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Arms a one-shot timer channel.
+ *
+ * @details
+ *  Sets the channel's compare value the requested number of ticks ahead
+ *  of the counter and enables its interrupt. A short delay whose deadline
+ *  the counter passes while it is being armed expires at once instead of
+ *  a wrap later. Re-arming a running channel moves its deadline. The callback runs in TIMER1 interrupt context.
+ *  EM2 is blocked while the channel is armed.
+ *
+ * @param[in] ch
+ *  One-shot channel (TIMER1 CC channel)
+ *
+ * @param[in] us_delay
+ *  Delay in microseconds
+ *
+ * @param[in] expired_cb
+ *  Function called when the delay expires
+ ******************************************************************************/
+void hw_timer_start(uint32_t ch, uint32_t us_delay, void (*expired_cb)(uint32_t ch))
+{
+  // convert the delay to TIMER1 ticks; never less than one
+  uint32_t ticks = (us_delay * hw_timer_ticks_per_ms) / 1000;
+  if(ticks == 0)
+  {
+      ticks = 1;
+  }
+
+  EFM_ASSERT(hw_timer_opened && (ch < HW_TIMER_CH_COUNT) && (ticks < HW_TIMER_MAX_TICKS));
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  // if the channel was idle ...
+  if(!(hw_timer_armed & (1UL << ch)))
+  {
+      // ... TIMER1 stops in EM2
+      sleep_block_mode(HW_TIMER_EM);
+
+      // ... start the counter for the first armed channel
+      if(!hw_timer_armed)
+      {
+          TIMER_Enable(HW_TIMER, true);
+      }
+      hw_timer_armed |= (1UL << ch);
+  }
+
+  // set the deadline from one sample of the counter
+  hw_timer_expired_cb[ch] = expired_cb;
+  HW_TIMER->IFC = (TIMER_IF_CC0 << ch);
+  uint32_t cnt = HW_TIMER->CNT;
+  HW_TIMER->CC[ch].CCV = (cnt + ticks) & HW_TIMER_TOP;
+
+  // if the counter reached the deadline before CCV was written, the match
+  // was missed and would only come round again after a full wrap: raise it
+  if(((HW_TIMER->CNT - cnt) & HW_TIMER_TOP) >= ticks)
+  {
+      HW_TIMER->IFS = (TIMER_IF_CC0 << ch);
+  }
+
+  // enable its interrupt
+  HW_TIMER->IEN |= (TIMER_IEN_CC0 << ch);
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Disarms a one-shot timer channel.
+ *
+ * @details
+ *  The callback is not called. Cancelling an idle channel is harmless.
+ *
+ * @param[in] ch
+ *  One-shot channel (TIMER1 CC channel)
+ ******************************************************************************/
+void hw_timer_cancel(uint32_t ch)
+{
+  EFM_ASSERT(ch < HW_TIMER_CH_COUNT);
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  // if the channel is armed ...
+  if(hw_timer_armed & (1UL << ch))
+  {
+      // ... disable its interrupt and release EM2
+      HW_TIMER->IEN &= ~(TIMER_IEN_CC0 << ch);
+      HW_TIMER->IFC = (TIMER_IF_CC0 << ch);
+      hw_timer_armed &= ~(1UL << ch);
+      sleep_unblock_mode(HW_TIMER_EM);
+
+      // ... stop the counter once no channel is armed
+      if(!hw_timer_armed)
+      {
+          TIMER_Enable(HW_TIMER, false);
+      }
+  }
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reports the time left on a one-shot timer channel.
+ *
+ * @details
+ *  Lets a driver that shares one channel between several deadlines work
+ *  out how much of the armed delay has elapsed. Rounded down to the tick.
+ *
+ * @param[in] ch
+ *  One-shot channel (TIMER1 CC channel)
+ *
+ * @return
+ *  Microseconds until the channel expires; 0 if it is idle or has expired
+ ******************************************************************************/
+uint32_t hw_timer_remaining(uint32_t ch)
+{
+  uint32_t ticks = 0;
+
+  EFM_ASSERT(ch < HW_TIMER_CH_COUNT);
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  // sample the counter before the flag: a clear flag then means CNT had not reached CCV
+  uint32_t cnt = HW_TIMER->CNT;
+  if((hw_timer_armed & (1UL << ch)) && !(HW_TIMER->IF & (TIMER_IF_CC0 << ch)))
+  {
+      ticks = (HW_TIMER->CC[ch].CCV - cnt) & HW_TIMER_TOP;
+  }
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+
+  return (ticks * 1000) / hw_timer_ticks_per_ms;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  TIMER1 peripheral IRQ Handler
+ *
+ * @details
+ *  Disarms every channel whose compare matched, then calls its callback.
+ *  A callback may re-arm its own channel.
+ ******************************************************************************/
+void TIMER1_IRQHandler(void)
+{
+  // save flags that are both enabled and raised
+  uint32_t intflags = (HW_TIMER->IF & HW_TIMER->IEN);
+
+  // handle each expired channel
+  for(uint32_t ch = 0; ch < HW_TIMER_CH_COUNT; ch++)
+  {
+      if(intflags & (TIMER_IF_CC0 << ch))
+      {
+          // disarm before the callback so that it may re-arm
+          hw_timer_cancel(ch);
+
+          if(hw_timer_expired_cb[ch])
+          {
+              hw_timer_expired_cb[ch](ch);
+          }
+      }
+  }
+}
@@ -23,14 +23,23 @@
 //***********************************************************************************
 // static/private data
 //***********************************************************************************
+static int32_t app_temp;    // temperature (0.01 C) of the latest Si7021 sample
+static uint32_t app_si7021; // registry handle of the on-board Si7021
+static STATS_STRUCT app_rh_stats; // statistics of the recent RH samples (0.01 %RH)
+static RULE_STRUCT app_rules[APP_RULE_COUNT]; // output rules evaluated on every valid sample
+static LETIMER_TIMER_STRUCT app_sample_timer; // periodic Si7021 sample
+#ifdef APP_SI7021_POWER_GATING
+static LETIMER_TIMER_STRUCT app_power_timer;  // periodic Si7021 power-up, APP_POWER_LEAD ahead of the sample
+#endif
 
 
 //***********************************************************************************
 // static/private functions
 //***********************************************************************************
-static void app_letimer_pwm_open(float period, float act_period,
-                                 uint32_t out0_route, uint32_t out1_route,
-                                 bool out0_en, bool out1_en, bool out_en);
+static void app_timers_open(void);
+static void app_scheduler_open(void);
+static void app_rules_open(void);
+static void app_led1_action(bool active);
 
 //***********************************************************************************
 // function definitions
@@ -46,119 +55,101 @@ void app_peripheral_setup(void){
   cmu_open();
   gpio_open();
   sleep_open();
-  scheduler_open();
-  app_letimer_pwm_open(PWM_PER, PWM_ACT_PER, PWM_ROUTE_0, PWM_ROUTE_1, false, false, true);
-  letimer_start(LETIMER0, true);
+  si7021_power_on(true);
+#ifdef APP_SI7021_POWER_GATING
+  // the power-up timer must lead the sample by the Si7021 power-up time
+  EFM_ASSERT((APP_POWER_LEAD * 1000000) >= SI7021_POWERUP_US);
+#endif
+  app_scheduler_open();
+  stats_init(&app_rh_stats, APP_RH_EWMA_SHIFT);
+  app_rules_open();
+  app_timers_open();
   si7021_i2c_open(APP_I2Cn);
+  app_si7021 = si7021_register(APP_I2Cn, SI7021_ADDR, SI7021_HUM_READ_CB);
+  si7021_set_resolution(app_si7021, APP_SI7021_RES, 0);
+
+  // first sample as soon as the sensor has powered up, not at the first underflow
+  si7021_sample_all();
 }
 
 
 /***************************************************************************//**
  * @brief
- *   Configure LETIMER for PWM mode.
+ *   Opens the scheduler and registers the application's event handlers
  *
  * @details
- *   Driver which instantiates and opens the LETIMER in PWM mode for the application
- *
- * @param[in] period
- *   Sets the period (in seconds) for the clock
- *
- * @param[in] act_period
- *   Sets the active period (in seconds) for the clock
- *
- * @param[in] out0_route
- *    out0 route to gpio port/pin
- *
- * @param[in] out1_route
- *    out1 route to gpio port/pin
- *
+ *   The buttons are queued, so each press is handled; queued events run
+ *   ahead of the others. The remaining event bits in app.h set their
+ *   dispatch priority: the Si7021 results, then the timer events.
  ******************************************************************************/
-void app_letimer_pwm_open(float period, float act_period,
-                          uint32_t out0_route, uint32_t out1_route,
-                          bool out0_en, bool out1_en, bool out_en)
+void app_scheduler_open(void)
 {
-  // instantiate an APP_LETIMER_PWM_TypeDef struct
-  APP_LETIMER_PWM_TypeDef letimer_pwm;
-
-  // configure struct
-  letimer_pwm.debugRun = false;
-  letimer_pwm.enable = out_en;
-  letimer_pwm.out_pin_route0 = out0_route;
-  letimer_pwm.out_pin_route1 = out1_route;
-  letimer_pwm.out_pin_0_en = out0_en;
-  letimer_pwm.out_pin_1_en = out1_en;
-  letimer_pwm.period = period;
-  letimer_pwm.active_period = act_period;
-  letimer_pwm.comp0_irq_enable = false;
-  letimer_pwm.comp0_cb = LETIMER0_COMP0_CB;
-  letimer_pwm.comp1_irq_enable = true;
-  letimer_pwm.comp1_cb = LETIMER0_COMP1_CB;
-  letimer_pwm.uf_irq_enable = true;
-  letimer_pwm.uf_cb = LETIMER0_UF_CB;
-
-  // open letimer for PWM mode
-  letimer_pwm_open(LETIMER0, &letimer_pwm);
+  scheduler_open();
+#ifdef APP_SI7021_POWER_GATING
+  scheduler_register(APP_POWER_ON_CB, scheduled_power_on_cb);
+#endif
+  scheduler_register(APP_SAMPLE_CB, scheduled_sample_cb);
+  scheduler_register(SI7021_HUM_READ_CB, scheduled_si7021_hum_read_cb);
+  scheduler_register_queued(GPIO_EVEN_IRQ_CB, scheduled_gpio_even_irq_cb);
+  scheduler_register_queued(GPIO_ODD_IRQ_CB, scheduled_gpio_odd_irq_cb);
 }
 
 
 /***************************************************************************//**
  * @brief
- *   Handles the scheduling of the letimer0 underflow call back
+ *   Starts the application's software timers on LETIMER0
  *
  * @details
- *   Removes the underflow call back event from the scheduler then
- *   asserts that the event has been cleared
+ *   LETIMER0 wakes the core only at a timer deadline. The sample timer
+ *   runs every APP_SAMPLE_PER; with power gating a second timer of the
+ *   same period runs APP_POWER_LEAD ahead of it. Both count whole periods
+ *   from the same start, so they stay in step.
  ******************************************************************************/
-void scheduled_letimer0_uf_cb(void)
+void app_timers_open(void)
 {
-  // remove LETIMER0 underflow callback even from scheduler
-  remove_scheduled_event(LETIMER0_UF_CB);
+  letimer_timer_open(LETIMER0, false);
+  letimer_start(LETIMER0, true);
 
-  // read relative humidity using Si7021
-  si7021_i2c_read(APP_I2Cn, SI7021_HUM_READ_CB);
+#ifdef APP_SI7021_POWER_GATING
+  letimer_timer_start(&app_power_timer, APP_SAMPLE_TICKS - APP_POWER_TICKS, APP_SAMPLE_TICKS, APP_POWER_ON_CB);
+#endif
+  letimer_timer_start(&app_sample_timer, APP_SAMPLE_TICKS, APP_SAMPLE_TICKS, APP_SAMPLE_CB);
 }
 
 
 /***************************************************************************//**
  * @brief
- *   Handles the scheduling of the letimer0 comp0 call back
- *
- * @note
- *   Currently disabled, as the comp0 interrupt is disabled. The Assert
- *   statement is for debugging. If the assert is reached the configuration
- *   is incorrect.
+ *   Handles the scheduling of the sample timer call back
  *
  * @details
- *   Removes the comp0 call back event from the scheduler then asserts that
- *   the event has been cleared
+ *   Samples every registered Si7021
  ******************************************************************************/
-void scheduled_letimer0_comp0_cb(void)
+void scheduled_sample_cb(void)
 {
-  // the LETIMER0 comp0 interrupt is disabled; so if we get here we know that
-  // we configured the LETIMER0 incorrectly. FOR DEBUGGING PURPOSES ONLY.
-  // REMOVE ASSERT IF INTERRUPT ENABLED.
-  EFM_ASSERT(false);
-
-  // added so that we can handle the callback once enabled
-  // uncomment next two lines when enabled
-  //remove_scheduled_event(LETIMER0_COMP0_CB);
-  //EFM_ASSERT(!(get_scheduled_events() & LETIMER0_COMP0_CB));
+#ifdef APP_SI7021_POWER_GATING
+  // powered up by the power-up timer, APP_POWER_LEAD ago
+  si7021_power_ready();
+#endif
+
+  // read relative humidity and temperature from every registered Si7021
+  si7021_sample_all();
 }
 
 
+#ifdef APP_SI7021_POWER_GATING
 /***************************************************************************//**
  * @brief
- *   Handles the scheduling of the letimer0 comp1 call back
+ *   Handles the scheduling of the power-up timer call back
  *
  * @details
- *   Removes the comp1 call back event from the scheduler then
- *   asserts that the event has been cleared
+ *   Powers the Si7021 up APP_POWER_LEAD ahead of the sample timer, which
+ *   covers its power-up time.
  ******************************************************************************/
-void scheduled_letimer0_comp1_cb(void)
+void scheduled_power_on_cb(void)
 {
-  remove_scheduled_event(LETIMER0_COMP1_CB);
-  EFM_ASSERT(!(get_scheduled_events() & LETIMER0_COMP1_CB));
+  si7021_power_on(false);
 }
+#endif
 
 
 /***************************************************************************//**
@@ -166,18 +157,15 @@ void scheduled_letimer0_comp1_cb(void)
  *   Handles the scheduling of the GPIO Odd IRQ (BTN1) call back
  *
  * @details
- *  Removes the triggering event from the scheduler and unblocked the
- *  current energy mode. If the current blocked EM is less than EM4,
- *  increment the current energy mode. Otherwise return EM0 (overflow)
+ *  Unblocks the current energy mode. If the current blocked EM is less
+ *  than EM4, increment the current energy mode. Otherwise return EM0
+ *  (overflow)
+ *
+ * @param[in] event
+ *  Queued button event
  ******************************************************************************/
-void scheduled_gpio_odd_irq_cb(void)
+void scheduled_gpio_odd_irq_cb(const SCHEDULER_EVENT_STRUCT *event)
 {
-  // remove scheduled event from scheduler
-  remove_scheduled_event(GPIO_ODD_IRQ_CB);
-
-  // assert to ensure removed
-  EFM_ASSERT(!(get_scheduled_events() & GPIO_ODD_IRQ_CB));
-
   // local variable to store the current blocked energy mode
   uint32_t current_block_em = current_block_energy_mode();
 
@@ -200,17 +188,14 @@ void scheduled_gpio_odd_irq_cb(void)
  *   Handles the scheduling of the GPIO Even IRQ (BTN1) call back
  *
  * @details
- *  Removes the triggering event from the scheduler. If the EM is zero,
- *  block EM4 (underflow) otherwise  decrement the current block energy mode.
+ *  If the EM is zero, block EM4 (underflow) otherwise  decrement the
+ *  current block energy mode.
+ *
+ * @param[in] event
+ *  Queued button event
  ******************************************************************************/
-void scheduled_gpio_even_irq_cb(void)
+void scheduled_gpio_even_irq_cb(const SCHEDULER_EVENT_STRUCT *event)
 {
-  // remove event from scheduler
-  remove_scheduled_event(GPIO_EVEN_IRQ_CB);
-
-  // assert to ensure removed
-  EFM_ASSERT(!(get_scheduled_events() & GPIO_EVEN_IRQ_CB));
-
   // local variable to store the current blocked energy mode
   uint32_t current_block_em = current_block_energy_mode();
 
@@ -236,24 +221,76 @@ void scheduled_gpio_even_irq_cb(void)
  *   Handles the scheduling of Si7021 humidity read callback
  *
  * @details
- *  Removes the triggering event from the scheduler and calculates relative
- *  humidity from the stored Si7021's measurement code.
+ *  If the sample is valid, calculates relative humidity and temperature
+ *  from the stored Si7021's measurement codes and adds the RH to the
+ *  running statistics.
  ******************************************************************************/
 void scheduled_si7021_hum_read_cb(void)
 {
-  // remove event from scheduler
-  remove_scheduled_event(SI7021_HUM_READ_CB);
+#ifdef APP_SI7021_POWER_GATING
+  // the codes are kept in RAM; power down, once every sensor is idle, until
+  // the next power-up timer
+  si7021_power_off();
+#endif
+
+  // a failed or corrupted sample leaves LED1 as it is
+  if(si7021_status(app_si7021) != si7021_status_ok)
+  {
+      return;
+  }
 
-  // asset to ensure removed
-  EFM_ASSERT(!(get_scheduled_events() & SI7021_HUM_READ_CB));
+  // convert measured values to relative humidity and temperature
+  int32_t rh = si7021_calc_RH_centi(app_si7021);
+  app_temp = si7021_calc_T_centi(app_si7021);
 
-  // convert measured value to relative humidity
-  float rh = si7021_calc_RH();
+  // fold the sample into the RH statistics
+  stats_add(&app_rh_stats, rh);
 
-  // if relative humidity is greater than 30.0%...
-  if(rh >= RH_LED_ON)
+  // drive the outputs; only rules that change state act
+  rules_eval(app_rules, APP_RULE_COUNT, APP_CH_RH, rh);
+  rules_eval(app_rules, APP_RULE_COUNT, APP_CH_T, app_temp);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Fills in the application's output rule table
+ *
+ * @details
+ *   LED1 follows relative humidity with a RH_LED_HYST release band, so it
+ *   does not chatter while RH hovers around RH_LED_ON.
+ ******************************************************************************/
+void app_rules_open(void)
+{
+  // LED1: on at RH_LED_ON, off below RH_LED_ON - RH_LED_HYST
+  app_rules[APP_RULE_LED1].channel = APP_CH_RH;
+  app_rules[APP_RULE_LED1].direction = rule_rising;
+  app_rules[APP_RULE_LED1].threshold = RH_LED_ON;
+  app_rules[APP_RULE_LED1].hysteresis = RH_LED_HYST;
+  app_rules[APP_RULE_LED1].action = app_led1_action;
+
+  // every rule starts undecided
+  rules_init(app_rules, APP_RULE_COUNT);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   LED1 rule action
+ *
+ * @details
+ *   Called by the rule engine on a state transition only, so LED1 is
+ *   written once per edge rather than on every sample.
+ *
+ * @param[in] active
+ *   true once RH reaches RH_LED_ON; false once it falls below
+ *   RH_LED_ON - RH_LED_HYST
+ ******************************************************************************/
+void app_led1_action(bool active)
+{
+  if(active)
   {
-      // ... Assert LED1
+      // Assert LED1
       GPIO_PinOutSet(LED1_PORT, LED1_PIN);
   }
   else
@@ -48,6 +48,9 @@
  *   Routed:
  *   - Low-frequency A clock (LFA) to LETIMER
  *
+ *   Started:
+ *   - DWT core cycle counter, used for bounded waits and timing
+ *
  * @note
  *   No requirement to enable the ULFRCO oscillator.
  *   It is always enabled in EM0-EM4
@@ -69,4 +72,41 @@ void cmu_open(void){
 
     // enable global low frequency clock
     CMU_ClockEnable(cmuClock_CORELE, true);
+
+    // start the DWT core cycle counter (ARMv7-M ARM C1.8.8)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Converts microseconds to core clock cycles
+ *
+ * @param[in] us
+ *   Time in microseconds
+ *
+ * @return
+ *   Number of CMU_CYCLES() counts in that time
+ ******************************************************************************/
+uint32_t cmu_us_to_cycles(uint32_t us)
+{
+  return us * (CMU_ClockFreqGet(cmuClock_CORE) / CMU_HZ_PER_MHZ);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Converts core clock cycles to microseconds
+ *
+ * @param[in] cycles
+ *   Difference of two CMU_CYCLES() reads
+ *
+ * @return
+ *   Time in microseconds
+ ******************************************************************************/
+uint32_t cmu_cycles_to_us(uint32_t cycles)
+{
+  return cycles / (CMU_ClockFreqGet(cmuClock_CORE) / CMU_HZ_PER_MHZ);
 }
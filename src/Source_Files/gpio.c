@@ -44,10 +44,10 @@ void gpio_open(void){
   // enable clock
   CMU_ClockEnable(cmuClock_GPIO, true);
 
-  // configure Si7021
+  // configure Si7021; unpowered until si7021_power_on() times its power-up
   GPIO_DriveStrengthSet(SI7021_SENSOR_EN_PORT, SI7021_DRIVE_STRENGTH);
   GPIO_PinModeSet(SI7021_SENSOR_EN_PORT, SI7021_SENSOR_EN_PIN,
-                  SI7021_SENSOR_CONFIG, SI7021_DEFAULT_1);
+                  SI7021_SENSOR_CONFIG, SI7021_DEFAULT_0);
   GPIO_PinModeSet(SI7021_SCL_PORT, SI7021_SCL_PIN, SI7021_WIREDAND, SI7021_DEFAULT_1);
   GPIO_PinModeSet(SI7021_SDA_PORT, SI7021_SDA_PIN, SI7021_WIREDAND, SI7021_DEFAULT_1);
 
@@ -85,7 +85,7 @@ void gpio_open(void){
  *   Driver to handle the GPIO Odd Interrupts on BTN1
  *
  * @details
- *   Adds a callback event to the schedule for BTN1 interrupt
+ *   Queues a callback event for BTN1 interrupt
  ******************************************************************************/
 void GPIO_ODD_IRQHandler(void)
 {
@@ -95,8 +95,8 @@ void GPIO_ODD_IRQHandler(void)
   // clear interrupt flag
   GPIO->IFC = int_flag;
 
-  // schedule call back event
-  add_scheduled_event(gpio_odd_irq_cb);
+  // queue call back event; every press is delivered, with the pins that fired
+  scheduler_post(gpio_odd_irq_cb, int_flag);
 
   // assert to ensure flag is cleared
   EFM_ASSERT(!(GPIO->IF & gpio_odd_irq_cb));
@@ -108,7 +108,7 @@ void GPIO_ODD_IRQHandler(void)
  *   Driver to handle the GPIO Even Interrupts on BTN0
  *
  * @details
- *   Adds a callback event to the schedule for BTN0 interrupt
+ *   Queues a callback event for BTN0 interrupt
  ******************************************************************************/
 void GPIO_EVEN_IRQHandler(void)
 {
@@ -118,8 +118,8 @@ void GPIO_EVEN_IRQHandler(void)
   // clear interrupt flag
   GPIO->IFC = int_flag;
 
-  // schedule call back event
-  add_scheduled_event(gpio_even_irq_cb);
+  // queue call back event; every press is delivered, with the pins that fired
+  scheduler_post(gpio_even_irq_cb, int_flag);
 
   // assert to ensure flag is cleared
   EFM_ASSERT(!(GPIO->IF & gpio_even_irq_cb));
@@ -18,18 +18,61 @@
 //***********************************************************************************
 // static/private data
 //***********************************************************************************
-static volatile I2C_STATE_MACHINE_STRUCT i2c0_sm;
-static volatile I2C_STATE_MACHINE_STRUCT i2c1_sm;
+// constant per-instance configuration, indexed by I2C_INSTANCE_NUM()
+static const I2C_INSTANCE_STRUCT i2c_instance[I2C_COUNT] =
+{
+  {
+    .I2Cn = I2C0, .clock = cmuClock_I2C0, .irqn = I2C0_IRQn,
+#ifdef I2C_LDMA_MODE
+    .ldma_rx_ch = I2C_LDMA_RX_CH(0), .ldma_tx_ch = I2C_LDMA_TX_CH(0),
+    .ldma_rx_signal = ldmaPeripheralSignal_I2C0_RXDATAV, .ldma_tx_signal = ldmaPeripheralSignal_I2C0_TXBL,
+#endif
+  },
+  {
+    .I2Cn = I2C1, .clock = cmuClock_I2C1, .irqn = I2C1_IRQn,
+#ifdef I2C_LDMA_MODE
+    .ldma_rx_ch = I2C_LDMA_RX_CH(1), .ldma_tx_ch = I2C_LDMA_TX_CH(1),
+    .ldma_rx_signal = ldmaPeripheralSignal_I2C1_RXDATAV, .ldma_tx_signal = ldmaPeripheralSignal_I2C1_TXBL,
+#endif
+  },
+};
+
+// per-instance state machines, indexed by I2C_INSTANCE_NUM()
+static volatile I2C_STATE_MACHINE_STRUCT i2c_sm_table[I2C_COUNT];
+
+// per-instance default speed profiles, built from the i2c_open() settings
+static I2C_PROFILE_STRUCT i2c_default_profile[I2C_COUNT];
 
 
 //***********************************************************************************
 // static/private functions
 //***********************************************************************************
-static void i2c_bus_reset(I2C_TypeDef *i2c);
+static void i2c_bus_reset(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
+static bool i2cn_bus_recover(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
+static bool i2c_pin_wait_high(GPIO_Port_TypeDef port, uint32_t pin, uint32_t cycles);
+static void i2c_delay_cycles(uint32_t cycles);
+static void i2cn_clto(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
+static void i2cn_irq(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
 static void i2cn_ack_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
 static void i2cn_nack_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
 static void i2cn_rxdata_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
 static void i2cn_mstop_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
+static void i2cn_txdata_write(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm, uint32_t data);
+static void i2cn_start_phase(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
+static void i2cn_next_txn(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
+static void i2cn_speed_set(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
+static void i2cn_derate(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_STATUS_Typedef status);
+static void i2cn_txn_done(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_STATUS_Typedef status);
+static void i2c_retry_timer_cb(uint32_t ch);
+#ifdef I2C_LDMA_MODE
+static void i2cn_ldma_tx_start(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
+static void i2cn_ldma_rx_start(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
+static void i2cn_ldma_stop(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
+static void i2c_ldma_rx_done(uint32_t ch);
+#endif
+#ifdef I2C_PERF_COUNTERS
+static void i2c_perf_hist(volatile uint32_t *hist, uint32_t value);
+#endif
 
 
 //***********************************************************************************
@@ -44,16 +87,30 @@ static void i2cn_mstop_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm);
  *  for the bus to go idle, saving the state of the IEN register, disabling
  *  all interrupts, clearing all interrupt flags, clearing the transmit
  *  buffer and MSTOP bit, sending a START and STOP command, and finally
- *  restoring the state of the IEN register.
+ *  restoring the state of the IEN register. A slave holding SDA low, or a
+ *  STOP that never completes, runs the bus recovery instead of hanging.
  *
- * @param[in] i2c
- *  Desired I2Cn peripheral (either I2C0 or I2C1)
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
  ******************************************************************************/
-void i2c_bus_reset(I2C_TypeDef *i2c)
+void i2c_bus_reset(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
 {
+  I2C_TypeDef *i2c = i2c_sm->I2Cn;
+
   // local variable to save the state of the IEN register
   uint32_t ien_state;
 
+  // local variables to bound the wait for MSTOP
+  uint32_t start;
+  uint32_t timeout = cmu_us_to_cycles(I2C_RESET_TIMEOUT_US);
+
+  // a slave left mid-byte by a reset holds SDA low; free it first
+  if(!GPIO_PinInGet(i2c_sm->sda_port, i2c_sm->sda_pin))
+  {
+      i2cn_bus_recover(i2c_sm);
+  }
+
   // abort current transmission to make bus go idle (TRM 16.5.2)
   i2c->CMD = I2C_CMD_ABORT;
 
@@ -78,8 +135,15 @@ void i2c_bus_reset(I2C_TypeDef *i2c)
   // bus reset (TRM 16.3.12.2)
   i2c->CMD = (I2C_CMD_START | I2C_CMD_STOP);
 
-  // ensure reset occurred properly
-  while(!(i2c->IF & I2C_IF_MSTOP));
+  // wait, bounded, for the reset to complete
+  start = CMU_CYCLES();
+  while(!(i2c->IF & I2C_IF_MSTOP) && ((CMU_CYCLES() - start) < timeout));
+
+  // if the STOP never made it onto the bus, recover it by hand
+  if(!(i2c->IF & I2C_IF_MSTOP))
+  {
+      i2cn_bus_recover(i2c_sm);
+  }
 
   // clear IFC register (TRM 16.5.16)
   // clear any bits that may have been generated by START/STOP
@@ -93,12 +157,142 @@ void i2c_bus_reset(I2C_TypeDef *i2c)
 }
 
 
+/***************************************************************************//**
+ * @brief
+ *  Recovers a bus held by a slave
+ *
+ * @details
+ *  Takes SCL and SDA away from the peripheral and, while SDA is held low,
+ *  clocks SCL up to nine times so that a slave stuck mid-byte can finish
+ *  shifting it out (UM10204 3.1.16). A STOP is then generated by hand and
+ *  the pins are routed back to the peripheral. Every wait is bounded,
+ *  including a slave stretching SCL. The duration is recorded for
+ *  i2c_recovery_get().
+ *
+ * @note
+ *  Must be called with the bus idle or from the I2Cn IRQ handler. Takes
+ *  roughly 100 us.
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
+ *
+ * @return
+ *  true if both lines are released after the recovery
+ ******************************************************************************/
+bool i2cn_bus_recover(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
+{
+  I2C_TypeDef *i2c = i2c_sm->I2Cn;
+  uint32_t start = CMU_CYCLES();
+  uint32_t half = cmu_us_to_cycles(I2C_RECOVERY_HALF_US);
+  uint32_t stretch = cmu_us_to_cycles(I2C_RECOVERY_STRETCH_US);
+  uint32_t route_pen = i2c->ROUTEPEN;
+  bool bus_free;
+
+  // hand both pins to GPIO; they are wired-AND, so DOUT = 1 releases them
+  i2c->ROUTEPEN &= ~(I2C_ROUTEPEN_SCLPEN | I2C_ROUTEPEN_SDAPEN);
+  GPIO_PinOutSet(i2c_sm->sda_port, i2c_sm->sda_pin);
+  GPIO_PinOutSet(i2c_sm->scl_port, i2c_sm->scl_pin);
+
+  // clock SCL until the slave lets go of SDA
+  for(uint32_t clocks = 0; (clocks < I2C_RECOVERY_CLOCKS) && !GPIO_PinInGet(i2c_sm->sda_port, i2c_sm->sda_pin); clocks++)
+  {
+      GPIO_PinOutClear(i2c_sm->scl_port, i2c_sm->scl_pin);
+      i2c_delay_cycles(half);
+      GPIO_PinOutSet(i2c_sm->scl_port, i2c_sm->scl_pin);
+      i2c_pin_wait_high(i2c_sm->scl_port, i2c_sm->scl_pin, stretch);
+      i2c_delay_cycles(half);
+  }
+
+  // STOP: SDA rises while SCL is high
+  GPIO_PinOutClear(i2c_sm->scl_port, i2c_sm->scl_pin);
+  i2c_delay_cycles(half);
+  GPIO_PinOutClear(i2c_sm->sda_port, i2c_sm->sda_pin);
+  i2c_delay_cycles(half);
+  GPIO_PinOutSet(i2c_sm->scl_port, i2c_sm->scl_pin);
+  i2c_pin_wait_high(i2c_sm->scl_port, i2c_sm->scl_pin, stretch);
+  i2c_delay_cycles(half);
+  GPIO_PinOutSet(i2c_sm->sda_port, i2c_sm->sda_pin);
+  i2c_delay_cycles(half);
+
+  // the bus is free once both lines read high
+  bus_free = GPIO_PinInGet(i2c_sm->scl_port, i2c_sm->scl_pin) &&
+             GPIO_PinInGet(i2c_sm->sda_port, i2c_sm->sda_pin);
+
+  // route the pins back and return the peripheral to idle
+  i2c->ROUTEPEN = route_pen;
+  i2c->CMD = I2C_CMD_ABORT;
+
+  // record the recovery
+  i2c_sm->recovery_count++;
+  i2c_sm->recovery_us = cmu_cycles_to_us(CMU_CYCLES() - start);
+#ifdef I2C_PERF_COUNTERS
+  i2c_sm->perf.recoveries++;
+#endif
+
+  return bus_free;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Bounded wait on a GPIO input
+ *
+ * @details
+ *  Returns as soon as the pin reads high, or once the given number of core
+ *  cycles has elapsed.
+ *
+ * @param[in] port
+ *  GPIO port of the pin
+ *
+ * @param[in] pin
+ *  GPIO pin
+ *
+ * @param[in] cycles
+ *  Maximum wait in core clock cycles
+ *
+ * @return
+ *  true if the pin read high before the timeout
+ ******************************************************************************/
+bool i2c_pin_wait_high(GPIO_Port_TypeDef port, uint32_t pin, uint32_t cycles)
+{
+  uint32_t start = CMU_CYCLES();
+
+  // wait for the pin or the timeout
+  while((CMU_CYCLES() - start) < cycles)
+  {
+      if(GPIO_PinInGet(port, pin))
+      {
+          return true;
+      }
+  }
+  return false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Busy waits for a number of core cycles
+ *
+ * @param[in] cycles
+ *  Delay in core clock cycles
+ ******************************************************************************/
+void i2c_delay_cycles(uint32_t cycles)
+{
+  uint32_t start = CMU_CYCLES();
+
+  // wait out the delay
+  while((CMU_CYCLES() - start) < cycles);
+}
+
+
 /***************************************************************************//**
  * @brief
  *  Opens the I2C peripheral.
  *
  * @details
- *  Enables the proper I2Cn CMU clock, sets the START bit, initializes
+ *  Binds the peripheral's state machine to its entry in the instance
+ *  table, enables the proper I2Cn CMU clock, sets the START bit, initializes
  *  I2C, routes & enables the I2C to the proper pin, and resets the I2C bus.
  *
  * @param[in] i2c
@@ -112,22 +306,34 @@ void i2c_open(I2C_TypeDef *i2c, I2C_OPEN_STRUCT *app_i2c_open)
   // instantiate a local I2C_Init struct
   I2C_Init_TypeDef i2c_init_values;
 
-  // if the address of i2c is equal to the base address of the
-  // I2C0 base peripheral ...
-  if(i2c == I2C0)
-  {
-      // ... enable I2C0 clock
-      CMU_ClockEnable(cmuClock_I2C0, true);
-  }
+  // resolve the instance once; everything below is instance independent
+  uint32_t num = I2C_INSTANCE_NUM(i2c);
+  EFM_ASSERT(num < I2C_COUNT);
+  volatile I2C_STATE_MACHINE_STRUCT *i2c_sm = &i2c_sm_table[num];
 
-  // if the address of i2c is equal to the base address of the
-  // I2C1 base peripheral ...
-  if(i2c == I2C1)
-  {
-      // ... enable I2C1 clock
-      CMU_ClockEnable(cmuClock_I2C1, true);
-  }
+  // bind the state machine to its peripheral
+  i2c_sm->inst = &i2c_instance[num];
+  i2c_sm->I2Cn = i2c;
+  i2c_sm->rxdata = &i2c->RXDATA;
+  i2c_sm->txdata = &i2c->TXDATA;
 
+  // keep the pins for bus recovery
+  i2c_sm->scl_port = app_i2c_open->scl_port;
+  i2c_sm->scl_pin = app_i2c_open->scl_pin;
+  i2c_sm->sda_port = app_i2c_open->sda_port;
+  i2c_sm->sda_pin = app_i2c_open->sda_pin;
+  i2c_sm->isolated = false;
+
+  // enable I2Cn clock
+  CMU_ClockEnable(i2c_sm->inst->clock, true);
+
+#ifdef I2C_LDMA_MODE
+  // open the LDMA for multi-byte phases
+  ldma_open();
+#endif
+
+  // open the one-shot timers used to space NACK retries
+  hw_timer_open();
 
   // if START interrupt flag not set ...
   if(!(i2c->IF & I2C_IFS_START))
@@ -158,6 +364,9 @@ void i2c_open(I2C_TypeDef *i2c, I2C_OPEN_STRUCT *app_i2c_open)
   // initialize I2C peripheral
   I2C_Init(i2c, &i2c_init_values);
 
+  // fail, rather than hang, a transfer whose SCL is held low
+  i2c->CTRL = (i2c->CTRL & ~_I2C_CTRL_CLTO_MASK) | app_i2c_open->clto;
+
   // set route location for SDA and SCL
   i2c->ROUTELOC0 |= app_i2c_open->sda_loc0;
   i2c->ROUTELOC0 |= app_i2c_open->scl_loc0;
@@ -167,200 +376,564 @@ void i2c_open(I2C_TypeDef *i2c, I2C_OPEN_STRUCT *app_i2c_open)
   i2c->ROUTEPEN |= app_i2c_open->scl_pen;
 
   // reset the I2C bus
-  i2c_bus_reset(i2c);
+  i2c_bus_reset(i2c_sm);
+
+  // precompute the bus default speed profile
+  i2c_profile_init(i2c, &i2c_default_profile[num], app_i2c_open->freq, app_i2c_open->clhr);
 }
 
 
 /***************************************************************************//**
  * @brief
- *  Start the I2C peripheral.
+ *  Submit an I2C transaction.
  *
  * @details
- *  Initializes the I2C state machine and sends the start command. Can be
- *  used with either I2C0 or I2C1.
+ *  Appends the transaction descriptor to the peripheral's transaction queue
+ *  and returns without waiting. If the bus is idle the state machine is
+ *  initialized and the start command is sent straight away; otherwise the
+ *  transaction is started from the MSTOP interrupt of the one before it.
+ *  The same state machine runs write-only, read-only and write-then-read
+ *  transactions. Can be used with either I2C0 or I2C1, and is safe to call
+ *  from scheduler callbacks and interrupt handlers.
+ *
+ * @note
+ *  The descriptor and its buffers are owned by the state machine until
+ *  the transaction completes, so they must not live on the caller's stack.
  *
  * @param[in] i2c
  *  Pointer to desired I2Cn peripheral (either I2C0 or I2C1)
  *
- * @param[in] slave_addr
- *  Address for the slave device
+ * @param[in] txn
+ *  Transaction descriptor: slave address, tx/rx buffers and lengths,
+ *  repeated-start flag and completion callback event
  *
- *  @param[in] r_w
- *   Bit to perform either a read or a write
- *
- * @param[in] app_i2c_open
- *  All data required to open the I2C peripheral encapsulated in struct
+ * @return
+ *  true if the transaction was queued; false if the queue is full
  ******************************************************************************/
-void i2c_init_sm(I2C_TypeDef *i2c, uint32_t slave_addr, uint32_t r_w,
-               volatile uint16_t *read_result, uint32_t si7021_cb)
+bool i2c_init_sm(I2C_TypeDef *i2c, I2C_TRANSACTION_STRUCT *txn)
 {
-  // The I2C peripheral cannot cannot go below EM1
-  sleep_block_mode(I2C_EM_BLOCK);
+  // state machine of the requested peripheral
+  volatile I2C_STATE_MACHINE_STRUCT *i2c_sm = &i2c_sm_table[I2C_INSTANCE_NUM(i2c)];
+
+  // will trigger if the peripheral has not been opened, or its pins are isolated
+  EFM_ASSERT((i2c_sm->I2Cn == i2c) && !i2c_sm->isolated);
+
+  // a transaction must move at least one byte
+  EFM_ASSERT(txn->tx_len || txn->rx_len);
 
   // make atomic by disallowing interrupts
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
 
-  // if starting the I2C0 peripheral ...
-  if(i2c == I2C0)
+  // reject the transaction if the queue is full
+  if(i2c_sm->q_count == I2C_QUEUE_DEPTH)
   {
-      // halt until bus is ready
-      while(i2c0_sm.busy);
+#ifdef I2C_PERF_COUNTERS
+      i2c_sm->perf.queue_full++;
+#endif
+      CORE_EXIT_CRITICAL();
+      return false;
+  }
 
+  // append transaction to the queue
+  txn->status = i2c_status_pending;
+  i2c_sm->queue[(i2c_sm->q_head + i2c_sm->q_count) & I2C_QUEUE_MASK] = txn;
+  i2c_sm->q_count++;
+
+  // if the bus is idle, start the transaction now
+  if(i2c_sm->busy == I2C_BUS_READY)
+  {
       // will trigger if a previous I2C operation has not completed
-      EFM_ASSERT((I2C0->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
+      EFM_ASSERT((i2c->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
 
       // set busy bit
-      i2c0_sm.busy = I2C_BUS_BUSY;
-
-      // initialize static I2C0 state machine
-      i2c0_sm.I2Cn = i2c;
-      i2c0_sm.curr_state = req_res;
-      i2c0_sm.slave_addr = slave_addr;
-      i2c0_sm.r_w = r_w;
-      i2c0_sm.num_bytes = READ_2_BYTES;
-      i2c0_sm.rxdata = &i2c0_sm.I2Cn->RXDATA;
-      i2c0_sm.txdata = &i2c0_sm.I2Cn->TXDATA;
-      i2c0_sm.data = read_result;
-      i2c0_sm.i2c_cb = si7021_cb;
+      i2c_sm->busy = I2C_BUS_BUSY;
+
+      // The I2C peripheral cannot cannot go below EM1 until the queue drains
+      sleep_block_mode(I2C_EM_BLOCK);
 
       // enable interrupts
-      i2c0_sm.I2Cn->IEN = SI7021_I2C_IEN_MASK;
-      NVIC_EnableIRQ(I2C0_IRQn);
+      i2c->IEN = I2C_IEN_MASK;
+      NVIC_EnableIRQ(i2c_sm->inst->irqn);
 
-      // start I2C0 peripheral
-      i2c0_sm.I2Cn->CMD = I2C_CMD_START;
+      // dequeue and start the transaction
+      i2cn_next_txn(i2c_sm);
+  }
 
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
 
-      // TODO: MOVE TO APPLICATION LAYER?
-      // send slave addr + write bit
-      i2c0_sm.tx_cmd = (slave_addr << I2C_ADDR_RW_SHIFT) | i2c0_sm.r_w;
-      *i2c0_sm.txdata = i2c0_sm.tx_cmd;
-  }
+  return true;
+}
 
-  // if starting the I2C1 peripheral ...
-  if(i2c == I2C1)
+
+/***************************************************************************//**
+ * @brief
+ *  Builds a bus speed profile
+ *
+ * @details
+ *  Computes the CLKDIV and CLHR register values for every level of the
+ *  profile once, so that switching speed between transactions is two
+ *  register writes. Level 0 runs at the requested frequency and CLHR; each
+ *  further level halves the frequency with the standard 4:4 CLHR. The
+ *  profile starts at level 0. The bus registers are restored afterwards.
+ *
+ * @note
+ *  Must be called with the bus idle, after i2c_open(). The values depend
+ *  on the HFPER frequency, so profiles must be rebuilt if it changes.
+ *
+ * @param[in] i2c
+ *  Pointer to desired I2Cn peripheral (either I2C0 or I2C1)
+ *
+ * @param[out] profile
+ *  Profile to build; owned by the caller and must outlive its transactions
+ *
+ * @param[in] freq
+ *  Max bus frequency of level 0
+ *
+ * @param[in] clhr
+ *  Clock low/high ratio of level 0
+ ******************************************************************************/
+void i2c_profile_init(I2C_TypeDef *i2c, I2C_PROFILE_STRUCT *profile, uint32_t freq, I2C_ClockHLR_TypeDef clhr)
+{
+  // save the current bus speed
+  uint32_t clkdiv = i2c->CLKDIV;
+  uint32_t ctrl = i2c->CTRL;
+
+  // will trigger if a transaction is running
+  EFM_ASSERT(i2c_sm_table[I2C_INSTANCE_NUM(i2c)].busy == I2C_BUS_READY);
+
+  // let emlib compute each level and keep the resulting register values
+  for(uint32_t level = 0; level < I2C_PROFILE_LEVELS; level++)
   {
-      // halt until bus is ready
-      while(i2c1_sm.busy);
+      I2C_BusFreqSet(i2c, I2C_PROFILE_REFFREQ, freq, clhr);
+      profile->level[level].clkdiv = i2c->CLKDIV;
+      profile->level[level].clhr = i2c->CTRL & _I2C_CTRL_CLHR_MASK;
 
-      // will trigger if a previous I2C operation has not completed
-      EFM_ASSERT((I2C1->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
+      // next level: half the frequency, most tolerant ratio
+      freq >>= 1;
+      clhr = I2C_DERATE_CLHR;
+  }
+  profile->level_now = 0;
+  profile->error_run = 0;
 
-      // set busy bit
-      i2c1_sm.busy = I2C_BUS_BUSY;
-
-      // initialize static I2C1 state machine
-      i2c1_sm.I2Cn = i2c;
-      i2c1_sm.curr_state = req_res;
-      i2c1_sm.slave_addr = slave_addr;
-      i2c1_sm.r_w = r_w;
-      i2c1_sm.num_bytes = READ_2_BYTES;
-      i2c1_sm.rxdata = &i2c1_sm.I2Cn->RXDATA;
-      i2c1_sm.txdata = &i2c1_sm.I2Cn->TXDATA;
-      i2c1_sm.data = read_result;
-      i2c1_sm.i2c_cb = si7021_cb;
+  // restore the bus speed
+  i2c->CLKDIV = clkdiv;
+  i2c->CTRL = ctrl;
+}
 
-      // enable interrupts
-      i2c1_sm.I2Cn->IEN = SI7021_I2C_IEN_MASK;
-      NVIC_EnableIRQ(I2C1_IRQn);
 
-      // start I2C1 peripheral
-      i2c1_sm.I2Cn->CMD = I2C_CMD_START;
+/***************************************************************************//**
+ * @brief
+ *  Reports bus recovery activity
+ *
+ * @param[in] i2c
+ *  Pointer to desired I2Cn peripheral (either I2C0 or I2C1)
+ *
+ * @param[out] count
+ *  Number of bus recoveries run since the peripheral was opened
+ *
+ * @param[out] last_us
+ *  Duration of the last bus recovery in microseconds
+ ******************************************************************************/
+void i2c_recovery_get(I2C_TypeDef *i2c, uint32_t *count, uint32_t *last_us)
+{
+  volatile I2C_STATE_MACHINE_STRUCT *i2c_sm = &i2c_sm_table[I2C_INSTANCE_NUM(i2c)];
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  *count = i2c_sm->recovery_count;
+  *last_us = i2c_sm->recovery_us;
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+}
+
 
-      // TODO: MOVE TO APPLICATION LAYER?
-      // send slave addr + write bit
-      i2c1_sm.tx_cmd = (slave_addr << I2C_ADDR_RW_SHIFT) | i2c1_sm.r_w;
-      *i2c1_sm.txdata = i2c1_sm.tx_cmd;
+/***************************************************************************//**
+ * @brief
+ *  Connects or isolates the bus pins
+ *
+ * @details
+ *  Isolating takes SCL and SDA away from the peripheral and disables them
+ *  (high impedance, input off; TRM 31.5.2), so a slave that is powered
+ *  down with its pull-ups is not back-fed through the pins. Connecting
+ *  restores wired-AND, routes the pins back and resets the bus, since the
+ *  slave side has just powered up.
+ *
+ * @note
+ *  Must be called with the bus idle, after i2c_open(). Nothing may be
+ *  queued while the pins are isolated.
+ *
+ * @param[in] i2c
+ *  Pointer to desired I2Cn peripheral (either I2C0 or I2C1)
+ *
+ * @param[in] enable
+ *  true to connect the pins; false to isolate them
+ ******************************************************************************/
+void i2c_pins_enable(I2C_TypeDef *i2c, bool enable)
+{
+  volatile I2C_STATE_MACHINE_STRUCT *i2c_sm = &i2c_sm_table[I2C_INSTANCE_NUM(i2c)];
+
+  // will trigger if a transaction is running
+  EFM_ASSERT(i2c_sm->busy == I2C_BUS_READY);
+
+  // already in the requested state
+  if(enable != i2c_sm->isolated)
+  {
+      return;
+  }
+
+  if(enable)
+  {
+      // wired-AND, released (TRM 31.3.1)
+      GPIO_PinModeSet(i2c_sm->scl_port, i2c_sm->scl_pin, gpioModeWiredAnd, 1);
+      GPIO_PinModeSet(i2c_sm->sda_port, i2c_sm->sda_pin, gpioModeWiredAnd, 1);
+
+      // route the pins back and start from an idle bus
+      i2c->ROUTEPEN |= i2c_sm->route_pen;
+      i2c_sm->isolated = false;
+      i2c_bus_reset(i2c_sm);
   }
+  else
+  {
+      // take the pins from the peripheral
+      i2c_sm->route_pen = i2c->ROUTEPEN & (I2C_ROUTEPEN_SCLPEN | I2C_ROUTEPEN_SDAPEN);
+      i2c->ROUTEPEN &= ~(I2C_ROUTEPEN_SCLPEN | I2C_ROUTEPEN_SDAPEN);
+
+      // disconnect them
+      GPIO_PinModeSet(i2c_sm->scl_port, i2c_sm->scl_pin, gpioModeDisabled, 0);
+      GPIO_PinModeSet(i2c_sm->sda_port, i2c_sm->sda_pin, gpioModeDisabled, 0);
+      i2c_sm->isolated = true;
+  }
+}
+
+
+#ifdef I2C_PERF_COUNTERS
+/***************************************************************************//**
+ * @brief
+ *  Reads the performance counters
+ *
+ * @details
+ *  Copies the peripheral's counters and histograms in one critical
+ *  section, so the snapshot is consistent. Optionally clears them so that
+ *  successive snapshots cover disjoint intervals.
+ *
+ * @param[in] i2c
+ *  Pointer to desired I2Cn peripheral (either I2C0 or I2C1)
+ *
+ * @param[out] snapshot
+ *  Copy of the counters
+ *
+ * @param[in] reset
+ *  true to clear the counters after copying them
+ ******************************************************************************/
+void i2c_perf_snapshot(I2C_TypeDef *i2c, I2C_PERF_STRUCT *snapshot, bool reset)
+{
+  volatile I2C_STATE_MACHINE_STRUCT *i2c_sm = &i2c_sm_table[I2C_INSTANCE_NUM(i2c)];
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
 
-  // 80ms timer delay to ensure RWM sync
-  timer_delay(I2C_80MS_DELAY);
+  *snapshot = *(I2C_PERF_STRUCT *)&i2c_sm->perf;
+  if(reset)
+  {
+      *(I2C_PERF_STRUCT *)&i2c_sm->perf = (I2C_PERF_STRUCT){0};
+  }
 
   // exit core critical to allow interrupts
   CORE_EXIT_CRITICAL();
 }
+#endif
 
 
 /***************************************************************************//**
  * @brief
- *  I2C0 peripheral IRQ Handler
+ *  I2Cn peripheral IRQ Handlers
  *
  * @details
- *  Handles ACK, NACK, RXDATAV, and MSTOP interrupts
+ *  One vector per peripheral, generated by I2C_IRQ_HANDLER. Each resolves
+ *  its state machine at compile time and hands it to i2cn_irq().
  ******************************************************************************/
-void I2C0_IRQHandler(void)
+#define I2C_IRQ_HANDLER(n)  void I2C##n##_IRQHandler(void) { i2cn_irq(&i2c_sm_table[n]); }
+
+I2C_IRQ_HANDLER(0)
+I2C_IRQ_HANDLER(1)
+
+
+/***************************************************************************//**
+ * @brief
+ *  I2Cn interrupt service
+ *
+ * @details
+ *  Handles ACK, NACK, RXDATAV, MSTOP and clock low timeout interrupts for
+ *  any instance
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the interrupting I2Cn
+ *  peripheral
+ ******************************************************************************/
+void i2cn_irq(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
 {
+  I2C_TypeDef *i2c = i2c_sm->I2Cn;
+
+#ifdef I2C_PERF_COUNTERS
+  // time the interrupt
+  uint32_t isr_start = CMU_CYCLES();
+#endif
+
   // save flags that are both enabled and raised
-  uint32_t intflags = (I2C0->IF & I2C0->IEN);
+  uint32_t intflags = (i2c->IF & i2c->IEN);
 
   // lower flags
-  I2C0->IFC = intflags;
+  i2c->IFC = intflags;
+
+  // handle clock low timeout; the transfer is lost, nothing else applies
+  if(intflags & I2C_IF_CLTO)
+  {
+      i2cn_clto(i2c_sm);
+      intflags = 0;
+  }
 
   // handle ACK
   if(intflags & I2C_IF_ACK)
   {
-      i2cn_ack_sm(&i2c0_sm);
+      i2cn_ack_sm(i2c_sm);
   }
 
   // handle NACK
   if(intflags & I2C_IF_NACK)
   {
-      i2cn_nack_sm(&i2c0_sm);
+      i2cn_nack_sm(i2c_sm);
   }
 
   // handle RXDATAV
   if(intflags & I2C_IF_RXDATAV)
   {
-      i2cn_rxdata_sm(&i2c0_sm);
+      i2cn_rxdata_sm(i2c_sm);
   }
 
   // handle MSTOP
   if(intflags & I2C_IF_MSTOP)
   {
-      i2cn_mstop_sm(&i2c0_sm);
+      i2cn_mstop_sm(i2c_sm);
+  }
+
+#ifdef I2C_PERF_COUNTERS
+  // record the interrupt duration
+  uint32_t isr_cycles = CMU_CYCLES() - isr_start;
+  i2c_sm->perf.isr_count++;
+  if(isr_cycles > i2c_sm->perf.isr_max_cycles)
+  {
+      i2c_sm->perf.isr_max_cycles = isr_cycles;
   }
+  i2c_perf_hist(i2c_sm->perf.isr_hist, isr_cycles);
+#endif
 }
 
 
 /***************************************************************************//**
  * @brief
- *  I2C1 peripheral IRQ Handler
+ *  I2C clock low timeout handler
  *
  * @details
- *  Handles ACK, NACK, RXDATAV, and MSTOP interrupts
+ *  SCL has been held low past the CLTO limit, so the transfer in progress
+ *  cannot complete. The peripheral is aborted, the bus is recovered and
+ *  the transaction completes with i2c_status_bus_error.
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
  ******************************************************************************/
-void I2C1_IRQHandler(void)
+void i2cn_clto(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
 {
-  // save flags that are both enabled and raised
-    uint32_t intflags = (I2C1->IF & I2C1->IEN);
-
-    // lower flags
-    I2C1->IFC = intflags;
-
-    // handle ACK
-    if(intflags & I2C_IF_ACK)
-    {
-      i2cn_ack_sm(&i2c1_sm);
-    }
-
-    // handle NACK
-    if(intflags & I2C_IF_NACK)
-    {
-        i2cn_nack_sm(&i2c1_sm);
-    }
-
-    // handle RXDATA
-    if(intflags & I2C_IF_RXDATAV)
-    {
-        i2cn_rxdata_sm(&i2c1_sm);
-    }
-
-    // handle MSTOP
-    if(intflags & I2C_IF_MSTOP)
-    {
-        i2cn_mstop_sm(&i2c1_sm);
-    }
+  I2C_TypeDef *i2c = i2c_sm->I2Cn;
+
+#ifdef I2C_LDMA_MODE
+  // drop any LDMA phase in flight
+  if(i2c_sm->ldma_active)
+  {
+      i2cn_ldma_stop(i2c_sm);
+  }
+#endif
+
+  // abandon the transfer and free the bus
+  i2c->CMD = I2C_CMD_ABORT;
+  i2c->CMD = I2C_CMD_CLEARTX;
+  i2cn_bus_recover(i2c_sm);
+
+  // discard flags raised while the pins were bit-banged
+  i2c->IFC = _I2C_IFC_MASK;
+
+  // fail the transaction, if one was running
+  if(i2c_sm->busy == I2C_BUS_BUSY)
+  {
+      i2cn_txn_done(i2c_sm, i2c_status_bus_error);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts the transaction at the head of the queue
+ *
+ * @details
+ *  Pops the oldest queued transaction into the state machine, sets the bus
+ *  speed of its profile, resets the buffer indexes and sends START + slave
+ *  addr for its first phase.
+ *
+ * @note
+ *  Must be called with interrupts disabled or from the I2Cn IRQ handler
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
+ ******************************************************************************/
+void i2cn_next_txn(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
+{
+  // will trigger if called with an empty queue
+  EFM_ASSERT(i2c_sm->q_count);
+
+  // pop the oldest transaction
+  i2c_sm->txn = i2c_sm->queue[i2c_sm->q_head];
+  i2c_sm->q_head = (i2c_sm->q_head + 1) & I2C_QUEUE_MASK;
+  i2c_sm->q_count--;
+
+  // run the bus at the transaction's speed
+  i2cn_speed_set(i2c_sm);
+
+#ifdef I2C_PERF_COUNTERS
+  // time the transaction from its first START; the DWT stops in EM1, the
+  // LETIMER0 keeps counting through retry backoffs and sleep
+  i2c_sm->txn_start = letimer_timer_now();
+#endif
+
+  // reset the buffer indexes
+  i2c_sm->tx_index = 0;
+  i2c_sm->rx_index = 0;
+
+  // reset the NACK retry budget
+  i2c_sm->retries_left = i2c_sm->txn->nack_retries;
+  i2c_sm->backoff_us = I2C_NACK_BACKOFF_US;
+
+  // send START + slave addr for the first phase
+  i2cn_start_phase(i2c_sm);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Sets the bus speed for the current transaction
+ *
+ * @details
+ *  Loads the precomputed CLKDIV and CLHR of the current level of the
+ *  transaction's profile, or of the bus default profile. The registers are
+ *  only written when the speed changes. Called between transactions, while
+ *  the bus is idle, as CLKDIV requires (TRM 16.5.6).
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
+ ******************************************************************************/
+void i2cn_speed_set(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
+{
+  I2C_TypeDef *i2c = i2c_sm->I2Cn;
+  I2C_PROFILE_STRUCT *profile = i2c_sm->txn->profile;
+
+  // transactions without a profile run at the bus default
+  if(!profile)
+  {
+      profile = &i2c_default_profile[I2C_INSTANCE_NUM(i2c)];
+  }
+  i2c_sm->profile = profile;
+
+  const I2C_SPEED_STRUCT *speed = &profile->level[profile->level_now];
+
+  // switch speed only when it differs
+  if((i2c->CLKDIV != speed->clkdiv) || ((i2c->CTRL & _I2C_CTRL_CLHR_MASK) != speed->clhr))
+  {
+      i2c->CLKDIV = speed->clkdiv;
+      i2c->CTRL = (i2c->CTRL & ~_I2C_CTRL_CLHR_MASK) | speed->clhr;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Tracks errors against the current transaction's speed profile
+ *
+ * @details
+ *  A success clears the profile's error run. After I2C_DERATE_ERRORS
+ *  consecutive failures the profile steps down to its next, slower level;
+ *  the new speed applies from the next transaction that uses the profile.
+ *  Derating is sticky until the profile is rebuilt.
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
+ *
+ * @param[in] status
+ *  Final status of the transaction
+ ******************************************************************************/
+void i2cn_derate(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_STATUS_Typedef status)
+{
+  I2C_PROFILE_STRUCT *profile = i2c_sm->profile;
+
+  // a success ends the error run
+  if(status == i2c_status_ok)
+  {
+      profile->error_run = 0;
+      return;
+  }
+
+  // step down a level after a run of failures
+  if((++profile->error_run >= I2C_DERATE_ERRORS) && (profile->level_now < (I2C_PROFILE_LEVELS - 1)))
+  {
+      profile->level_now++;
+      profile->error_run = 0;
+#ifdef I2C_PERF_COUNTERS
+      i2c_sm->perf.derates++;
+#endif
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts the next phase of the current transaction
+ *
+ * @details
+ *  Sends a (repeated) START followed by the slave address. If transmit
+ *  bytes are still outstanding the write bit is sent, otherwise the read
+ *  bit is sent.
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
+ ******************************************************************************/
+void i2cn_start_phase(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
+{
+  I2C_TRANSACTION_STRUCT *txn = i2c_sm->txn;
+
+  // send START command
+  i2c_sm->I2Cn->CMD = I2C_CMD_START;
+
+  // if there are still bytes to write ...
+  if(i2c_sm->tx_index < txn->tx_len)
+  {
+      // ... request resource with slave addr + write bit
+      i2c_sm->curr_state = req_res;
+      i2cn_txdata_write(i2c_sm, (txn->slave_addr << I2C_ADDR_RW_SHIFT) | I2C_WRITE_BIT);
+  }
+  else
+  {
+      // ... else request data with slave addr + read bit
+      i2c_sm->curr_state = data_req;
+      i2cn_txdata_write(i2c_sm, (txn->slave_addr << I2C_ADDR_RW_SHIFT) | I2C_READ_BIT);
+  }
 }
 
 
@@ -379,9 +952,7 @@ void I2C1_IRQHandler(void)
  ******************************************************************************/
 void i2cn_ack_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  I2C_TRANSACTION_STRUCT *txn = i2c_sm->txn;
 
   switch(i2c_sm->curr_state)
   {
@@ -389,33 +960,50 @@ void i2cn_ack_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
       // change state
       i2c_sm->curr_state = command_tx;
 
-      // send command to measure relative humidity (no hold master mode)
-      *i2c_sm->txdata = (measure_RH_NHMM);
+      // send first byte of the transmit buffer
+      i2cn_txdata_write(i2c_sm, txn->tx_buf[i2c_sm->tx_index++]);
+
+#ifdef I2C_LDMA_MODE
+      // hand the rest of a long write to the LDMA
+      i2cn_ldma_tx_start(i2c_sm);
+#endif
       break;
     case command_tx:
-      // change state
-      i2c_sm->curr_state = data_req;
-
-      // send repeated start command
-      i2c_sm->I2Cn->CMD = I2C_CMD_START;
+      // if there are more bytes to write ...
+      if(i2c_sm->tx_index < txn->tx_len)
+      {
+          // ... send next byte of the transmit buffer
+          i2cn_txdata_write(i2c_sm, txn->tx_buf[i2c_sm->tx_index++]);
+      }
+      // ... else if a read follows with a repeated start ...
+      else if((i2c_sm->rx_index < txn->rx_len) && txn->repeated_start)
+      {
+          // send repeated start + slave addr + read bit
+          i2cn_start_phase(i2c_sm);
+      }
+      // ... else the write phase is finished
+      else
+      {
+          // change state
+          i2c_sm->curr_state = m_stop;
 
-      // send slave addr + read bit
-      *i2c_sm->txdata = ((i2c_sm->slave_addr << I2C_ADDR_RW_SHIFT) | SI7021_I2C_READ);
+          // send STOP; a pending read is started from the MSTOP interrupt
+          i2c_sm->I2Cn->CMD = I2C_CMD_STOP;
+      }
       break;
     case data_req:
       // change state
       i2c_sm->curr_state = data_rx;
+
+#ifdef I2C_LDMA_MODE
+      // hand a long read to the LDMA
+      i2cn_ldma_rx_start(i2c_sm);
+#endif
       break;
     default:
       EFM_ASSERT(false);
       break;
   }
-
-  // 80ms timer delay for RWM sync
-  timer_delay(I2C_80MS_DELAY);
-
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
 }
 
 
@@ -425,8 +1013,12 @@ void i2cn_ack_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
  *
  * @details
  *  State machine function for a NACK interrupt. Functionality depends on the
- *  current state. Handles NACKs for the Request Resource, Command Transmit,
- *  and Data Request states.
+ *  current state. A NACK to the slave address or to a data byte ends the
+ *  attempt: the transmit buffer is flushed and STOP is sent to release the
+ *  bus. Whether to retry or fail the transaction is decided in the MSTOP
+ *  interrupt. A NACK during the write phase restarts the whole transaction;
+ *  a NACK to the read address (e.g. a Si7021 still converting) retries only
+ *  the read.
  *
  * @param[in] i2c_sm
  *  Static state machine struct which corresponds to the desired I2Cn
@@ -434,42 +1026,43 @@ void i2cn_ack_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
  ******************************************************************************/
 void i2cn_nack_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+#ifdef I2C_PERF_COUNTERS
+  i2c_sm->perf.nacks++;
+#endif
 
   switch(i2c_sm->curr_state)
   {
     case req_res:
-      // send repeated start command
-      i2c_sm->I2Cn->CMD = I2C_CMD_START;
-
-      // re-send slave addr + write bit
-      *i2c_sm->txdata = (i2c_sm->slave_addr | SI7021_I2C_WRITE);
-      break;
     case command_tx:
-      // send CONT command
-      i2c_sm->I2Cn->CMD = I2C_CMD_CONT;
-
-      // re-send command to measure relative humidity (no hold master mode)
-      *i2c_sm->txdata = (measure_RH_NHMM);
+      // the write phase must be resent from the first byte
+      i2c_sm->tx_index = 0;
       break;
     case data_req:
-      // re-send repeated start command
-      i2c_sm->I2Cn->CMD = I2C_CMD_START;
+      // the write phase was accepted; only the read is retried
+      break;
+#ifdef I2C_LDMA_MODE
+    case m_stop:
+      // only reachable while the LDMA is moving the write phase
+      EFM_ASSERT(i2c_sm->ldma_active);
 
-      // re-send slave addr + read bit
-      *i2c_sm->txdata = (i2c_sm->slave_addr | SI7021_I2C_READ);
+      // stop the LDMA; the write phase must be resent from the first byte
+      i2cn_ldma_stop(i2c_sm);
+      i2c_sm->tx_index = 0;
       break;
+#endif
     default:
       EFM_ASSERT(false);
+      return;
   }
 
-  // 80ms timer delay for RWM sync
-  timer_delay(I2C_80MS_DELAY);
+  // flush whatever is left in the transmit buffer
+  i2c_sm->I2Cn->CMD = I2C_CMD_CLEARTX;
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // change state
+  i2c_sm->curr_state = nack_stop;
+
+  // send STOP to release the bus
+  i2c_sm->I2Cn->CMD = I2C_CMD_STOP;
 }
 
 
@@ -479,7 +1072,8 @@ void i2cn_nack_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
  *
  * @details
  *  State machine function for an RXDATAV interrupt. Functionality depends
- *  on the current state. Handles RXDATAVs for the Data Request state
+ *  on the current state. Handles RXDATAVs for the Data Request state.
+ *  Bytes are stored in the order received (MSB first for the Si7021).
  *
  * @param[in] i2c_sm
  *  Static state machine struct which corresponds to the desired I2Cn
@@ -487,21 +1081,16 @@ void i2cn_nack_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
  ******************************************************************************/
 void i2cn_rxdata_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  I2C_TRANSACTION_STRUCT *txn = i2c_sm->txn;
 
   switch(i2c_sm->curr_state)
   {
     case data_rx:
-      // decrement num_bytes counter
-      i2c_sm->num_bytes--;
-
-      // retrieve read data, but left shift that data n number of bytes remaining
-      *i2c_sm->data |= (*i2c_sm->rxdata << (MSBYTE_SHIFT * i2c_sm->num_bytes));
+      // retrieve read data
+      txn->rx_buf[i2c_sm->rx_index++] = *i2c_sm->rxdata;
 
       // check if more data is expected ...
-      if(i2c_sm->num_bytes > 0)
+      if(i2c_sm->rx_index < txn->rx_len)
       {
           // send ACK
           i2c_sm->I2Cn->CMD = I2C_CMD_ACK;
@@ -523,12 +1112,6 @@ void i2cn_rxdata_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
       EFM_ASSERT(false);
       break;
   }
-
-  // 80ms timer delay for RWM sync
-  timer_delay(I2C_80MS_DELAY);
-
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
 }
 
 
@@ -538,9 +1121,12 @@ void i2cn_rxdata_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
  *
  * @details
  *  State machine function for an MSTOP. Functionality depends on the
- *  current state. Handles MSTOPs for the MSTOP state. Since this is the
- *  end of an I2C transaction this function also releases the bus, unblocks
- *  EM2, and schedules the Humidity Read callback event.
+ *  current state. In the MSTOP state, if the transaction still has a read
+ *  phase (write-then-read without a repeated start) the read is started
+ *  here; otherwise the transaction has completed. In the NACK STOP state
+ *  the bus has been released after a NACK: the retry is scheduled on a
+ *  one-shot timer with a doubling backoff, or the transaction fails once
+ *  its retry budget is spent.
  *
  * @param[in] i2c_sm
  *  Static state machine struct which corresponds to the desired I2Cn
@@ -548,32 +1134,373 @@ void i2cn_rxdata_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
  ******************************************************************************/
 void i2cn_mstop_sm(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  I2C_TRANSACTION_STRUCT *txn = i2c_sm->txn;
 
   switch(i2c_sm->curr_state)
   {
     case m_stop:
+#ifdef I2C_LDMA_MODE
+      // an LDMA write phase ends with the STOP generated by AUTOSE
+      if(i2c_sm->ldma_active)
+      {
+          i2cn_ldma_stop(i2c_sm);
+      }
+#endif
+
+      // if the read phase has not been started yet ...
+      if(i2c_sm->rx_index < txn->rx_len)
+      {
+          // ... send START + slave addr + read bit
+          i2cn_start_phase(i2c_sm);
+          break;
+      }
+
+      // all bytes transferred
+      i2cn_txn_done(i2c_sm, i2c_status_ok);
+      break;
+    case nack_stop:
+      // if the retry budget is spent, fail the transaction
+      if(!i2c_sm->retries_left)
+      {
+          i2cn_txn_done(i2c_sm, i2c_status_nack);
+          break;
+      }
+
+#ifdef I2C_PERF_COUNTERS
+      i2c_sm->perf.retries++;
+#endif
+
+      // change state; the bus stays owned (and EM2 blocked) while waiting
+      i2c_sm->retries_left--;
+      i2c_sm->curr_state = retry_wait;
+
+      // retry once the backoff expires
+      hw_timer_start(I2C_RETRY_TIMER_CH(I2C_INSTANCE_NUM(i2c_sm->I2Cn)), i2c_sm->backoff_us, i2c_retry_timer_cb);
+
+      // double the backoff for the next retry
+      if(i2c_sm->backoff_us < I2C_NACK_BACKOFF_MAX_US)
+      {
+          i2c_sm->backoff_us <<= 1;
+      }
+      break;
+    default:
+      EFM_ASSERT(false);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Completes the current transaction
+ *
+ * @details
+ *  Reports the transaction status, calls its completion hook, schedules its
+ *  callback event and starts the next queued transaction. Only when the queue is empty is the bus
+ *  released and EM2 unblocked.
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
+ *
+ * @param[in] status
+ *  Final status of the transaction
+ ******************************************************************************/
+void i2cn_txn_done(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_STATUS_Typedef status)
+{
+  I2C_TRANSACTION_STRUCT *txn = i2c_sm->txn;
+
+  // latch the callback event; the hook may re-submit the descriptor
+  uint32_t i2c_cb = txn->i2c_cb;
+
+  // report transaction result
+  txn->status = status;
+
+  // feed the result to the speed profile
+  i2cn_derate(i2c_sm, status);
+
+#ifdef I2C_PERF_COUNTERS
+  // count the result and record the transaction duration
+  uint32_t txn_ticks = letimer_timer_now() - i2c_sm->txn_start;
+  switch(status)
+  {
+    case i2c_status_ok:
+      i2c_sm->perf.txn_ok++;
+      break;
+    case i2c_status_nack:
+      i2c_sm->perf.txn_nack++;
+      break;
+    default:
+      i2c_sm->perf.txn_bus_error++;
+      break;
+  }
+  if(txn_ticks > i2c_sm->perf.txn_max_ticks)
+  {
+      i2c_sm->perf.txn_max_ticks = txn_ticks;
+  }
+  i2c_perf_hist(i2c_sm->perf.txn_hist, txn_ticks);
+#endif
+
+  // run the owner's completion hook; it may submit a follow-up transaction
+  if(txn->done_cb)
+  {
+      txn->done_cb(txn);
+  }
+
+  // schedule transaction call back event
+  if(i2c_cb)
+  {
+      add_scheduled_event(i2c_cb);
+  }
+
+  // if another transaction is queued ...
+  if(i2c_sm->q_count)
+  {
+      // ... start it straight away, keeping the EM2 block
+      i2cn_next_txn(i2c_sm);
+  }
+  else
+  {
       // clear I2C State Machine busy bit
       i2c_sm->busy = I2C_BUS_READY;
 
       // unblock sleep
       sleep_unblock_mode(I2C_EM_BLOCK);
+  }
+}
 
-      // schedule humidity read call back even
-      add_scheduled_event(i2c_sm->i2c_cb);
 
-      // reset the I2C bus
-      i2c_bus_reset(i2c_sm->I2Cn);
-      break;
-    default:
-      EFM_ASSERT(false);
+/***************************************************************************//**
+ * @brief
+ *  NACK backoff expiry callback
+ *
+ * @details
+ *  Runs in TIMER1 interrupt context once the backoff after a NACK has
+ *  expired and retries the phase that was NACKed.
+ *
+ * @param[in] ch
+ *  One-shot channel that expired
+ ******************************************************************************/
+void i2c_retry_timer_cb(uint32_t ch)
+{
+  volatile I2C_STATE_MACHINE_STRUCT *i2c_sm = &i2c_sm_table[I2C_RETRY_TIMER_INSTANCE(ch)];
+
+  // will trigger if the timer fired outside of a backoff
+  EFM_ASSERT(i2c_sm->curr_state == retry_wait);
+
+  // send START + slave addr for the phase that was NACKed
+  i2cn_start_phase(i2c_sm);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes a byte to the I2C transmit buffer
+ *
+ * @details
+ *  Waits on the TXBL status bit rather than a fixed timer delay before
+ *  loading TXDATA. The I2C registers sit in the HF clock domain and need no
+ *  SYNCBUSY handshake, so the only requirement is room in the transmit
+ *  buffer (TRM 16.3.7.4). In the state machine TXBL is already set when the
+ *  ACK interrupt fires, so the wait normally costs a single register read.
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
+ *
+ * @param[in] data
+ *  Byte to be loaded into the transmit buffer
+ ******************************************************************************/
+void i2cn_txdata_write(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm, uint32_t data)
+{
+  // bound the wait so that a wedged peripheral trips the assert instead of
+  // hanging the interrupt
+  uint32_t timeout = I2C_TXBL_TIMEOUT;
+
+  // wait for room in the transmit buffer
+  while(!(i2c_sm->I2Cn->STATUS & I2C_STATUS_TXBL) && --timeout);
+
+  // will trigger if the transmit buffer never emptied
+  EFM_ASSERT(timeout);
+
+  // load transmit buffer
+  *i2c_sm->txdata = data;
+}
+
+
+#ifdef I2C_LDMA_MODE
+/***************************************************************************//**
+ * @brief
+ *  Hands the rest of the write phase to the LDMA
+ *
+ * @details
+ *  Called once the first data byte has been loaded by the CPU. The LDMA
+ *  feeds TXDATA from the TXBL request and AUTOSE makes the peripheral send
+ *  STOP once the last byte is ACKed, so the write phase raises no further
+ *  interrupts until MSTOP (or NACK). A write followed by a repeated start
+ *  needs the ACK interrupt of its last byte, so it stays on the CPU path.
+ *
+ * @note
+ *  AUTOSE is set only after the LDMA is started: the CPU byte already in
+ *  the shift register keeps the transmit buffer from being seen as empty.
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
+ ******************************************************************************/
+void i2cn_ldma_tx_start(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
+{
+  I2C_TRANSACTION_STRUCT *txn = i2c_sm->txn;
+  LDMA_TransferCfg_t ldma_cfg = LDMA_TRANSFER_CFG_PERIPHERAL(i2c_sm->inst->ldma_tx_signal);
+  uint32_t remaining = txn->tx_len - i2c_sm->tx_index;
+
+  // short writes and writes followed by a repeated start stay on the CPU
+  if((remaining < (I2C_LDMA_MIN_BYTES - 1)) ||
+     ((i2c_sm->rx_index < txn->rx_len) && txn->repeated_start))
+  {
+      return;
   }
 
-  // 80ms timer delay for RWM sync
-  timer_delay(I2C_80MS_DELAY);
+  // describe the transfer: tx buffer -> TXDATA; MSTOP signals completion
+  LDMA_Descriptor_t ldma_desc = LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(&txn->tx_buf[i2c_sm->tx_index],
+                                                               &i2c_sm->I2Cn->TXDATA, remaining);
+  ldma_desc.xfer.doneIfs = 0;
+  i2c_sm->ldma_desc[0] = ldma_desc;
+
+  // silence per-byte ACK interrupts; the phase ends with STOP
+  i2c_sm->I2Cn->IEN &= ~I2C_IEN_ACK;
+  i2c_sm->tx_index = txn->tx_len;
+  i2c_sm->curr_state = m_stop;
+  i2c_sm->ldma_active = true;
+
+  // start the LDMA, then enable automatic STOP when the buffer runs empty
+  ldma_start(i2c_sm->inst->ldma_tx_ch, &ldma_cfg, (const LDMA_Descriptor_t *)i2c_sm->ldma_desc, NULL);
+  i2c_sm->I2Cn->CTRL |= I2C_CTRL_AUTOSE;
+}
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+
+/***************************************************************************//**
+ * @brief
+ *  Hands all but the last two bytes of the read phase to the LDMA
+ *
+ * @details
+ *  With AUTOACK set the peripheral ACKs each byte itself and the LDMA
+ *  drains RXDATA on the RXDATAV request, so no per-byte interrupt is taken.
+ *  The last byte must be NACKed, so AUTOACK has to be off before it is
+ *  received. A second, linked descriptor writes CTRL without AUTOACK as soon
+ *  as the LDMA has moved its last byte, a whole byte time before the last
+ *  byte can arrive, so a late LDMA done interrupt cannot turn the NACK into
+ *  an ACK: the peripheral simply stretches the clock until the RXDATAV state
+ *  machine ACKs the second to last byte and NACKs the last one.
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
+ ******************************************************************************/
+void i2cn_ldma_rx_start(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
+{
+  I2C_TRANSACTION_STRUCT *txn = i2c_sm->txn;
+  LDMA_TransferCfg_t ldma_cfg = LDMA_TRANSFER_CFG_PERIPHERAL(i2c_sm->inst->ldma_rx_signal);
+  uint32_t remaining = txn->rx_len - i2c_sm->rx_index;
+
+  // short reads stay on the CPU
+  if(remaining < I2C_LDMA_MIN_BYTES)
+  {
+      return;
+  }
+
+  // describe the transfer: RXDATA -> rx buffer, all but the last two bytes ...
+  LDMA_Descriptor_t ldma_bytes = LDMA_DESCRIPTOR_LINKREL_P2M_BYTE(&i2c_sm->I2Cn->RXDATA,
+                                                                 &txn->rx_buf[i2c_sm->rx_index],
+                                                                 remaining - I2C_LDMA_RX_CPU_BYTES, 1);
+
+  // ... then CTRL as it is now, without AUTOACK; its done flag ends the phase
+  LDMA_Descriptor_t ldma_ctrl = LDMA_DESCRIPTOR_SINGLE_WRITE(i2c_sm->I2Cn->CTRL & ~I2C_CTRL_AUTOACK,
+                                                            &i2c_sm->I2Cn->CTRL);
+  i2c_sm->ldma_desc[0] = ldma_bytes;
+  i2c_sm->ldma_desc[1] = ldma_ctrl;
+
+  // silence per-byte RXDATAV interrupts and let the peripheral ACK
+  i2c_sm->I2Cn->IEN &= ~I2C_IEN_RXDATAV;
+  i2c_sm->I2Cn->CTRL |= I2C_CTRL_AUTOACK;
+  i2c_sm->ldma_active = true;
+
+  // start the LDMA
+  ldma_start(i2c_sm->inst->ldma_rx_ch, &ldma_cfg, (const LDMA_Descriptor_t *)i2c_sm->ldma_desc, i2c_ldma_rx_done);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Stops the LDMA and returns the peripheral to per-byte interrupts
+ *
+ * @param[in] i2c_sm
+ *  Static state machine struct which corresponds to the desired I2Cn
+ *  peripheral
+ ******************************************************************************/
+void i2cn_ldma_stop(volatile I2C_STATE_MACHINE_STRUCT *i2c_sm)
+{
+  // stop both channels; stopping an idle channel is harmless
+  ldma_stop(i2c_sm->inst->ldma_tx_ch);
+  ldma_stop(i2c_sm->inst->ldma_rx_ch);
+
+  // drop automatic ACK/STOP and restore the state machine interrupts; the
+  // ACK flags raised while they were masked belong to the LDMA phase
+  i2c_sm->I2Cn->CTRL &= ~(I2C_CTRL_AUTOACK | I2C_CTRL_AUTOSE);
+  i2c_sm->I2Cn->IFC = I2C_IFC_ACK;
+  i2c_sm->I2Cn->IEN = I2C_IEN_MASK;
+  i2c_sm->ldma_active = false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  LDMA done callback for the I2C receive channels
+ *
+ * @details
+ *  Runs in LDMA interrupt context once the LDMA has moved all but the last
+ *  two bytes of a read and has cleared AUTOACK. Re-enables RXDATAV so the
+ *  state machine ACKs the second to last byte and NACKs the last; if a byte
+ *  has already arrived the I2Cn IRQ is taken as soon as this handler
+ *  returns.
+ *
+ * @param[in] ch
+ *  LDMA channel that completed
+ ******************************************************************************/
+void i2c_ldma_rx_done(uint32_t ch)
+{
+  volatile I2C_STATE_MACHINE_STRUCT *i2c_sm = &i2c_sm_table[I2C_LDMA_CH_INSTANCE(ch)];
+
+  // stop the LDMA; only the last two bytes are left
+  i2cn_ldma_stop(i2c_sm);
+  i2c_sm->rx_index = i2c_sm->txn->rx_len - I2C_LDMA_RX_CPU_BYTES;
+}
+#endif
+
+
+#ifdef I2C_PERF_COUNTERS
+/***************************************************************************//**
+ * @brief
+ *  Adds a value to a log2 histogram
+ *
+ * @details
+ *  Bin n counts values in [2^n, 2^(n+1)); zero goes to bin 0 and values
+ *  past the last bin are counted in it. One CLZ, no division.
+ *
+ * @param[in] hist
+ *  Histogram of I2C_PERF_BINS bins
+ *
+ * @param[in] value
+ *  Value to count
+ ******************************************************************************/
+void i2c_perf_hist(volatile uint32_t *hist, uint32_t value)
+{
+  uint32_t bin = 31 - __CLZ(value | 1);
+
+  // clamp to the last bin
+  if(bin >= I2C_PERF_BINS)
+  {
+      bin = I2C_PERF_BINS - 1;
+  }
+  hist[bin]++;
 }
+#endif
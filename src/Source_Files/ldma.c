@@ -0,0 +1,143 @@
+/***************************************************************************//**
+ * @file
+ *   ldma.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/20/2022
+ * @brief
+ *   LDMA driver: channel start/stop and transfer-done dispatch
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "ldma.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+static bool ldma_opened;                                    // true once LDMA_Init has run
+static void (*ldma_done_cb[LDMA_CH_COUNT])(uint32_t ch);    // per-channel transfer done callbacks
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *  Opens the LDMA peripheral.
+ *
+ * @details
+ *  Enables the LDMA clock and interrupt through LDMA_Init. Safe to call from
+ *  every driver that uses a channel; only the first call initializes.
+ ******************************************************************************/
+void ldma_open(void)
+{
+  // instantiate a default LDMA init struct
+  LDMA_Init_t ldma_init = LDMA_INIT_DEFAULT;
+
+  // only initialize once
+  if(ldma_opened)
+  {
+      return;
+  }
+
+  // enable LDMA clock, reset channels and enable the LDMA IRQ
+  LDMA_Init(&ldma_init);
+
+  ldma_opened = true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts a transfer on an LDMA channel.
+ *
+ * @details
+ *  Registers the channel's done callback and loads the descriptor. The
+ *  callback runs in LDMA interrupt context, and only for descriptors with
+ *  doneIfs set.
+ *
+ * @param[in] ch
+ *  LDMA channel
+ *
+ * @param[in] cfg
+ *  Transfer configuration (peripheral request signal)
+ *
+ * @param[in] desc
+ *  Transfer descriptor
+ *
+ * @param[in] done_cb
+ *  Function called when the transfer completes, or NULL for none
+ ******************************************************************************/
+void ldma_start(uint32_t ch, const LDMA_TransferCfg_t *cfg,
+                const LDMA_Descriptor_t *desc, void (*done_cb)(uint32_t ch))
+{
+  EFM_ASSERT(ldma_opened && (ch < LDMA_CH_COUNT));
+
+  // register callback before the transfer can complete
+  ldma_done_cb[ch] = done_cb;
+
+  // load descriptor and enable the channel
+  LDMA_StartTransfer(ch, cfg, desc);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Stops a transfer on an LDMA channel.
+ *
+ * @param[in] ch
+ *  LDMA channel
+ ******************************************************************************/
+void ldma_stop(uint32_t ch)
+{
+  EFM_ASSERT(ch < LDMA_CH_COUNT);
+
+  // disable the channel and its done interrupt
+  LDMA_StopTransfer(ch);
+
+  ldma_done_cb[ch] = NULL;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  LDMA peripheral IRQ Handler
+ *
+ * @details
+ *  Dispatches the done callback of every channel whose transfer completed
+ ******************************************************************************/
+void LDMA_IRQHandler(void)
+{
+  // save flags that are both enabled and raised
+  uint32_t intflags = (LDMA->IF & LDMA->IEN);
+
+  // lower flags
+  LDMA->IFC = intflags;
+
+  // will trigger on an LDMA bus error
+  EFM_ASSERT(!(intflags & LDMA_IF_ERROR));
+
+  // only the channel done flags remain
+  intflags &= _LDMA_IF_DONE_MASK;
+
+  // handle every completed channel
+  while(intflags)
+  {
+      uint32_t ch = 31 - __CLZ(intflags);
+      intflags &= ~(1UL << ch);
+
+      if(ldma_done_cb[ch])
+      {
+          ldma_done_cb[ch](ch);
+      }
+  }
+}
@@ -21,11 +21,25 @@
 static uint32_t scheduled_comp0_cb;   // scheduled compare0 call back
 static uint32_t scheduled_comp1_cb;   // scheduled compare1 callback
 static uint32_t scheduled_uf_cb;      // scheduled underflow callback
+static bool letimer_timer_mode;       // true once LETIMER0 is the software timer time base
+static uint32_t letimer_ticks;        // software timer tick count at the last resynchronization
+static uint32_t letimer_sync_cnt;     // CNT at the last resynchronization
+static LETIMER_TIMER_STRUCT *letimer_heap[LETIMER_TIMER_MAX]; // armed timers, a min-heap on deadline
+static uint32_t letimer_heap_count;   // armed timers
+static uint32_t letimer_comp1;        // COMP1 value last written
+static LETIMER_WAKE_STRUCT letimer_wake; // wakeup counters
 
 
 //***********************************************************************************
 // static/private functions
 //***********************************************************************************
+static uint32_t letimer_timer_sync(void);
+static void letimer_timer_arm(uint32_t now);
+static void letimer_timer_service(void);
+static void letimer_heap_place(LETIMER_TIMER_STRUCT *timer, uint32_t pos);
+static void letimer_heap_push(LETIMER_TIMER_STRUCT *timer, uint32_t now);
+static void letimer_heap_remove(LETIMER_TIMER_STRUCT *timer, uint32_t now);
+static void letimer_heap_sift(uint32_t pos, uint32_t now);
 
 
 //***********************************************************************************
@@ -119,11 +133,20 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
 	// Enable Interrupts
   NVIC_EnableIRQ(LETIMER0_IRQn);    // enable NVIC IRQ for LETIMER0
 
-	// enable comp1 interrupts
-	letimer->IEN |= _LETIMER_IEN_COMP1_MASK;
-
-	// enable underflow interrupts
-	letimer->IEN |= _LETIMER_IEN_UF_MASK;
+	// enable only the interrupts the application consumes; every enabled
+	// source wakes the core once per period
+	if(app_letimer_struct->comp0_irq_enable)
+	{
+	    letimer->IEN |= LETIMER_IEN_COMP0;
+	}
+	if(app_letimer_struct->comp1_irq_enable)
+	{
+	    letimer->IEN |= _LETIMER_IEN_COMP1_MASK;
+	}
+	if(app_letimer_struct->uf_irq_enable)
+	{
+	    letimer->IEN |= _LETIMER_IEN_UF_MASK;
+	}
 
 	/* Configure scheduled callbacks */
 	scheduled_comp0_cb = app_letimer_struct->comp0_cb;
@@ -211,6 +234,9 @@ void LETIMER0_IRQHandler(void)
   // clear LETIMER0 interrupt flag;
   LETIMER0->IFC = int_flag;
 
+  // count the wakeup
+  letimer_wake.wakeups++;
+
   // handle COMP0 interrupt source
   if(int_flag & LETIMER_IF_COMP0)
   {
@@ -222,9 +248,18 @@ void LETIMER0_IRQHandler(void)
   // handle COMP1 interrupt source
   if(int_flag & LETIMER_IF_COMP1)
   {
-      add_scheduled_event(scheduled_comp1_cb);
-      // assert to ensure flag is cleared
+      // assert to ensure flag is cleared; re-arming COMP1 below may raise it again
       EFM_ASSERT(!(LETIMER0->IF & LETIMER_IF_COMP1));
+
+      // software timers: the nearest deadline, or the horizon, is reached
+      if(letimer_timer_mode)
+      {
+          letimer_timer_service();
+      }
+      else
+      {
+          add_scheduled_event(scheduled_comp1_cb);
+      }
   }
 
   // handle UF interrupt source
@@ -235,3 +270,505 @@ void LETIMER0_IRQHandler(void)
       EFM_ASSERT(!(LETIMER0->IF & LETIMER_IF_UF));
   }
 }
+
+
+/***************************************************************************//**
+ * @brief
+ *   Driver to open LETIMER0 as the time base of the software timers
+ *
+ * @details
+ *   The counter runs free over its full range with no outputs, and COMP1
+ *   is armed for the nearest software timer deadline. Any number of
+ *   one-shot and periodic timers, up to LETIMER_TIMER_MAX, share the one
+ *   compare; each schedules its own callback event when it expires.
+ *   Ticks are LETIMER_HZ.
+ *
+ *   Tickless: the core is woken only at a deadline. No underflow or
+ *   periodic interrupt is used, and COMP1 is disabled while no timer is
+ *   armed.
+ *
+ * @note
+ *   Replaces PWM mode; start the counter with letimer_start().
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral
+ *   being opened; LETIMER0 only
+ *
+ * @param[in] debug_run
+ *   True = keep LETIMER running while halted
+ *
+ ******************************************************************************/
+void letimer_timer_open(LETIMER_TypeDef *letimer, bool debug_run)
+{
+  LETIMER_Init_TypeDef letimer_timer_values;
+
+  // the interrupt handler services LETIMER0
+  EFM_ASSERT(letimer == LETIMER0);
+
+  // enable the routed clock to the LETIMER0 peripheral
+  CMU_ClockEnable(cmuClock_LETIMER0, true);
+
+  // Initialize letimer to count down through its full range, no outputs
+  letimer_timer_values.bufTop = false;
+  letimer_timer_values.comp0Top = false;            // reload the maximum count at underflow
+  letimer_timer_values.topValue = 0;
+  letimer_timer_values.debugRun = debug_run;
+  letimer_timer_values.enable = false;              // started with letimer_start()
+  letimer_timer_values.out0Pol = DEASSERT;
+  letimer_timer_values.out1Pol = DEASSERT;
+  letimer_timer_values.repMode = letimerRepeatFree;
+  letimer_timer_values.ufoa0 = letimerUFOANone;
+  letimer_timer_values.ufoa1 = letimerUFOANone;
+  LETIMER_Init(letimer, &letimer_timer_values);
+
+  // Wait until the CMD register has been synchronized
+  while(letimer->SYNCBUSY);
+
+  // no timers armed; tick count starts at 0
+  letimer_heap_count = 0;
+  letimer_ticks = 0;
+  letimer_sync_cnt = letimer->CNT;
+  letimer_comp1 = UINT32_MAX;                       // out of range: the first arm writes COMP1
+  letimer_timer_mode = true;
+
+  // no outputs
+  letimer->ROUTEPEN = 0;
+
+  // Clear Interrupt Flags; COMP1 is enabled once a timer is armed
+  letimer->IFC = _LETIMER_IFC_MASK;
+  letimer->IEN = 0;
+  NVIC_EnableIRQ(LETIMER0_IRQn);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Driver to read the software timer tick count
+ *
+ * @details
+ *   Exact while a timer is armed. With none armed nothing resynchronizes
+ *   the count, so an idle stretch longer than a counter wrap is counted
+ *   modulo the wrap.
+ *
+ * @return
+ *   Ticks (LETIMER_HZ) since letimer_timer_open(); wraps every 2^32 ticks
+ *
+ ******************************************************************************/
+uint32_t letimer_timer_now(void)
+{
+  // make atomic
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  uint32_t now = letimer_ticks + ((letimer_sync_cnt - LETIMER0->CNT) & _LETIMER_CNT_MASK);
+
+  // allow interrupts
+  CORE_EXIT_CRITICAL();
+
+  return now;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Driver to start a software timer
+ *
+ * @details
+ *   O(log n) in the number of armed timers. A timer that is already armed
+ *   is restarted. A periodic timer's deadlines are a whole number of
+ *   periods apart, so it does not drift however late its events are
+ *   handled.
+ *
+ * @param[in] timer
+ *   Timer to start; must stay valid until it expires or is cancelled
+ *
+ * @param[in] delay
+ *   Ticks until the first expiry (at least 1)
+ *
+ * @param[in] period
+ *   Ticks between later expiries; 0 for a one-shot timer
+ *
+ * @param[in] cb
+ *   Callback event scheduled at each expiry
+ *
+ ******************************************************************************/
+void letimer_timer_start(LETIMER_TIMER_STRUCT *timer, uint32_t delay, uint32_t period, uint32_t cb)
+{
+  EFM_ASSERT(letimer_timer_mode);
+  EFM_ASSERT(delay && (delay <= INT32_MAX) && (period <= INT32_MAX));
+
+  // make atomic
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  uint32_t now = letimer_timer_sync();
+
+  // restart: leave the heap first
+  if(timer->slot)
+  {
+      letimer_heap_remove(timer, now);
+  }
+
+  EFM_ASSERT(letimer_heap_count < LETIMER_TIMER_MAX);
+  timer->deadline = now + delay;
+  timer->period = period;
+  timer->cb = cb;
+  letimer_heap_push(timer, now);
+
+  // the nearest deadline may have changed
+  letimer_timer_arm(now);
+
+  // allow interrupts
+  CORE_EXIT_CRITICAL();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Driver to cancel a software timer
+ *
+ * @details
+ *   O(log n) in the number of armed timers. Cancelling an idle timer does
+ *   nothing. An expiry already scheduled is not withdrawn.
+ *
+ * @param[in] timer
+ *   Timer to cancel
+ *
+ ******************************************************************************/
+void letimer_timer_cancel(LETIMER_TIMER_STRUCT *timer)
+{
+  // make atomic
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  if(timer->slot)
+  {
+      uint32_t now = letimer_timer_sync();
+      letimer_heap_remove(timer, now);
+      letimer_timer_arm(now);
+  }
+
+  // allow interrupts
+  CORE_EXIT_CRITICAL();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Resynchronizes the software timer tick count with CNT
+ *
+ * @details
+ *   The counter is narrower than the tick count, so the ticks elapsed
+ *   since the last call are added here. COMP1 is never armed more than
+ *   LETIMER_TIMER_HORIZON ahead, so this runs well within a counter wrap.
+ *   Called in a critical section.
+ *
+ * @return
+ *   Current tick count
+ *
+ ******************************************************************************/
+uint32_t letimer_timer_sync(void)
+{
+  uint32_t cnt = LETIMER0->CNT;
+
+  // CNT counts down
+  letimer_ticks += (letimer_sync_cnt - cnt) & _LETIMER_CNT_MASK;
+  letimer_sync_cnt = cnt;
+
+  return letimer_ticks;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Arms COMP1 for the nearest deadline
+ *
+ * @details
+ *   At most LETIMER_TIMER_HORIZON ahead of the last resynchronization,
+ *   and at least LETIMER_TIMER_MIN_TICKS ahead of CNT as read here, so the
+ *   compare reaches the counter clock domain before the counter reaches
+ *   it. A deadline that is nearer, or already due, is served up to
+ *   LETIMER_TIMER_MIN_TICKS late rather than missed. COMP1 is only
+ *   written when the nearest deadline moves, and its interrupt is
+ *   disabled while no timer is armed. Called in a critical section,
+ *   after letimer_timer_sync().
+ *
+ * @note
+ *   A COMP1 write takes LETIMER_TIMER_SYNC_TICKS to reach the counter. If
+ *   the counter is that close to the compare value once it is written,
+ *   having been held up on the way, the match would only come round again
+ *   after a full counter wrap, so the COMP1 interrupt is raised in
+ *   software instead.
+ *
+ * @param[in] now
+ *   Current tick count
+ *
+ ******************************************************************************/
+static void letimer_timer_arm(uint32_t now)
+{
+  uint32_t delta = LETIMER_TIMER_HORIZON;
+  uint32_t comp1;
+  uint32_t elapsed;
+  uint32_t lag = 0;
+
+  // nothing to wake for
+  if(!letimer_heap_count)
+  {
+      LETIMER0->IEN &= ~LETIMER_IEN_COMP1;
+      return;
+  }
+
+  int32_t due = (int32_t)(letimer_heap[0]->deadline - now);
+  if(due < 0)
+  {
+      delta = 0;
+  }
+  else if((uint32_t)due < delta)
+  {
+      delta = due;
+  }
+
+  // no nearer than LETIMER_TIMER_MIN_TICKS ahead of the counter as it is
+  // now, which may have moved on since the last resynchronization
+  elapsed = (letimer_sync_cnt - LETIMER0->CNT) & _LETIMER_CNT_MASK;
+  if(delta < (elapsed + LETIMER_TIMER_MIN_TICKS))
+  {
+      delta = elapsed + LETIMER_TIMER_MIN_TICKS;
+  }
+
+  // CNT counts down to the compare value; the same deadline gives the
+  // same value whenever it is computed
+  comp1 = (letimer_sync_cnt - delta) & _LETIMER_CNT_MASK;
+  if(comp1 != letimer_comp1)
+  {
+      LETIMER_CompareSet(LETIMER0, COMP1, comp1);
+      letimer_comp1 = comp1;
+      letimer_wake.comp1_writes++;
+      lag = LETIMER_TIMER_SYNC_TICKS;
+  }
+
+  // first timer armed: drop a match flagged while disabled
+  if(!(LETIMER0->IEN & LETIMER_IEN_COMP1))
+  {
+      LETIMER0->IFC = LETIMER_IF_COMP1;
+      LETIMER0->IEN |= LETIMER_IEN_COMP1;
+  }
+
+  // if the counter has reached the compare value, or gets there before
+  // a new value written above does, the match is missed, or was just
+  // dropped above: raise it
+  elapsed = (letimer_sync_cnt - LETIMER0->CNT) & _LETIMER_CNT_MASK;
+  if((elapsed >= delta) || ((elapsed + lag) > delta))
+  {
+      LETIMER0->IFS = LETIMER_IFS_COMP1;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Services the software timers on a COMP1 match
+ *
+ * @details
+ *   Runs in LETIMER0 interrupt context. Schedules the callback event of
+ *   every timer that is due, re-arms the periodic ones one period on, and
+ *   arms COMP1 for the new nearest deadline. A periodic timer that fell
+ *   more than a period behind skips the periods it missed.
+ *
+ ******************************************************************************/
+void letimer_timer_service(void)
+{
+  // make atomic
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  uint32_t now = letimer_timer_sync();
+  uint32_t expiries = letimer_wake.expiries;
+
+  // expire every timer that is due, nearest first
+  while(letimer_heap_count && ((int32_t)(letimer_heap[0]->deadline - now) <= 0))
+  {
+      LETIMER_TIMER_STRUCT *timer = letimer_heap[0];
+      letimer_heap_remove(timer, now);
+      add_scheduled_event(timer->cb);
+      letimer_wake.expiries++;
+
+      if(timer->period)
+      {
+          timer->deadline += timer->period;
+          if((int32_t)(timer->deadline - now) <= 0)
+          {
+              timer->deadline = now + timer->period;
+          }
+          letimer_heap_push(timer, now);
+      }
+  }
+
+  // a wakeup with nothing to do: the horizon, or a cancelled deadline
+  if(letimer_wake.expiries == expiries)
+  {
+      letimer_wake.idle_wakeups++;
+  }
+
+  letimer_timer_arm(now);
+
+  // allow interrupts
+  CORE_EXIT_CRITICAL();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Driver to read the LETIMER0 wakeup counters
+ *
+ * @details
+ *   wakeups against expiries shows how many times the core was woken for
+ *   nothing.
+ *
+ * @param[out] snapshot
+ *   Counter values
+ *
+ * @param[in] reset
+ *   true to zero the counters after reading them
+ *
+ ******************************************************************************/
+void letimer_wake_snapshot(LETIMER_WAKE_STRUCT *snapshot, bool reset)
+{
+  // make atomic
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  *snapshot = letimer_wake;
+  if(reset)
+  {
+      letimer_wake.wakeups = 0;
+      letimer_wake.expiries = 0;
+      letimer_wake.idle_wakeups = 0;
+      letimer_wake.comp1_writes = 0;
+  }
+
+  // allow interrupts
+  CORE_EXIT_CRITICAL();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Stores a timer at a deadline heap position
+ *
+ * @param[in] timer
+ *   Timer to store
+ *
+ * @param[in] pos
+ *   Heap position
+ *
+ ******************************************************************************/
+void letimer_heap_place(LETIMER_TIMER_STRUCT *timer, uint32_t pos)
+{
+  letimer_heap[pos] = timer;
+  timer->slot = pos + 1;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Adds a timer to the deadline heap
+ *
+ * @param[in] timer
+ *   Idle timer with its deadline set
+ *
+ * @param[in] now
+ *   Current tick count; deadlines are compared relative to it
+ *
+ ******************************************************************************/
+void letimer_heap_push(LETIMER_TIMER_STRUCT *timer, uint32_t now)
+{
+  letimer_heap_place(timer, letimer_heap_count++);
+  letimer_heap_sift(letimer_heap_count - 1, now);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Removes a timer from the deadline heap
+ *
+ * @details
+ *   The last entry fills the hole and is sifted to its place.
+ *
+ * @param[in] timer
+ *   Armed timer
+ *
+ * @param[in] now
+ *   Current tick count
+ *
+ ******************************************************************************/
+void letimer_heap_remove(LETIMER_TIMER_STRUCT *timer, uint32_t now)
+{
+  uint32_t pos = timer->slot - 1;
+  LETIMER_TIMER_STRUCT *last = letimer_heap[--letimer_heap_count];
+
+  timer->slot = 0;
+  if(last != timer)
+  {
+      letimer_heap_place(last, pos);
+      letimer_heap_sift(pos, now);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Restores the heap order around one entry
+ *
+ * @details
+ *   Moves the entry up past later parents, or down past earlier
+ *   children. Deadlines are compared as signed distances from now, so
+ *   the order holds across a tick count wrap.
+ *
+ * @param[in] pos
+ *   Heap position of the entry
+ *
+ * @param[in] now
+ *   Current tick count
+ *
+ ******************************************************************************/
+void letimer_heap_sift(uint32_t pos, uint32_t now)
+{
+  LETIMER_TIMER_STRUCT *timer = letimer_heap[pos];
+  int32_t due = (int32_t)(timer->deadline - now);
+
+  // up
+  while(pos)
+  {
+      uint32_t parent = (pos - 1) / 2;
+      if((int32_t)(letimer_heap[parent]->deadline - now) <= due)
+      {
+          break;
+      }
+      letimer_heap_place(letimer_heap[parent], pos);
+      pos = parent;
+  }
+
+  // down
+  for(;;)
+  {
+      uint32_t child = (2 * pos) + 1;
+      if(child >= letimer_heap_count)
+      {
+          break;
+      }
+      if(((child + 1) < letimer_heap_count) &&
+         ((int32_t)(letimer_heap[child + 1]->deadline - now) < (int32_t)(letimer_heap[child]->deadline - now)))
+      {
+          child++;
+      }
+      if((int32_t)(letimer_heap[child]->deadline - now) >= due)
+      {
+          break;
+      }
+      letimer_heap_place(letimer_heap[child], pos);
+      pos = child;
+  }
+
+  letimer_heap_place(timer, pos);
+}
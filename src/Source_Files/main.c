@@ -0,0 +1,73 @@
+/***************************************************************************//**
+ * @file
+ *   main.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   09/08/2022
+ * @brief
+ *   Board start-up and the scheduler main loop
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "main.h"
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   Program entry
+ *
+ * @details
+ *   Applies the chip errata, configures the DCDC regulator and the HF
+ *   clock, and opens the application's peripherals. The main loop runs
+ *   every scheduled event through scheduler_dispatch(), highest priority
+ *   first, then sleeps in the lowest energy mode allowed until an interrupt
+ *   schedules more work. Handlers never clear their own events; the
+ *   dispatcher does.
+ ******************************************************************************/
+int main(void)
+{
+  EMU_DCDCInit_TypeDef dcdcInit = EMU_DCDCINIT_DEFAULT;
+  CMU_HFXOInit_TypeDef hfxoInit = CMU_HFXOINIT_DEFAULT;
+  EMU_EM23Init_TypeDef em23Init = EMU_EM23INIT_DEFAULT;
+
+  // chip errata
+  CHIP_Init();
+
+  // DCDC regulator and HFXO with kit specific parameters; low power EM2/3
+  EMU_DCDCInit(&dcdcInit);
+  em23Init.vScaleEM23Voltage = emuVScaleEM23_LowPower;
+  EMU_EM23Init(&em23Init);
+  CMU_HFXOInit(&hfxoInit);
+
+  // run HFCLK from the HFRCO and switch the HFXO off
+  CMU_HFRCOBandSet(MCU_HFXO_FREQ);
+  CMU_OscillatorEnable(cmuOsc_HFRCO, true, true);
+  CMU_ClockSelectSet(cmuClock_HF, cmuSelect_HFRCO);
+  CMU_OscillatorEnable(cmuOsc_HFXO, false, false);
+
+  // open / initialize all the peripherals the application uses
+  app_peripheral_setup();
+
+  while(1)
+  {
+      // run every scheduled event, highest priority first
+      while(scheduler_dispatch());
+
+      // sleep only if nothing was scheduled since the last dispatch; an
+      // interrupt taken with PRIMASK set still wakes the core, and is
+      // serviced as soon as the critical section ends
+      CORE_DECLARE_IRQ_STATE;
+      CORE_ENTER_CRITICAL();
+      if(!get_scheduled_events())
+      {
+          enter_sleep();
+      }
+      CORE_EXIT_CRITICAL();
+  }
+}
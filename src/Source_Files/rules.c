@@ -0,0 +1,133 @@
+/***************************************************************************//**
+ * @file
+ *   rules.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/22/2022
+ * @brief
+ *   Threshold rules with hysteresis for sensor driven outputs
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "rules.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *  Initializes a rule table
+ *
+ * @details
+ *  Every rule starts in the unknown state, so the first value evaluated
+ *  on its channel drives its output either way.
+ *
+ * @param[in] rules
+ *  Rule table
+ *
+ * @param[in] count
+ *  Number of rules in the table
+ ******************************************************************************/
+void rules_init(RULE_STRUCT *rules, uint32_t count)
+{
+  for(uint32_t n = 0; n < count; n++)
+  {
+      EFM_ASSERT(rules[n].hysteresis >= 0);
+      rules[n].state = rule_state_unknown;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Evaluates a new value against the rules of its channel
+ *
+ * @details
+ *  Integer compares only. Inside the hysteresis band a rule keeps its
+ *  state, so a value hovering at the threshold does not chatter. A rule's
+ *  action is called only when its state changes; repeated values on the
+ *  same side call nothing.
+ *
+ * @param[in] rules
+ *  Rule table
+ *
+ * @param[in] count
+ *  Number of rules in the table
+ *
+ * @param[in] channel
+ *  Sample stream the value belongs to
+ *
+ * @param[in] value
+ *  New value, in the units of the channel
+ ******************************************************************************/
+void rules_eval(RULE_STRUCT *rules, uint32_t count, uint32_t channel, int32_t value)
+{
+  for(uint32_t n = 0; n < count; n++)
+  {
+      RULE_STRUCT *rule = &rules[n];
+      RULE_STATE_Typedef state;
+
+      if(rule->channel != channel)
+      {
+          continue;
+      }
+
+      // a rising rule activates at the threshold and releases below the band
+      if(rule->direction == rule_rising)
+      {
+          if(value >= rule->threshold)
+          {
+              state = rule_state_active;
+          }
+          else if(value < (rule->threshold - rule->hysteresis))
+          {
+              state = rule_state_inactive;
+          }
+          else
+          {
+              // inside the band: undecided rules start inactive
+              state = (rule->state == rule_state_unknown) ? rule_state_inactive : rule->state;
+          }
+      }
+      // ... a falling rule the mirror image
+      else
+      {
+          if(value <= rule->threshold)
+          {
+              state = rule_state_active;
+          }
+          else if(value > (rule->threshold + rule->hysteresis))
+          {
+              state = rule_state_inactive;
+          }
+          else
+          {
+              state = (rule->state == rule_state_unknown) ? rule_state_inactive : rule->state;
+          }
+      }
+
+      // act on transitions only
+      if(state != rule->state)
+      {
+          rule->state = state;
+          if(rule->action)
+          {
+              rule->action(state == rule_state_active);
+          }
+      }
+  }
+}
@@ -18,12 +18,21 @@
 //*******************************************************
 // static/private data
 //*******************************************************
-static uint32_t event_scheduled;    // tracks scheduled events
+static atomic_uint event_scheduled; // tracks scheduled events; set and cleared with exclusive access
+static void (*event_handler[SCHEDULER_EVENTS])(void); // handler of each event, indexed by bit
+static void (*event_queued_handler[SCHEDULER_EVENTS])(const SCHEDULER_EVENT_STRUCT *event); // handler of each queued event
+static SCHEDULER_SLOT_STRUCT event_queue[SCHEDULER_QUEUE_DEPTH]; // queued events, oldest at event_head
+static atomic_uint event_head;      // position of the oldest queued event; written by the consumer only
+static atomic_uint event_tail;      // position of the next event posted; claimed by producers
+static atomic_uint event_posted;    // events queued
+static atomic_uint event_overflows; // events dropped by a full queue
+static atomic_uint event_high_water; // most events queued at once
 
 
 //***********************************************************************************
 // static/private functions
 //***********************************************************************************
+static bool scheduler_get(SCHEDULER_EVENT_STRUCT *event);
 
 
 //***********************************************************************************
@@ -34,7 +43,8 @@ static uint32_t event_scheduled;    // tracks scheduled events
  *    Driver to open the scheduler
  *
  * @details
- *    Initializes the value of event_scheduled to zero.
+ *    Initializes the value of event_scheduled to zero, clears the
+ *    handler tables and empties the event queue.
  *
  * @note
  *    Must be an atomic operation to prevent interrupts while
@@ -48,7 +58,25 @@ void scheduler_open(void)
   CORE_ENTER_CRITICAL();
 
   // initialize events to zero
-  event_scheduled = CLEAR_SCHEDULED_EVENTS;
+  atomic_init(&event_scheduled, CLEAR_SCHEDULED_EVENTS);
+
+  // no handlers until registered
+  for(uint32_t n = 0; n < SCHEDULER_EVENTS; n++)
+  {
+      event_handler[n] = NULL;
+      event_queued_handler[n] = NULL;
+  }
+
+  // every slot is free for its first lap
+  for(uint32_t n = 0; n < SCHEDULER_QUEUE_DEPTH; n++)
+  {
+      atomic_init(&event_queue[n].seq, n);
+  }
+  atomic_init(&event_head, 0);
+  atomic_init(&event_tail, 0);
+  atomic_init(&event_posted, 0);
+  atomic_init(&event_overflows, 0);
+  atomic_init(&event_high_water, 0);
 
   // allow interrupts
   CORE_EXIT_CRITICAL();
@@ -64,8 +92,9 @@ void scheduler_open(void)
  *    intact
  *
  * @note
- *    Must be an atomic operation to prevent interrupts while
- *    updating the value of the scheduler
+ *    Atomic read-modify-write (LDREX/STREX on the Cortex-M4); an interrupt
+ *    between the load and the store makes the store fail and retry, so
+ *    no update is lost and interrupts are never masked
  *
  * @param[in] event
  *    32-bit unsigned integer value pertaining to the event to be scheduled
@@ -73,15 +102,8 @@ void scheduler_open(void)
 ******************************************************************************/
 void add_scheduled_event(uint32_t event)
 {
-  // make atomic
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
-
-  // add event
-  event_scheduled |= event;
-
-  // allow interrupts
-  CORE_EXIT_CRITICAL();
+  // add event; release publishes the data the event refers to
+  atomic_fetch_or_explicit(&event_scheduled, event, memory_order_release);
 }
 
 
@@ -94,8 +116,8 @@ void add_scheduled_event(uint32_t event)
  *    other events that may be scheduled
  *
  * @note
- *    Must be an atomic operation to prevent interrupts while
- *    updating the value of the scheduler
+ *    Atomic read-modify-write, as add_scheduled_event(); interrupts are
+ *    never masked
  *
  * @param[in] event
  *    32-bit unsigned integer value pertaining to the event to be removed
@@ -104,15 +126,8 @@ void add_scheduled_event(uint32_t event)
 ******************************************************************************/
 void remove_scheduled_event(uint32_t event)
 {
-  // make atomic
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
-
   // remove event
-  event_scheduled &= ~(event);
-
-  // allow interrupts
-  CORE_EXIT_CRITICAL();
+  atomic_fetch_and_explicit(&event_scheduled, ~(event), memory_order_relaxed);
 }
 
 
@@ -120,9 +135,12 @@ void remove_scheduled_event(uint32_t event)
  * @brief
  *    Driver to retrieve all scheduled events
  *
+ * @details
+ *    Includes the event of the oldest queued event, so the result is
+ *    non-zero whenever scheduler_dispatch() has work to do.
+ *
  * @note
- *    Must be an atomic operation to prevent interrupts while
- *    updating the value of the scheduler
+ *    Lock free; the result may be stale by the time it is returned
  *
  * @return
  *    static variable for scheduled events
@@ -130,5 +148,283 @@ void remove_scheduled_event(uint32_t event)
 ******************************************************************************/
 uint32_t get_scheduled_events(void)
 {
-  return event_scheduled;
+  uint32_t head = atomic_load_explicit(&event_head, memory_order_relaxed);
+  SCHEDULER_SLOT_STRUCT *slot = &event_queue[head & SCHEDULER_QUEUE_MASK];
+
+  // a filled slot at the head is a queued event
+  if(atomic_load_explicit(&slot->seq, memory_order_acquire) == (head + 1))
+  {
+      return atomic_load_explicit(&event_scheduled, memory_order_relaxed) | slot->event.event;
+  }
+  return atomic_load_explicit(&event_scheduled, memory_order_relaxed);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *    Driver to register the handler of an event
+ *
+ * @details
+ *    The event's bit is also its priority: the higher the bit, the sooner
+ *    the handler runs when several events are pending. Register once,
+ *    after scheduler_open().
+ *
+ * @param[in] event
+ *    32-bit unsigned integer value with the single bit of the event
+ *
+ * @param[in] handler
+ *    Function called by scheduler_dispatch() for the event
+ *
+******************************************************************************/
+void scheduler_register(uint32_t event, void (*handler)(void))
+{
+  // one bit per event: no bit, or several, has no table entry
+  if(!event || (event & (event - 1)))
+  {
+      EFM_ASSERT(false);
+      return;
+  }
+
+  // one handler per bit
+  EFM_ASSERT(handler && !event_handler[SCHEDULER_EVENT_BIT(event)]);
+
+  event_handler[SCHEDULER_EVENT_BIT(event)] = handler;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *    Driver to register the handler of a queued event
+ *
+ * @details
+ *    Events posted with scheduler_post() are passed to this handler, one
+ *    call per post, with their payload and timestamp.
+ *
+ * @param[in] event
+ *    32-bit unsigned integer value with the single bit of the event
+ *
+ * @param[in] handler
+ *    Function called by scheduler_dispatch() for each posted event
+ *
+******************************************************************************/
+void scheduler_register_queued(uint32_t event, void (*handler)(const SCHEDULER_EVENT_STRUCT *event))
+{
+  // one bit per event: no bit, or several, has no table entry
+  if(!event || (event & (event - 1)))
+  {
+      EFM_ASSERT(false);
+      return;
+  }
+
+  // one handler per bit
+  EFM_ASSERT(handler && !event_queued_handler[SCHEDULER_EVENT_BIT(event)]);
+
+  event_queued_handler[SCHEDULER_EVENT_BIT(event)] = handler;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *    Driver to queue an event with a payload
+ *
+ * @details
+ *    Unlike add_scheduled_event(), every post is delivered: two posts
+ *    before the main loop runs are two handler calls, in the order they
+ *    were posted, each with its own payload and timestamp.
+ *
+ *    Lock-free, interrupts stay enabled: a producer claims a position by
+ *    advancing event_tail with a compare-and-swap, fills the slot and
+ *    then publishes it through the slot's sequence number. An interrupt
+ *    that posts in between claims the next position; the consumer only
+ *    takes slots that have been published. Safe from any interrupt
+ *    priority, and from the main loop.
+ *
+ * @param[in] event
+ *    32-bit unsigned integer value with the single bit of the event
+ *
+ * @param[in] payload
+ *    Event data passed to the handler
+ *
+ * @return
+ *    true if queued; false if the queue was full and the event dropped
+ *
+******************************************************************************/
+bool scheduler_post(uint32_t event, uint32_t payload)
+{
+  uint32_t pos = atomic_load_explicit(&event_tail, memory_order_relaxed);
+  SCHEDULER_SLOT_STRUCT *slot;
+
+  // claim the next free position
+  for(;;)
+  {
+      slot = &event_queue[pos & SCHEDULER_QUEUE_MASK];
+      int32_t lap = (int32_t)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+
+      if(lap == 0)
+      {
+          // free for this position; on a lost race pos is reloaded
+          if(atomic_compare_exchange_weak_explicit(&event_tail, &pos, pos + 1,
+                                                   memory_order_relaxed, memory_order_relaxed))
+          {
+              break;
+          }
+      }
+      else if(lap < 0)
+      {
+          // still holds the event of the previous lap: the queue is full
+          atomic_fetch_add_explicit(&event_overflows, 1, memory_order_relaxed);
+          return false;
+      }
+      else
+      {
+          // another producer took this position
+          pos = atomic_load_explicit(&event_tail, memory_order_relaxed);
+      }
+  }
+
+  // fill the slot, then publish it
+  slot->event.event = event;
+  slot->event.payload = payload;
+  slot->event.timestamp = CMU_CYCLES();
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+  // accounting
+  atomic_fetch_add_explicit(&event_posted, 1, memory_order_relaxed);
+  uint32_t depth = pos + 1 - atomic_load_explicit(&event_head, memory_order_relaxed);
+  uint32_t high = atomic_load_explicit(&event_high_water, memory_order_relaxed);
+  while((depth > high) &&
+        !atomic_compare_exchange_weak_explicit(&event_high_water, &high, depth,
+                                               memory_order_relaxed, memory_order_relaxed))
+  {
+  }
+
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *    Driver to run the highest priority scheduled event
+ *
+ * @details
+ *    Queued events run first, one per call, oldest first; the queue is
+ *    bounded, so they cannot starve the bitmask events for long. Then
+ *    the highest pending bit is found with a single count leading zeros,
+ *    so the cost does not grow with the number of events. The bit is
+ *    cleared before the handler runs: the handler does not remove its own
+ *    event, and an interrupt that schedules the event again while it runs
+ *    is not lost. Call until it returns false, then sleep.
+ *
+ * @note
+ *    The bit is taken with an atomic AND, so interrupts are never masked.
+ *    If remove_scheduled_event() cleared it first, the next highest bit
+ *    is tried.
+ *
+ * @return
+ *    true if a handler was run; false if no event was scheduled
+ *
+******************************************************************************/
+bool scheduler_dispatch(void)
+{
+  SCHEDULER_EVENT_STRUCT queued;
+  uint32_t bit;
+
+  // queued events first
+  if(scheduler_get(&queued))
+  {
+      bit = SCHEDULER_EVENT_BIT(queued.event);
+      EFM_ASSERT(event_queued_handler[bit]);
+      event_queued_handler[bit](&queued);
+      return true;
+  }
+
+  // no critical section: an interrupt may set or remove a bit at any point
+  uint32_t events = atomic_load_explicit(&event_scheduled, memory_order_acquire);
+  do
+  {
+      // nothing scheduled
+      if(!events)
+      {
+          return false;
+      }
+
+      // take the highest priority event; the old value says whether it was still set
+      bit = SCHEDULER_EVENT_BIT(events);
+      events = atomic_fetch_and_explicit(&event_scheduled, ~(1UL << bit), memory_order_acquire);
+  } while(!(events & (1UL << bit)));
+
+  // every scheduled event must have a handler
+  EFM_ASSERT(event_handler[bit]);
+  event_handler[bit]();
+
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *    Driver to take the oldest queued event
+ *
+ * @details
+ *    Single consumer: called from the main loop only. A slot that has
+ *    been claimed but not yet published ends the queue for now.
+ *
+ * @param[out] event
+ *    Oldest queued event
+ *
+ * @return
+ *    true if an event was taken
+ *
+******************************************************************************/
+bool scheduler_get(SCHEDULER_EVENT_STRUCT *event)
+{
+  uint32_t head = atomic_load_explicit(&event_head, memory_order_relaxed);
+  SCHEDULER_SLOT_STRUCT *slot = &event_queue[head & SCHEDULER_QUEUE_MASK];
+
+  // not yet published
+  if(atomic_load_explicit(&slot->seq, memory_order_acquire) != (head + 1))
+  {
+      return false;
+  }
+
+  // copy out, move the head on, then free the slot for the next lap: a
+  // producer that claims the freed slot sees the new head, so its depth
+  // never exceeds SCHEDULER_QUEUE_DEPTH
+  *event = slot->event;
+  atomic_store_explicit(&event_head, head + 1, memory_order_relaxed);
+  atomic_store_explicit(&slot->seq, head + SCHEDULER_QUEUE_DEPTH, memory_order_release);
+
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *    Driver to read the event queue counters
+ *
+ * @details
+ *    Size SCHEDULER_QUEUE_DEPTH from the high water mark and the overflow
+ *    count of a long run.
+ *
+ * @param[out] snapshot
+ *    Counter values
+ *
+ * @param[in] reset
+ *    true to zero the counters after reading them
+ *
+******************************************************************************/
+void scheduler_queue_snapshot(SCHEDULER_QUEUE_STRUCT *snapshot, bool reset)
+{
+  if(reset)
+  {
+      snapshot->posted = atomic_exchange_explicit(&event_posted, 0, memory_order_relaxed);
+      snapshot->overflows = atomic_exchange_explicit(&event_overflows, 0, memory_order_relaxed);
+      snapshot->high_water = atomic_exchange_explicit(&event_high_water, 0, memory_order_relaxed);
+  }
+  else
+  {
+      snapshot->posted = atomic_load_explicit(&event_posted, memory_order_relaxed);
+      snapshot->overflows = atomic_load_explicit(&event_overflows, memory_order_relaxed);
+      snapshot->high_water = atomic_load_explicit(&event_high_water, memory_order_relaxed);
+  }
 }
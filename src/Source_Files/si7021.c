@@ -18,23 +18,364 @@
 //***********************************************************************************
 // static/private data
 //***********************************************************************************
-static volatile uint16_t read_result;
-static volatile uint16_t write_value;
+static SI7021_SENSOR_STRUCT si7021_sensor[SI7021_SENSOR_MAX]; // sensor registry
+static uint32_t si7021_sensor_count;                     // registered sensors
+static uint32_t si7021_sample_next;                      // first sensor started by the next si7021_sample_all()
+static bool si7021_powered;                              // true while SENSOR_EN is asserted
+static volatile bool si7021_ready;                       // true once the power-up time has elapsed
+static volatile bool si7021_off_wanted;                  // si7021_power_off() is waiting for the last sensor to go idle
+#ifndef SI7021_HOLD_MASTER
+static uint32_t si7021_timer_us;                         // delay SI7021_TIMER_CH was last armed for; 0 while idle
+
+// max time of a RH measurement, the RH conversion plus the T conversion it
+// includes, per resolution; indexed by SI7021_RES_INDEX() (Si7021-A20 DS Table 2)
+static const uint32_t si7021_conv_us[SI7021_RES_COUNT] =
+{
+  12000 + 10800,                                         // 12-bit RH, 14-bit T
+  3100 + 3800,                                           // 8-bit RH, 12-bit T
+  4500 + 6200,                                           // 10-bit RH, 13-bit T
+  7000 + 2400,                                           // 11-bit RH, 11-bit T
+};
+#endif
+
+#ifdef SI7021_CRC_CHECK
+// CRC-8 table for SI7021_CRC_POLY, generated at compile time: entry n is n
+// shifted through the polynomial eight times, MSB first
+#define SI7021_CRC_BIT(c)     ((((c) << 1) ^ ((((c) >> 7) & 1) * SI7021_CRC_POLY)) & 0xFF)
+#define SI7021_CRC_ENTRY(n)   SI7021_CRC_BIT(SI7021_CRC_BIT(SI7021_CRC_BIT(SI7021_CRC_BIT( \
+                              SI7021_CRC_BIT(SI7021_CRC_BIT(SI7021_CRC_BIT(SI7021_CRC_BIT(n))))))))
+#define SI7021_CRC_ROW(n)     SI7021_CRC_ENTRY(n),      SI7021_CRC_ENTRY(n + 1),  SI7021_CRC_ENTRY(n + 2),  SI7021_CRC_ENTRY(n + 3),  \
+                              SI7021_CRC_ENTRY(n + 4),  SI7021_CRC_ENTRY(n + 5),  SI7021_CRC_ENTRY(n + 6),  SI7021_CRC_ENTRY(n + 7),  \
+                              SI7021_CRC_ENTRY(n + 8),  SI7021_CRC_ENTRY(n + 9),  SI7021_CRC_ENTRY(n + 10), SI7021_CRC_ENTRY(n + 11), \
+                              SI7021_CRC_ENTRY(n + 12), SI7021_CRC_ENTRY(n + 13), SI7021_CRC_ENTRY(n + 14), SI7021_CRC_ENTRY(n + 15)
+
+static const uint8_t si7021_crc_table[256] =
+{
+  SI7021_CRC_ROW(0x00), SI7021_CRC_ROW(0x10), SI7021_CRC_ROW(0x20), SI7021_CRC_ROW(0x30),
+  SI7021_CRC_ROW(0x40), SI7021_CRC_ROW(0x50), SI7021_CRC_ROW(0x60), SI7021_CRC_ROW(0x70),
+  SI7021_CRC_ROW(0x80), SI7021_CRC_ROW(0x90), SI7021_CRC_ROW(0xA0), SI7021_CRC_ROW(0xB0),
+  SI7021_CRC_ROW(0xC0), SI7021_CRC_ROW(0xD0), SI7021_CRC_ROW(0xE0), SI7021_CRC_ROW(0xF0),
+};
+#endif
 
 //***********************************************************************************
 // static/private functions
 //***********************************************************************************
+static SI7021_SENSOR_STRUCT *si7021_get(uint32_t sensor);
+static bool si7021_claim(SI7021_SENSOR_STRUCT *si7021);
+static bool si7021_measure(SI7021_SENSOR_STRUCT *si7021, uint32_t si7021_cb, bool with_t);
+static void si7021_finish(SI7021_SENSOR_STRUCT *si7021);
+static void si7021_idle(SI7021_SENSOR_STRUCT *si7021);
+static bool si7021_queue(SI7021_SENSOR_STRUCT *si7021);
+static void si7021_power_done(uint32_t ch);
+static bool si7021_all_idle(void);
+static void si7021_power_down(void);
+static void si7021_off_check(void);
+static void si7021_off_done(uint32_t ch);
+static bool si7021_reg1_write(SI7021_SENSOR_STRUCT *si7021, uint8_t reg1, uint32_t si7021_cb);
+static void si7021_release(I2C_TRANSACTION_STRUCT *txn);
+static void si7021_rh_done(I2C_TRANSACTION_STRUCT *txn);
+static void si7021_reg1_written(I2C_TRANSACTION_STRUCT *txn);
+static void si7021_t_done(I2C_TRANSACTION_STRUCT *txn);
+static void si7021_probe_read(SI7021_SENSOR_STRUCT *si7021, uint8_t cmd0, uint8_t cmd1, uint32_t rx_len, void (*done_cb)(I2C_TRANSACTION_STRUCT *txn));
+static void si7021_probe_end(SI7021_SENSOR_STRUCT *si7021, SI7021_PROBE_Typedef probe);
+static void si7021_sna_done(I2C_TRANSACTION_STRUCT *txn);
+static void si7021_snb_done(I2C_TRANSACTION_STRUCT *txn);
+static void si7021_fw_done(I2C_TRANSACTION_STRUCT *txn);
+static uint32_t si7021_caps(uint8_t device);
+#ifdef SI7021_CRC_CHECK
+static uint8_t si7021_crc8(const uint8_t *data, uint32_t len);
+static bool si7021_id_check(const uint8_t *buf, uint32_t len, uint32_t stride);
+#endif
+static uint32_t si7021_code(const uint8_t *buf);
+#ifndef SI7021_HOLD_MASTER
+static void si7021_conv_started(I2C_TRANSACTION_STRUCT *txn);
+static void si7021_conv_done(uint32_t ch);
+static void si7021_conv_service(SI7021_SENSOR_STRUCT *started);
+static void si7021_fetch(SI7021_SENSOR_STRUCT *si7021);
+#endif
 
 
 //***********************************************************************************
 // function definitions
 //***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *  Powers up the Si7021 sensors
+ *
+ * @details
+ *  Asserts SENSOR_EN, reconnects the bus pins of every registered sensor
+ *  and returns straight away. Requests made before the sensors are ready
+ *  are accepted and held until si7021_power_ready(). A power cycle
+ *  returns user register 1 to its reset value, so a sensor with another
+ *  resolution selected has the register rewritten before its next
+ *  request.
+ *
+ *  timed: the power-up time runs on a one-shot timer, which keeps the
+ *  core out of EM2 until it expires; used at boot so that the rest of the
+ *  setup overlaps the warm-up.
+ *
+ *  Untimed: the caller's own schedule, typically a LETIMER compare,
+ *  covers SI7021_POWERUP_US and it calls si7021_power_ready().
+ *
+ * @param[in] timed
+ *  true to time the power-up with the one-shot timer
+ ******************************************************************************/
+void si7021_power_on(bool timed)
+{
+  // a power-down still waiting for a sensor is cancelled
+  si7021_off_wanted = false;
+
+  // already powered, e.g. that power-down never happened: nothing to do
+  if(si7021_powered)
+  {
+      return;
+  }
+
+  // power the sensors and the I2C pull-ups (UG257 6.4); every sensor is
+  // idle while powered down, so no interrupt touches them
+  GPIO_PinOutSet(SI7021_SENSOR_EN_PORT, SI7021_SENSOR_EN_PIN);
+  si7021_powered = true;
+  si7021_ready = false;
+
+  for(uint32_t n = 0; n < si7021_sensor_count; n++)
+  {
+      SI7021_SENSOR_STRUCT *si7021 = &si7021_sensor[n];
+
+      // reconnect the bus
+      i2c_pins_enable(si7021->i2c, true);
+
+      // restore the resolution ahead of any other request; held until
+      // the sensor is ready. A request already held runs first, timed
+      // for the reset resolution
+      si7021->reg1 = SI7021_REG1_RESET;
+      if(si7021->reg1_want != si7021->reg1)
+      {
+          si7021->reg1_restore = true;
+      }
+      if(!si7021->busy)
+      {
+          si7021_idle(si7021);
+      }
+  }
+
+  // Powerup Time worst case: from VDD >= 1.9 V to ready for a
+  // conversion, full temperature range
+  if(timed)
+  {
+      hw_timer_open();
+      hw_timer_start(SI7021_POWER_TIMER_CH, SI7021_POWERUP_US, si7021_power_done);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Powers down the Si7021 sensors between samples
+ *
+ * @details
+ *  Isolates SCL and SDA of every registered sensor, then removes
+ *  SENSOR_EN; the sensors and the I2C pull-ups draw nothing until the
+ *  next si7021_power_on(). If a sensor has a request in progress or held,
+ *  the power-down waits for it: the last sensor to go idle completes it,
+ *  from TIMER1 interrupt context once its bus has been released. A
+ *  si7021_power_on() before then cancels it.
+ *
+ * @return
+ *  true if the sensors were powered down now; false if the power-down is
+ *  waiting for a sensor
+ ******************************************************************************/
+bool si7021_power_off(void)
+{
+  bool off = false;
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  // power down now, or once the last busy sensor goes idle
+  if(si7021_all_idle())
+  {
+      si7021_power_down();
+      off = true;
+  }
+  else
+  {
+      si7021_off_wanted = true;
+  }
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+
+  return off;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reports whether every sensor is idle
+ *
+ * @details
+ *  Must be called with interrupts disabled or from interrupt context.
+ *
+ * @return
+ *  true if no sensor has a request in progress or held
+ ******************************************************************************/
+bool si7021_all_idle(void)
+{
+  for(uint32_t n = 0; n < si7021_sensor_count; n++)
+  {
+      if(si7021_sensor[n].busy || si7021_sensor[n].sample_pending)
+      {
+          return false;
+      }
+  }
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Removes power from idle sensors
+ *
+ * @details
+ *  Must be called with interrupts disabled, every sensor idle and every
+ *  bus released.
+ ******************************************************************************/
+void si7021_power_down(void)
+{
+  // nothing is waiting any more, and no power-up is left to time
+  si7021_off_wanted = false;
+  hw_timer_cancel(SI7021_POWER_TIMER_CH);
+  si7021_ready = false;
+
+  // isolate the bus before its pull-ups lose power
+  for(uint32_t n = 0; n < si7021_sensor_count; n++)
+  {
+      i2c_pins_enable(si7021_sensor[n].i2c, false);
+  }
+  GPIO_PinOutClear(SI7021_SENSOR_EN_PORT, SI7021_SENSOR_EN_PIN);
+  si7021_powered = false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Completes a waiting power-down once the last sensor is idle
+ *
+ * @details
+ *  Called as a sensor goes idle, from its transaction's completion hook,
+ *  while the I2Cn interrupt still owns the bus. The power-down itself
+ *  runs one timer tick later, after the bus has been released.
+ ******************************************************************************/
+void si7021_off_check(void)
+{
+  if(si7021_off_wanted && si7021_all_idle())
+  {
+      hw_timer_start(SI7021_POWER_TIMER_CH, 0, si7021_off_done);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Deferred power-down expiry callback
+ *
+ * @details
+ *  Runs in TIMER1 interrupt context. A request started since the last
+ *  sensor went idle keeps the sensors powered; its sensor checks again
+ *  when it goes idle.
+ *
+ * @param[in] ch
+ *  One-shot channel that expired
+ ******************************************************************************/
+void si7021_off_done(uint32_t ch)
+{
+  // will trigger if another channel's expiry was routed here
+  EFM_ASSERT(ch == SI7021_POWER_TIMER_CH);
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  if(si7021_off_wanted && si7021_all_idle())
+  {
+      si7021_power_down();
+  }
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Power-up time expiry callback
+ *
+ * @details
+ *  Runs in TIMER1 interrupt context.
+ *
+ * @param[in] ch
+ *  One-shot channel that expired
+ ******************************************************************************/
+void si7021_power_done(uint32_t ch)
+{
+  // will trigger if another channel's expiry was routed here
+  EFM_ASSERT(ch == SI7021_POWER_TIMER_CH);
+
+  si7021_power_ready();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Marks the sensors as powered up
+ *
+ * @details
+ *  Call once SI7021_POWERUP_US has elapsed since si7021_power_on().
+ *  Queues every transaction held back during the power-up. A held
+ *  transaction that the bus cannot take is completed with a bus error
+ *  through its own hook.
+ ******************************************************************************/
+void si7021_power_ready(void)
+{
+  EFM_ASSERT(si7021_powered);
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  si7021_ready = true;
+
+  for(uint32_t n = 0; n < si7021_sensor_count; n++)
+  {
+      SI7021_SENSOR_STRUCT *si7021 = &si7021_sensor[n];
+      if(!si7021->deferred)
+      {
+          continue;
+      }
+      si7021->deferred = false;
+      if(!i2c_init_sm(si7021->i2c, &si7021->txn))
+      {
+          si7021->txn.status = i2c_status_bus_error;
+          si7021->txn.done_cb(&si7021->txn);
+      }
+  }
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+}
+
+
 /***************************************************************************//**
  * @brief
  *  Opens the Si7021 Temperature & Humidity Sensor I2C peripheral
  *
  * @details
- *  Configures application specific I2C protocol and opens the I2C peripheral
+ *  Configures application specific I2C protocol and opens the I2C
+ *  peripheral. Sensors on the bus are added with si7021_register(). Does
+ *  not wait for the sensors to power up; si7021_power_on() must have been
+ *  called first.
  *
  * @param[in] i2c
  *  Desired I2Cn peripheral (either I2C0 or I2C1)
@@ -44,12 +385,8 @@ void si7021_i2c_open(I2C_TypeDef *i2c)
   // instantiate an app specific I2C
   I2C_OPEN_STRUCT app_i2c_open;
 
-  // set a local delay
-  uint32_t delay = DELAY80MS;
-
-  // Powerup Time (delay) worst case: From VDD ≥ 1.9 V to ready for a
-  // conversion, full temperature range (80ms)
-  timer_delay(delay);
+  // the bus pull-ups are powered with the sensors
+  EFM_ASSERT(si7021_powered);
 
   // set app specific frequency
   app_i2c_open.freq = I2C_FREQ;
@@ -68,6 +405,15 @@ void si7021_i2c_open(I2C_TypeDef *i2c)
   app_i2c_open.scl_pen = I2C_SCL_PEN;
   app_i2c_open.sda_pen = I2C_SDA_PEN;
 
+  // set GPIO pins for bus recovery
+  app_i2c_open.scl_port = SI7021_SCL_PORT;
+  app_i2c_open.scl_pin = SI7021_SCL_PIN;
+  app_i2c_open.sda_port = SI7021_SDA_PORT;
+  app_i2c_open.sda_pin = SI7021_SDA_PIN;
+
+  // set clock low timeout for the measurement mode
+  app_i2c_open.clto = SI7021_CLTO;
+
   // open I2C peripheral
   i2c_open(i2c, &app_i2c_open);
 }
@@ -75,74 +421,1292 @@ void si7021_i2c_open(I2C_TypeDef *i2c)
 
 /***************************************************************************//**
  * @brief
- *  Sends a read command to the Si7021 over I2C
+ *  Adds a Si7021 to the sensor registry
  *
  * @details
- *  Currently hard coded to read Relative Humidity (No Hold Master Mode)
+ *  Each registered sensor has its own address, result storage, transaction
+ *  descriptor and bus speed profile, so sensors on either I2Cn peripheral
+ *  can measure at the same time. The bus must already be open.
+ *
+ *  Queues the identity probe, held until the sensor has powered up: the
+ *  electronic serial number and firmware revision are read once and
+ *  cached with the device's capabilities. Requests made meanwhile wait
+ *  for the probe. A sensor that does not answer, or answers with a bad
+ *  checksum or an unknown device, is never addressed again; its requests
+ *  are dropped without touching the bus.
  *
  * @param[in] i2c
- *  Desired I2Cn peripheral (either I2C0 or I2C1)
+ *  I2Cn peripheral the sensor is on (either I2C0 or I2C1)
+ *
+ * @param[in] addr
+ *  7-bit slave address (SI7021_ADDR)
  *
  * @param[in] si7021_cb
- *  Callback event to be scheduled after read operation is complete
+ *  Callback event scheduled when a si7021_sample_all() measurement of the
+ *  sensor completes (0 for none)
+ *
+ * @return
+ *  Sensor handle passed to the other si7021 functions
+ ******************************************************************************/
+uint32_t si7021_register(I2C_TypeDef *i2c, uint32_t addr, uint32_t si7021_cb)
+{
+  EFM_ASSERT(si7021_sensor_count < SI7021_SENSOR_MAX);
+
+  // one entry per bus and address
+  for(uint32_t n = 0; n < si7021_sensor_count; n++)
+  {
+      EFM_ASSERT((si7021_sensor[n].i2c != i2c) || (si7021_sensor[n].addr != addr));
+  }
+
+  SI7021_SENSOR_STRUCT *si7021 = &si7021_sensor[si7021_sensor_count];
+  si7021->i2c = i2c;
+  si7021->addr = addr;
+  si7021->sample_cb = si7021_cb;
+  si7021->reg1 = SI7021_REG1_RESET;
+  si7021->reg1_want = SI7021_REG1_RESET;
+
+  // precompute the Si7021 bus speed profile and use it for every transaction
+  i2c_profile_init(i2c, &si7021->profile, SI7021_FREQ, SI7021_CLHR);
+  si7021->txn.profile = &si7021->profile;
+
+  // identify the sensor: the probe owns it until it ends
+  si7021->id.probe = si7021_probe_pending;
+  si7021->busy = true;
+  si7021_probe_read(si7021, read_id_byte1_1, read_id_byte1_0, SI7021_SNA_READ_BYTES, si7021_sna_done);
+  if(!si7021_queue(si7021))
+  {
+      si7021_probe_end(si7021, si7021_probe_absent);
+  }
+
+  return si7021_sensor_count++;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts a combined RH and T measurement on every registered sensor
+ *
+ * @details
+ *  The start commands are queued back to back, so every sensor converts
+ *  at the same time and each is read out while the others are still
+ *  converting; the bus is busy for well under a millisecond per sensor
+ *  against several milliseconds of conversion. The first sensor started
+ *  rotates every call so that no sensor is always last on a shared bus.
+ *  Each sensor's callback event from si7021_register() is scheduled as
+ *  its measurement completes. A sensor whose previous request is still in
+ *  progress is sampled once that request completes.
+ *
+ * @return
+ *  Number of sensors started now
  ******************************************************************************/
-void si7021_i2c_read(I2C_TypeDef *i2c, uint32_t si7021_cb)
+uint32_t si7021_sample_all(void)
 {
+  uint32_t started = 0;
+
+  // queue every start command before the first completion is handled
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
 
-  // reset read_result
-  read_result = RESET_READ_RESULT;
+  // start in round-robin order
+  for(uint32_t n = 0; n < si7021_sensor_count; n++)
+  {
+      SI7021_SENSOR_STRUCT *si7021 = &si7021_sensor[(si7021_sample_next + n) % si7021_sensor_count];
+      if(si7021->busy)
+      {
+          si7021->sample_pending = true;
+      }
+      else if(si7021_measure(si7021, si7021->sample_cb, true))
+      {
+          started++;
+      }
+  }
+  if(si7021_sensor_count)
+  {
+      si7021_sample_next = (si7021_sample_next + 1) % si7021_sensor_count;
+  }
 
   // exit core critical to allow interrupts
   CORE_EXIT_CRITICAL();
 
+  return started;
+}
+
 
-  // start the I2C protocol (READ RH)
-  i2c_init_sm(i2c, SI7021_ADDR, SI7021_I2C_WRITE, &read_result, si7021_cb);
+/***************************************************************************//**
+ * @brief
+ *  Starts a Relative Humidity measurement on the Si7021
+ *
+ * @details
+ *  The callback event is scheduled once the RH code has been read; convert
+ *  it with si7021_calc_RH(). A request made while a measurement is in
+ *  progress is dropped.
+ *
+ * @param[in] sensor
+ *  Sensor handle from si7021_register()
+ *
+ * @param[in] si7021_cb
+ *  Callback event to be scheduled after read operation is complete
+ ******************************************************************************/
+void si7021_i2c_read(uint32_t sensor, uint32_t si7021_cb)
+{
+  si7021_measure(si7021_get(sensor), si7021_cb, false);
 }
 
 
 /***************************************************************************//**
  * @brief
- *  Sends a read write to the Si7021 over I2C
+ *  Starts a combined Relative Humidity and Temperature measurement
  *
  * @details
- *  NOT YET WORKING
+ *  The sensor measures temperature as part of every RH conversion to
+ *  compensate it. After the RH code has been read that temperature is
+ *  read back with the "read T from previous RH" command, so both values
+ *  cost a single conversion. The callback event is scheduled once, after
+ *  both codes have been read; convert them with si7021_calc_RH() and
+ *  si7021_calc_T().
  *
- * @param[in] i2c
- *  Desired I2Cn peripheral (either I2C0 or I2C1)
+ * @param[in] sensor
+ *  Sensor handle from si7021_register()
  *
  * @param[in] si7021_cb
- *  Callback event to be scheduled after write operation is complete
+ *  Callback event to be scheduled after both reads are complete
  ******************************************************************************/
-void si7021_i2c_write(I2C_TypeDef *i2c, uint32_t si7021_cb)
+void si7021_i2c_read_rh_t(uint32_t sensor, uint32_t si7021_cb)
 {
-  // start the I2C protocol (W)
-  i2c_init_sm(i2c, SI7021_ADDR, SI7021_I2C_READ, &write_value, si7021_cb);
+  si7021_measure(si7021_get(sensor), si7021_cb, true);
+}
 
+
+/***************************************************************************//**
+ * @brief
+ *  Looks up a registered sensor
+ *
+ * @param[in] sensor
+ *  Sensor handle from si7021_register()
+ *
+ * @return
+ *  Registry entry of the sensor
+ ******************************************************************************/
+SI7021_SENSOR_STRUCT *si7021_get(uint32_t sensor)
+{
+  EFM_ASSERT(sensor < si7021_sensor_count);
+  return &si7021_sensor[sensor];
 }
 
 
 /***************************************************************************//**
  * @brief
- *  Converts a Relative Humidity measurement code to a percent humidity
- *  per Si7021-A20 TRM: Section 5.1.1
+ *  Claims an idle sensor for a request
  *
  * @details
- *  Atomic function due to accessing static variable
+ *  Atomic test-and-set of the busy flag, so that a request made from a
+ *  scheduler callback and one made from interrupt context cannot both
+ *  claim the sensor.
+ *
+ * @param[in] si7021
+ *  Sensor to claim
+ *
+ * @return
+ *  true if the sensor was idle and identified, and is now busy
  ******************************************************************************/
-float si7021_calc_RH(void)
+bool si7021_claim(SI7021_SENSOR_STRUCT *si7021)
 {
+  bool claimed = false;
+
   // make atomic by disallowing interrupts
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
 
-  // convert the stored RH code to percent humidity (Si7021-A20: 5.1.1)
-  float rh = ((125 * (float)read_result) / 65536) - 6;
+  // a request is still in progress, or the sensor was not found
+  if(!si7021->busy && (si7021->id.probe == si7021_probe_ok))
+  {
+      si7021->busy = true;
+      claimed = true;
+  }
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+
+  return claimed;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Runs an RH, or combined RH and T, measurement
+ *
+ * @details
+ *  No Hold Master Mode: a write-only transaction starts the conversion.
+ *  Once it completes the sensor waits out the datasheet conversion time
+ *  of its resolution on the shared conversion timer, and the two byte
+ *  result is fetched when it expires. The sensor is addressed once per
+ *  phase instead of being polled with NACKed reads.
+ *
+ *  Hold Master Mode (SI7021_HOLD_MASTER): a single write-then-read
+ *  transaction; the sensor stretches SCL until the result is ready.
+ *
+ * @param[in] si7021
+ *  Sensor to measure
+ *
+ * @param[in] si7021_cb
+ *  Callback event to be scheduled after the measurement is complete
+ *
+ * @param[in] with_t
+ *  true to read the temperature captured with the RH conversion as well
+ *
+ * @return
+ *  true if the measurement was started
+ ******************************************************************************/
+bool si7021_measure(SI7021_SENSOR_STRUCT *si7021, uint32_t si7021_cb, bool with_t)
+{
+  // a measurement is still in progress, or the sensor was not found; drop the request
+  if(!si7021_claim(si7021))
+  {
+      return false;
+  }
+  si7021->read_cb = si7021_cb;
+  si7021->with_t = with_t;
+
+  si7021->txn.slave_addr = si7021->addr;
+  si7021->txn.tx_buf = si7021->tx_buf;
+  si7021->txn.tx_len = SI7021_CMD_BYTES;
+  si7021->txn.i2c_cb = 0;
+  si7021->txn.nack_retries = SI7021_NACK_RETRIES;
+#ifdef SI7021_HOLD_MASTER
+  // describe the transaction: measure RH, then a clock-stretched 2 byte read
+  si7021->tx_buf[0] = measure_RH_HMM;
+  si7021->txn.rx_buf = si7021->read_buf;
+  si7021->txn.rx_len = SI7021_RH_READ_BYTES;
+  si7021->txn.repeated_start = true;
+  si7021->txn.done_cb = si7021_rh_done;
+#else
+  // describe the transaction: start the conversion only
+  si7021->tx_buf[0] = measure_RH_NHMM;
+  si7021->txn.rx_buf = NULL;
+  si7021->txn.rx_len = 0;
+  si7021->txn.repeated_start = false;
+  si7021->txn.done_cb = si7021_conv_started;
+#endif
+
+  // queue the I2C protocol (MEASURE RH)
+  if(!si7021_queue(si7021))
+  {
+      si7021->busy = false;
+      return false;
+  }
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Ends a measurement
+ *
+ * @details
+ *  Runs in interrupt context. The sensor accepts a new request and the
+ *  measurement's callback event is scheduled.
+ *
+ * @param[in] si7021
+ *  Sensor whose measurement ended
+ ******************************************************************************/
+void si7021_finish(SI7021_SENSOR_STRUCT *si7021)
+{
+  if(si7021->read_cb)
+  {
+      add_scheduled_event(si7021->read_cb);
+  }
+  si7021_idle(si7021);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Ends a request
+ *
+ * @details
+ *  Runs in interrupt context. The sensor accepts a new request; a
+ *  resolution requested while it was busy, or lost to a power cycle, is
+ *  written, then a sample requested while the sensor was busy starts. A
+ *  sensor the probe did not identify drops both. If this was the last busy
+ *  sensor, a waiting power-down follows.
+ *
+ * @param[in] si7021
+ *  Sensor whose request ended
+ ******************************************************************************/
+void si7021_idle(SI7021_SENSOR_STRUCT *si7021)
+{
+  si7021->busy = false;
+
+  // never address a sensor the probe did not identify
+  if(si7021->id.probe != si7021_probe_ok)
+  {
+      si7021->reg1_restore = false;
+      si7021->sample_pending = false;
+      si7021_off_check();
+      return;
+  }
+
+  // one attempt to bring user register 1 to the wanted resolution
+  if(si7021->reg1_restore)
+  {
+      uint32_t si7021_cb = si7021->reg1_cb;
+      si7021->reg1_restore = false;
+      si7021->reg1_cb = 0;
+      if(si7021->reg1_want == si7021->reg1)
+      {
+          if(si7021_cb)
+          {
+              add_scheduled_event(si7021_cb);
+          }
+      }
+      else if(si7021_reg1_write(si7021, si7021->reg1_want, si7021_cb))
+      {
+          return;
+      }
+  }
+
+  if(si7021->sample_pending)
+  {
+      si7021->sample_pending = false;
+      si7021_measure(si7021, si7021->sample_cb, true);
+  }
+
+  // the last sensor to go idle completes a waiting power-down
+  si7021_off_check();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Queues the sensor's transaction descriptor
+ *
+ * @details
+ *  Until the power-up time has elapsed the transaction is held and
+ *  reported as queued; si7021_power_done() queues it later.
+ *
+ * @param[in] si7021
+ *  Sensor whose descriptor is ready
+ *
+ * @return
+ *  true if the transaction was queued or held
+ ******************************************************************************/
+bool si7021_queue(SI7021_SENSOR_STRUCT *si7021)
+{
+  bool queued = true;
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  if(!si7021_ready)
+  {
+      si7021->deferred = true;
+  }
+  else
+  {
+      queued = i2c_init_sm(si7021->i2c, &si7021->txn);
+  }
 
   // exit core critical to allow interrupts
   CORE_EXIT_CRITICAL();
 
-  return rh;
+  return queued;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Sends a write command to the Si7021 over I2C
+ *
+ * @details
+ *  Write-only transaction carrying a single command byte (e.g. reset)
+ *
+ * @param[in] sensor
+ *  Sensor handle from si7021_register()
+ *
+ * @param[in] cmd
+ *  Si7021 command to write
+ *
+ * @param[in] si7021_cb
+ *  Callback event to be scheduled after write operation is complete
+ ******************************************************************************/
+void si7021_i2c_write(uint32_t sensor, SI7021_I2C_COMMAND_Typedef cmd, uint32_t si7021_cb)
+{
+  SI7021_SENSOR_STRUCT *si7021 = si7021_get(sensor);
+
+  // a transaction is still in progress, or the sensor was not found; drop the request
+  if(!si7021_claim(si7021))
+  {
+      return;
+  }
+
+  // a reset returns user register 1 to its power-up value
+  if(cmd == reset)
+  {
+      si7021->reg1 = SI7021_REG1_RESET;
+      si7021->reg1_want = SI7021_REG1_RESET;
+  }
+
+  // describe the transaction: command byte only
+  si7021->tx_buf[0] = cmd;
+  si7021->txn.slave_addr = si7021->addr;
+  si7021->txn.tx_buf = si7021->tx_buf;
+  si7021->txn.tx_len = SI7021_CMD_BYTES;
+  si7021->txn.rx_buf = NULL;
+  si7021->txn.rx_len = 0;
+  si7021->txn.repeated_start = false;
+  si7021->txn.i2c_cb = si7021_cb;
+  si7021->txn.nack_retries = SI7021_NACK_RETRIES;
+  si7021->txn.done_cb = si7021_release;
+
+  // queue the I2C protocol (W)
+  if(!si7021_queue(si7021))
+  {
+      si7021->busy = false;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Selects the Si7021 measurement resolution
+ *
+ * @details
+ *  Writes the resolution bits of user register 1 from a cached shadow, so
+ *  no read-modify-write over the bus is needed. The shadow, and with it
+ *  the conversion time used by measurements, is updated once the write
+ *  has been accepted. If the resolution is already selected nothing is
+ *  written and the callback event is scheduled straight away. Requested
+ *  while the sensor is busy, e.g. still being probed at boot, the write
+ *  follows once the sensor is idle.
+ *
+ * @param[in] sensor
+ *  Sensor handle from si7021_register()
+ *
+ * @param[in] res
+ *  Measurement resolution
+ *
+ * @param[in] si7021_cb
+ *  Callback event to be scheduled once the resolution is in effect
+ *  (0 for none)
+ *
+ * @return
+ *  true if the change was queued or deferred; false if the bus was busy
+ *  or the sensor was not found
+ ******************************************************************************/
+bool si7021_set_resolution(uint32_t sensor, SI7021_RESOLUTION_Typedef res, uint32_t si7021_cb)
+{
+  SI7021_SENSOR_STRUCT *si7021 = si7021_get(sensor);
+  uint8_t reg1 = (si7021->reg1 & ~SI7021_REG1_RES_MASK) | res;
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  // the probe did not identify the sensor
+  if((si7021->id.probe != si7021_probe_ok) && (si7021->id.probe != si7021_probe_pending))
+  {
+      CORE_EXIT_CRITICAL();
+      return false;
+  }
+
+  // restored by every power-up
+  si7021->reg1_want = reg1;
+
+  // a transaction is still in progress; written once it ends
+  if(si7021->busy)
+  {
+      si7021->reg1_cb = si7021_cb;
+      si7021->reg1_restore = true;
+      CORE_EXIT_CRITICAL();
+      return true;
+  }
+
+  // already selected: nothing to write
+  if(reg1 == si7021->reg1)
+  {
+      CORE_EXIT_CRITICAL();
+      if(si7021_cb)
+      {
+          add_scheduled_event(si7021_cb);
+      }
+      return true;
+  }
+
+  // claim the sensor before an interrupt can start another request on it
+  si7021->busy = true;
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+
+  return si7021_reg1_write(si7021, reg1, si7021_cb);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes user register 1
+ *
+ * @details
+ *  The shadow follows once the sensor has accepted the write.
+ *
+ * @param[in] si7021
+ *  Idle sensor
+ *
+ * @param[in] reg1
+ *  Register value
+ *
+ * @param[in] si7021_cb
+ *  Callback event to be scheduled after the write (0 for none)
+ *
+ * @return
+ *  true if the write was queued or held
+ ******************************************************************************/
+bool si7021_reg1_write(SI7021_SENSOR_STRUCT *si7021, uint8_t reg1, uint32_t si7021_cb)
+{
+  si7021->busy = true;
+  si7021->reg1_pending = reg1;
+
+  // describe the transaction: write_reg1 + register value
+  si7021->tx_buf[0] = write_reg1;
+  si7021->tx_buf[1] = reg1;
+  si7021->txn.slave_addr = si7021->addr;
+  si7021->txn.tx_buf = si7021->tx_buf;
+  si7021->txn.tx_len = SI7021_REG1_BYTES;
+  si7021->txn.rx_buf = NULL;
+  si7021->txn.rx_len = 0;
+  si7021->txn.repeated_start = false;
+  si7021->txn.i2c_cb = si7021_cb;
+  si7021->txn.nack_retries = SI7021_NACK_RETRIES;
+  si7021->txn.done_cb = si7021_reg1_written;
+
+  // queue the I2C protocol (WRITE REG1)
+  if(!si7021_queue(si7021))
+  {
+      si7021->busy = false;
+      return false;
+  }
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Completion hook of a user register 1 write
+ *
+ * @details
+ *  Runs in I2Cn interrupt context. The shadow only follows a write that
+ *  the sensor accepted.
+ *
+ * @param[in] txn
+ *  Completed transaction
+ ******************************************************************************/
+void si7021_reg1_written(I2C_TRANSACTION_STRUCT *txn)
+{
+  SI7021_SENSOR_STRUCT *si7021 = SI7021_TXN_SENSOR(txn);
+
+  if(txn->status == i2c_status_ok)
+  {
+      si7021->reg1 = si7021->reg1_pending;
+  }
+  si7021_idle(si7021);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Completion hook of the last transaction of a request
+ *
+ * @details
+ *  Runs in I2Cn interrupt context; the sensor accepts a new request.
+ *
+ * @param[in] txn
+ *  Completed transaction
+ ******************************************************************************/
+void si7021_release(I2C_TRANSACTION_STRUCT *txn)
+{
+  si7021_idle(SI7021_TXN_SENSOR(txn));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Completion hook of the RH read
+ *
+ * @details
+ *  Runs in I2Cn interrupt context. With SI7021_CRC_CHECK the checksum byte
+ *  is verified first; only a valid sample replaces the stored RH code, so
+ *  a corrupted one never reaches si7021_calc_RH(). For a combined
+ *  measurement the temperature captured during the RH conversion is read
+ *  next, with a write-then-read of the "read T from previous RH" command;
+ *  no second conversion is needed. Otherwise, or if the RH read failed,
+ *  the request ends here.
+ *
+ * @param[in] txn
+ *  Completed transaction
+ ******************************************************************************/
+void si7021_rh_done(I2C_TRANSACTION_STRUCT *txn)
+{
+  SI7021_SENSOR_STRUCT *si7021 = SI7021_TXN_SENSOR(txn);
+
+  // classify the sample
+  if(txn->status != i2c_status_ok)
+  {
+      si7021->result = si7021_status_bus_error;
+  }
+#ifdef SI7021_CRC_CHECK
+  else if(si7021_crc8(si7021->read_buf, SI7021_RH_BYTES) != si7021->read_buf[SI7021_RH_BYTES])
+  {
+      si7021->result = si7021_status_crc_error;
+  }
+#endif
+  else
+  {
+      // keep the valid sample
+      si7021->rh_buf[0] = si7021->read_buf[0];
+      si7021->rh_buf[1] = si7021->read_buf[1];
+      si7021->result = si7021_status_ok;
+  }
+
+  // RH only, or no RH to pair a temperature with: the request ends here
+  if(!si7021->with_t || (si7021->result != si7021_status_ok))
+  {
+      si7021_finish(si7021);
+      return;
+  }
+
+  // describe the transaction: read T from previous RH, 2 byte result (no checksum)
+  si7021->tx_buf[0] = read_T_from_prev_RH;
+  txn->tx_len = SI7021_CMD_BYTES;
+  txn->rx_buf = si7021->t_buf;
+  txn->rx_len = SI7021_T_BYTES;
+  txn->repeated_start = true;
+  txn->nack_retries = SI7021_FETCH_RETRIES;
+  txn->done_cb = si7021_t_done;
+
+  // queue the I2C protocol (READ T); it runs straight after this one
+  if(!i2c_init_sm(si7021->i2c, txn))
+  {
+      si7021->result = si7021_status_bus_error;
+      si7021_finish(si7021);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Completion hook of the temperature read of a combined measurement
+ *
+ * @details
+ *  Runs in I2Cn interrupt context; the request ends here.
+ *
+ * @param[in] txn
+ *  Completed transaction
+ ******************************************************************************/
+void si7021_t_done(I2C_TRANSACTION_STRUCT *txn)
+{
+  SI7021_SENSOR_STRUCT *si7021 = SI7021_TXN_SENSOR(txn);
+
+  if(txn->status != i2c_status_ok)
+  {
+      si7021->result = si7021_status_bus_error;
+  }
+  si7021_finish(si7021);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Describes a read of the identity probe
+ *
+ * @details
+ *  Write-then-read: a 2 byte command, a repeated start and the result.
+ *  Few retries: by the time the probe runs the sensor has powered up, so
+ *  a NACK means it is not there.
+ *
+ * @param[in] si7021
+ *  Sensor being probed
+ *
+ * @param[in] cmd0
+ *  First command byte
+ *
+ * @param[in] cmd1
+ *  Second command byte
+ *
+ * @param[in] rx_len
+ *  Bytes to read
+ *
+ * @param[in] done_cb
+ *  Completion hook of the read
+ ******************************************************************************/
+void si7021_probe_read(SI7021_SENSOR_STRUCT *si7021, uint8_t cmd0, uint8_t cmd1, uint32_t rx_len, void (*done_cb)(I2C_TRANSACTION_STRUCT *txn))
+{
+  si7021->tx_buf[0] = cmd0;
+  si7021->tx_buf[1] = cmd1;
+  si7021->txn.slave_addr = si7021->addr;
+  si7021->txn.tx_buf = si7021->tx_buf;
+  si7021->txn.tx_len = SI7021_ID_CMD_BYTES;
+  si7021->txn.rx_buf = si7021->id_buf;
+  si7021->txn.rx_len = rx_len;
+  si7021->txn.repeated_start = true;
+  si7021->txn.i2c_cb = 0;
+  si7021->txn.nack_retries = SI7021_PROBE_RETRIES;
+  si7021->txn.done_cb = done_cb;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Ends the identity probe
+ *
+ * @details
+ *  Runs in interrupt context, except when the probe could not be queued.
+ *  The result is cached for good; a sensor that was not identified
+ *  reports si7021_status_absent and is never addressed again.
+ *
+ * @param[in] si7021
+ *  Probed sensor
+ *
+ * @param[in] probe
+ *  Probe result
+ ******************************************************************************/
+void si7021_probe_end(SI7021_SENSOR_STRUCT *si7021, SI7021_PROBE_Typedef probe)
+{
+  si7021->id.probe = probe;
+  if(probe != si7021_probe_ok)
+  {
+      si7021->result = si7021_status_absent;
+  }
+  si7021_idle(si7021);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Completion hook of the first electronic serial number read
+ *
+ * @details
+ *  Runs in I2Cn interrupt context. Keeps SNA_3..SNA_0, then reads the
+ *  second half of the serial number.
+ *
+ * @param[in] txn
+ *  Completed transaction
+ ******************************************************************************/
+void si7021_sna_done(I2C_TRANSACTION_STRUCT *txn)
+{
+  SI7021_SENSOR_STRUCT *si7021 = SI7021_TXN_SENSOR(txn);
+  uint8_t *buf = si7021->id_buf;
+
+  if(txn->status != i2c_status_ok)
+  {
+      si7021_probe_end(si7021, si7021_probe_absent);
+      return;
+  }
+#ifdef SI7021_CRC_CHECK
+  if(!si7021_id_check(buf, SI7021_SNA_READ_BYTES, SI7021_SNA_STRIDE))
+  {
+      si7021_probe_end(si7021, si7021_probe_invalid);
+      return;
+  }
+#endif
+
+  // SNA_3, SNA_2, SNA_1, SNA_0; every other byte is a checksum
+  si7021->id.serial_a = ((uint32_t)buf[0] << 24) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[4] << 8) | buf[6];
+
+  // queue the I2C protocol (READ ID 2nd BYTES)
+  si7021_probe_read(si7021, read_id_byte2_1, read_id_byte2_0, SI7021_SNB_READ_BYTES, si7021_snb_done);
+  if(!i2c_init_sm(si7021->i2c, txn))
+  {
+      si7021_probe_end(si7021, si7021_probe_absent);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Completion hook of the second electronic serial number read
+ *
+ * @details
+ *  Runs in I2Cn interrupt context. Keeps SNB_3..SNB_0; SNB_3 identifies
+ *  the device, and only the parts this driver speaks to go on to the
+ *  firmware revision read.
+ *
+ * @param[in] txn
+ *  Completed transaction
+ ******************************************************************************/
+void si7021_snb_done(I2C_TRANSACTION_STRUCT *txn)
+{
+  SI7021_SENSOR_STRUCT *si7021 = SI7021_TXN_SENSOR(txn);
+  uint8_t *buf = si7021->id_buf;
+
+  if(txn->status != i2c_status_ok)
+  {
+      si7021_probe_end(si7021, si7021_probe_absent);
+      return;
+  }
+#ifdef SI7021_CRC_CHECK
+  if(!si7021_id_check(buf, SI7021_SNB_READ_BYTES, SI7021_SNB_STRIDE))
+  {
+      si7021_probe_end(si7021, si7021_probe_invalid);
+      return;
+  }
+#endif
+
+  // SNB_3, SNB_2, SNB_1, SNB_0; every third byte is a checksum
+  si7021->id.serial_b = ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[3] << 8) | buf[4];
+  si7021->id.device = buf[0];
+  si7021->id.caps = si7021_caps(buf[0]);
+  if(!si7021->id.caps)
+  {
+      si7021_probe_end(si7021, si7021_probe_unsupported);
+      return;
+  }
+
+  // queue the I2C protocol (READ FIRMWARE REVISION)
+  si7021_probe_read(si7021, read_fw_rev0, read_fw_rev1, SI7021_FW_READ_BYTES, si7021_fw_done);
+  if(!i2c_init_sm(si7021->i2c, txn))
+  {
+      si7021_probe_end(si7021, si7021_probe_absent);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Completion hook of the firmware revision read
+ *
+ * @details
+ *  Runs in I2Cn interrupt context; the probe ends here. The revision
+ *  byte has no checksum.
+ *
+ * @param[in] txn
+ *  Completed transaction
+ ******************************************************************************/
+void si7021_fw_done(I2C_TRANSACTION_STRUCT *txn)
+{
+  SI7021_SENSOR_STRUCT *si7021 = SI7021_TXN_SENSOR(txn);
+
+  if(txn->status != i2c_status_ok)
+  {
+      si7021_probe_end(si7021, si7021_probe_absent);
+      return;
+  }
+  si7021->id.fw_rev = si7021->id_buf[0];
+  si7021_probe_end(si7021, si7021_probe_ok);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Capabilities of a device
+ *
+ * @param[in] device
+ *  Device identification (SNB_3)
+ *
+ * @return
+ *  SI7021_CAP_ flags; 0 for a device this driver does not support
+ ******************************************************************************/
+uint32_t si7021_caps(uint8_t device)
+{
+  switch(device)
+  {
+    case SI7021_DEV_SI7013:
+      return SI7021_CAP_RH | SI7021_CAP_T | SI7021_CAP_HEATER | SI7021_CAP_THERMISTOR;
+    case SI7021_DEV_SI7020:
+    case SI7021_DEV_SI7021:
+    case SI7021_DEV_ENG_0:
+    case SI7021_DEV_ENG_1:
+      return SI7021_CAP_RH | SI7021_CAP_T | SI7021_CAP_HEATER;
+    default:
+      return 0;
+  }
+}
+
+
+#ifndef SI7021_HOLD_MASTER
+/***************************************************************************//**
+ * @brief
+ *  Completion hook of the start conversion transaction
+ *
+ * @details
+ *  Runs in I2Cn interrupt context. Puts the sensor on the conversion
+ *  timer. If the command was not accepted the measurement ends here and
+ *  the callback event is scheduled so the application is not left waiting.
+ *
+ * @param[in] txn
+ *  Completed transaction
+ ******************************************************************************/
+void si7021_conv_started(I2C_TRANSACTION_STRUCT *txn)
+{
+  SI7021_SENSOR_STRUCT *si7021 = SI7021_TXN_SENSOR(txn);
+
+  // the conversion never started
+  if(txn->status != i2c_status_ok)
+  {
+      si7021->result = si7021_status_bus_error;
+      si7021_finish(si7021);
+      return;
+  }
+
+  // fetch the result once the conversion has completed
+  si7021_conv_service(si7021);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Conversion timer expiry callback
+ *
+ * @details
+ *  Runs in TIMER1 interrupt context.
+ *
+ * @param[in] ch
+ *  One-shot channel that expired
+ ******************************************************************************/
+void si7021_conv_done(uint32_t ch)
+{
+  // will trigger if another channel's expiry was routed here
+  EFM_ASSERT(ch == SI7021_TIMER_CH);
+
+  si7021_conv_service(NULL);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Services the conversion timer shared by every sensor
+ *
+ * @details
+ *  One one-shot channel times every sensor's conversion, armed for the
+ *  earliest deadline. Each call charges the time elapsed since the
+ *  channel was armed to every converting sensor, fetches those that are
+ *  done, adds a newly started sensor with the full conversion time of its
+ *  resolution, and re-arms the channel for the nearest remaining
+ *  deadline. Atomic function: called from I2Cn and TIMER1 interrupts.
+ *
+ * @param[in] started
+ *  Sensor whose conversion has just started (NULL for none)
+ ******************************************************************************/
+void si7021_conv_service(SI7021_SENSOR_STRUCT *started)
+{
+  uint32_t next_us = 0;
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  // time spent since the channel was last armed
+  uint32_t elapsed_us = si7021_timer_us - hw_timer_remaining(SI7021_TIMER_CH);
+
+  // fetch every sensor whose conversion is done
+  for(uint32_t n = 0; n < si7021_sensor_count; n++)
+  {
+      SI7021_SENSOR_STRUCT *si7021 = &si7021_sensor[n];
+      if(!si7021->converting)
+      {
+          continue;
+      }
+      if(si7021->conv_left_us <= elapsed_us)
+      {
+          si7021->converting = false;
+          si7021_fetch(si7021);
+      }
+      else
+      {
+          si7021->conv_left_us -= elapsed_us;
+      }
+  }
+
+  // the new conversion runs for the full time of its resolution
+  if(started)
+  {
+      started->conv_left_us = si7021_conv_us[SI7021_RES_INDEX(started->reg1)];
+      started->converting = true;
+  }
+
+  // nearest remaining deadline
+  for(uint32_t n = 0; n < si7021_sensor_count; n++)
+  {
+      SI7021_SENSOR_STRUCT *si7021 = &si7021_sensor[n];
+      if(si7021->converting && (!next_us || (si7021->conv_left_us < next_us)))
+      {
+          next_us = si7021->conv_left_us;
+      }
+  }
+
+  // re-arm, or leave the channel idle once no sensor is converting
+  si7021_timer_us = next_us;
+  if(next_us)
+  {
+      hw_timer_start(SI7021_TIMER_CH, next_us, si7021_conv_done);
+  }
+  else
+  {
+      hw_timer_cancel(SI7021_TIMER_CH);
+  }
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Fetches a completed conversion
+ *
+ * @details
+ *  Queues a read-only transaction for the two byte RH result.
+ *
+ * @param[in] si7021
+ *  Sensor whose conversion is done
+ ******************************************************************************/
+void si7021_fetch(SI7021_SENSOR_STRUCT *si7021)
+{
+  // describe the transaction: read the 2 byte result
+  si7021->txn.tx_len = 0;
+  si7021->txn.rx_buf = si7021->read_buf;
+  si7021->txn.rx_len = SI7021_RH_READ_BYTES;
+  si7021->txn.nack_retries = SI7021_FETCH_RETRIES;
+  si7021->txn.done_cb = si7021_rh_done;
+
+  // queue the I2C protocol (READ RH)
+  if(!i2c_init_sm(si7021->i2c, &si7021->txn))
+  {
+      si7021->result = si7021_status_bus_error;
+      si7021_finish(si7021);
+  }
+}
+#endif
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reports the result of the latest measurement
+ *
+ * @details
+ *  Check from the measurement's callback event. On an error the values
+ *  returned by si7021_calc_RH() and si7021_calc_T() are those of an
+ *  earlier, valid measurement.
+ *
+ * @param[in] sensor
+ *  Sensor handle from si7021_register()
+ *
+ * @return
+ *  Result of the latest measurement
+ ******************************************************************************/
+SI7021_STATUS_Typedef si7021_status(uint32_t sensor)
+{
+  return si7021_get(sensor)->result;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads the cached identity of a sensor
+ *
+ * @details
+ *  Read from the probe at open; never queries the sensor. Check the probe
+ *  field first: the rest is valid only once it is si7021_probe_ok.
+ *
+ * @param[in] sensor
+ *  Sensor handle from si7021_register()
+ *
+ * @return
+ *  Cached identity and capabilities
+ ******************************************************************************/
+const SI7021_ID_STRUCT *si7021_identity(uint32_t sensor)
+{
+  return &si7021_get(sensor)->id;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Converts a Relative Humidity measurement code to a percent humidity
+ *  per Si7021-A20 TRM: Section 5.1.1
+ *
+ * @details
+ *  Floating point reference, rounded to single precision.
+ *  si7021_calc_RH_centi() returns the floor of 100x the exact datasheet
+ *  value without the FPU, so the two can differ in the last hundredth.
+ *
+ * @param[in] sensor
+ *  Sensor handle from si7021_register()
+ ******************************************************************************/
+float si7021_calc_RH(uint32_t sensor)
+{
+  // convert the stored RH code to percent humidity (Si7021-A20: 5.1.1)
+  return ((125 * (float)si7021_code(si7021_get(sensor)->rh_buf)) / 65536) - 6;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Converts a Temperature measurement code to degrees Celsius
+ *  per Si7021-A20 TRM: Section 5.1.2
+ *
+ * @details
+ *  Converts the temperature read by the last combined measurement.
+ *  Floating point reference, rounded to single precision.
+ *  si7021_calc_T_centi() returns the floor of 100x the exact datasheet
+ *  value without the FPU, so the two can differ in the last hundredth.
+ *
+ * @param[in] sensor
+ *  Sensor handle from si7021_register()
+ ******************************************************************************/
+float si7021_calc_T(uint32_t sensor)
+{
+  // convert the stored temperature code to degrees Celsius (Si7021-A20: 5.1.2)
+  return ((175.72f * (float)si7021_code(si7021_get(sensor)->t_buf)) / 65536) - 46.85f;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Converts a Relative Humidity measurement code to hundredths of a
+ *  percent humidity per Si7021-A20 TRM: Section 5.1.1
+ *
+ * @details
+ *  Integer only: one multiply, one shift, one subtract. The formula scaled
+ *  by 100 has integer coefficients, so the result is the exact floor of
+ *  100 times the datasheet value for every code.
+ *
+ * @param[in] sensor
+ *  Sensor handle from si7021_register()
+ *
+ * @return
+ *  Relative humidity in 0.01 %RH
+ ******************************************************************************/
+int32_t si7021_calc_RH_centi(uint32_t sensor)
+{
+  // 12500 * 65535 fits in 32 bits unsigned
+  return (int32_t)((SI7021_RH_CENTI_SCALE * si7021_code(si7021_get(sensor)->rh_buf)) >> SI7021_CODE_SHIFT) - SI7021_RH_CENTI_OFFSET;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Converts a Temperature measurement code to hundredths of a degree
+ *  Celsius per Si7021-A20 TRM: Section 5.1.2
+ *
+ * @details
+ *  Integer only: one multiply, one shift, one subtract. The formula scaled
+ *  by 100 has integer coefficients, so the result is the exact floor of
+ *  100 times the datasheet value for every code.
+ *
+ * @param[in] sensor
+ *  Sensor handle from si7021_register()
+ *
+ * @return
+ *  Temperature in 0.01 degC
+ ******************************************************************************/
+int32_t si7021_calc_T_centi(uint32_t sensor)
+{
+  // 17572 * 65535 fits in 32 bits unsigned
+  return (int32_t)((SI7021_T_CENTI_SCALE * si7021_code(si7021_get(sensor)->t_buf)) >> SI7021_CODE_SHIFT) - SI7021_T_CENTI_OFFSET;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads a stored measurement code
+ *
+ * @details
+ *  Atomic function due to accessing static variable; the critical section
+ *  covers the two byte loads only, not the conversion.
+ *
+ * @param[in] buf
+ *  Stored code, MS byte first
+ *
+ * @return
+ *  16-bit measurement code
+ ******************************************************************************/
+uint32_t si7021_code(const uint8_t *buf)
+{
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  // assemble the stored code, MS byte first (Si7021-A20: 5.1)
+  uint32_t code = (buf[0] << MSBYTE_SHIFT) | buf[1];
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+
+  return code;
+}
+
+
+#ifdef SI7021_CRC_CHECK
+/***************************************************************************//**
+ * @brief
+ *  Computes the Si7021 CRC-8 of a byte string
+ *
+ * @details
+ *  Table driven, one lookup per byte (Si7021-A20 DS 5.1: polynomial 0x31,
+ *  initialized to 0x00, MSB first)
+ *
+ * @param[in] data
+ *  Bytes to check, in the order they were received
+ *
+ * @param[in] len
+ *  Number of bytes
+ *
+ * @return
+ *  CRC-8 of the bytes
+ ******************************************************************************/
+uint8_t si7021_crc8(const uint8_t *data, uint32_t len)
+{
+  uint8_t crc = 0;
+
+  // fold in one byte per lookup
+  while(len--)
+  {
+      crc = si7021_crc_table[crc ^ *data++];
+  }
+  return crc;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Verifies the checksums of an electronic serial number read
+ *
+ * @details
+ *  Each checksum covers every serial number byte read so far, not the
+ *  checksums in between (Si7021-A20 DS 5.5).
+ *
+ * @param[in] buf
+ *  Bytes as read
+ *
+ * @param[in] len
+ *  Number of bytes
+ *
+ * @param[in] stride
+ *  Serial number bytes per checksum, plus one
+ *
+ * @return
+ *  true if every checksum matches
+ ******************************************************************************/
+bool si7021_id_check(const uint8_t *buf, uint32_t len, uint32_t stride)
+{
+  uint8_t crc = 0;
+
+  for(uint32_t n = 0; n < len; n++)
+  {
+      // every stride-th byte checks the serial number bytes before it
+      if(((n + 1) % stride) == 0)
+      {
+          if(buf[n] != crc)
+          {
+              return false;
+          }
+      }
+      else
+      {
+          crc = si7021_crc_table[crc ^ buf[n]];
+      }
+  }
+  return true;
 }
+#endif
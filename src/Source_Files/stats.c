@@ -0,0 +1,183 @@
+/***************************************************************************//**
+ * @file
+ *   stats.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/20/2022
+ * @brief
+ *   Streaming statistics over a fixed-size window of recent samples
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "stats.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *  Initializes a statistics stream
+ *
+ * @details
+ *  Clears the window and sets the EWMA weight. No memory is allocated;
+ *  the STATS_STRUCT holds the whole window.
+ *
+ * @param[in] stats
+ *  Statistics stream to initialize
+ *
+ * @param[in] ewma_shift
+ *  EWMA weight of a new sample is 1/2^ewma_shift (0 tracks the latest
+ *  sample)
+ ******************************************************************************/
+void stats_init(STATS_STRUCT *stats, uint32_t ewma_shift)
+{
+  EFM_ASSERT(ewma_shift <= STATS_EWMA_SHIFT_MAX);
+
+  stats->seq = 0;
+  stats->count = 0;
+  stats->sum = 0;
+  stats->sum_sq = 0;
+  stats->min_head = 0;
+  stats->min_tail = 0;
+  stats->max_head = 0;
+  stats->max_tail = 0;
+  stats->ewma_shift = ewma_shift;
+  stats->ewma = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Adds a sample to a statistics stream
+ *
+ * @details
+ *  Constant work per sample, whatever the window length:
+ *  - the sample replaces the oldest one in the ring, and the window sum
+ *    and sum of squares are updated by the difference;
+ *  - the window minimum and maximum are kept in monotonic queues of
+ *    sequence numbers. A new sample drops the queued candidates it
+ *    dominates from the back, and the front leaves once it falls out of
+ *    the window. Every sample is queued and dropped at most once, so the
+ *    cost is amortized O(1);
+ *  - the EWMA moves 1/2^ewma_shift of the way toward the sample.
+ *
+ * @param[in] stats
+ *  Statistics stream
+ *
+ * @param[in] sample
+ *  New sample; |sample| < 2^16 keeps the variance within 32 bits
+ ******************************************************************************/
+void stats_add(STATS_STRUCT *stats, int32_t sample)
+{
+  uint32_t seq = stats->seq++;
+  uint32_t slot = seq & STATS_WINDOW_MASK;
+
+  // window full: the oldest sample leaves the sums
+  if(stats->count == STATS_WINDOW)
+  {
+      int32_t oldest = stats->ring[slot];
+      stats->sum -= oldest;
+      stats->sum_sq -= (int64_t)oldest * oldest;
+  }
+  else
+  {
+      stats->count++;
+  }
+
+  // candidates that have left the window leave the queues before their slot is reused
+  if((stats->min_head != stats->min_tail) && (seq - stats->min_q[stats->min_head & STATS_WINDOW_MASK] >= STATS_WINDOW))
+  {
+      stats->min_head++;
+  }
+  if((stats->max_head != stats->max_tail) && (seq - stats->max_q[stats->max_head & STATS_WINDOW_MASK] >= STATS_WINDOW))
+  {
+      stats->max_head++;
+  }
+
+  // store the sample
+  stats->ring[slot] = sample;
+  stats->sum += sample;
+  stats->sum_sq += (int64_t)sample * sample;
+
+  // a new sample is a better minimum than every larger one queued before it
+  while((stats->min_head != stats->min_tail) &&
+        (stats->ring[stats->min_q[(stats->min_tail - 1) & STATS_WINDOW_MASK] & STATS_WINDOW_MASK] >= sample))
+  {
+      stats->min_tail--;
+  }
+  stats->min_q[stats->min_tail++ & STATS_WINDOW_MASK] = seq;
+
+  // ... and a better maximum than every smaller one
+  while((stats->max_head != stats->max_tail) &&
+        (stats->ring[stats->max_q[(stats->max_tail - 1) & STATS_WINDOW_MASK] & STATS_WINDOW_MASK] <= sample))
+  {
+      stats->max_tail--;
+  }
+  stats->max_q[stats->max_tail++ & STATS_WINDOW_MASK] = seq;
+
+  // the first sample seeds the EWMA
+  if(seq == 0)
+  {
+      stats->ewma = sample * (1 << STATS_EWMA_FRAC);
+  }
+  else
+  {
+      stats->ewma += ((sample * (1 << STATS_EWMA_FRAC)) - stats->ewma) >> stats->ewma_shift;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads the aggregate values of a statistics stream
+ *
+ * @details
+ *  Nothing is re-scanned: every value comes from the running sums, the
+ *  queue fronts and the EWMA accumulator. The sums are exact integers, so
+ *  the variance does not drift however long the stream runs.
+ *
+ * @param[in] stats
+ *  Statistics stream
+ *
+ * @param[out] summary
+ *  Aggregate values
+ *
+ * @return
+ *  false if no sample has been added yet (summary is not written)
+ ******************************************************************************/
+bool stats_summary(const STATS_STRUCT *stats, STATS_SUMMARY_STRUCT *summary)
+{
+  int64_t n = stats->count;
+
+  if(!n)
+  {
+      return false;
+  }
+
+  summary->count = stats->count;
+  summary->min = stats->ring[stats->min_q[stats->min_head & STATS_WINDOW_MASK] & STATS_WINDOW_MASK];
+  summary->max = stats->ring[stats->max_q[stats->max_head & STATS_WINDOW_MASK] & STATS_WINDOW_MASK];
+  summary->mean = (int32_t)(stats->sum / n);
+
+  // population variance: (n * sum(x^2) - sum(x)^2) / n^2
+  summary->variance = (int32_t)(((n * stats->sum_sq) - (stats->sum * stats->sum)) / (n * n));
+
+  // drop the EWMA fraction bits, rounding to nearest
+  summary->ewma = (stats->ewma + (1 << (STATS_EWMA_FRAC - 1))) >> STATS_EWMA_FRAC;
+
+  return true;
+}
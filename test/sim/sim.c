@@ -0,0 +1,2456 @@
+/***************************************************************************//**
+ * @file
+ *   sim.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host simulator of the EFM32PG12 peripherals the drivers use
+ *
+ * @details
+ *   Time is counted in core cycles and only moves when the firmware reads
+ *   the DWT cycle counter, when an interrupt is taken, or when the test runs
+ *   the simulator to its next event. Register writes are picked up whenever
+ *   the firmware touches the simulator (DWT, GPIO, LDMA, NVIC, CMU calls and
+ *   the end of every critical section), so of two writes to a command or
+ *   flag clear register with no such call between them only the last is
+ *   seen. Interrupts are taken when a critical section ends at nesting zero,
+ *   from the EM1 sleep and from sim_step(); never nested.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+#include "em_assert.h"
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_core.h"
+#include "em_emu.h"
+#include "em_i2c.h"
+#include "em_ldma.h"
+#include "em_letimer.h"
+#include "em_timer.h"
+#include "letimer.h"
+#include "sleep_routines.h"
+
+// letimer.h numbers the compare and repeat registers with the names of
+// their register fields
+#undef COMP0
+#undef COMP1
+#undef REP0
+#undef REP1
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define SIM_REG(reg)          (*(volatile uint32_t *)&(reg))   // write access to a read-only register
+#define SIM_TX_EMPTY          0x100UL               // TXDATA holds no byte
+#define SIM_GPIO_PORTS        6                     // ports A..F
+#define SIM_GPIO_PINS         16                    // pins per port
+#define SIM_TIMER_COUNT       2                     // TIMER0, TIMER1
+#define SIM_TIMER_CC_COUNT    4                     // CC channels per timer
+#define SIM_TIMER_PRESC_SHIFT 24                    // TIMER CTRL.PRESC
+#define SIM_TIMER_RUNNING     1UL                   // TIMER STATUS.RUNNING
+#define SIM_I2C_CR_MAX        8                     // extra HFPER cycles per SCL period (TRM 16.3.7.5)
+#define SIM_ADDR_BITS         10                    // (repeated) START + address + ACK
+#define SIM_BYTE_BITS         9                     // byte + ACK
+#define SIM_STOP_BITS         1                     // STOP
+#define SIM_RESET_BITS        2                     // START + STOP of a bus reset
+#define SIM_I2C_STATE_WAIT    (1UL << 5)            // STATE.STATE: bus held by this master
+#define SIM_LETIMER_CYCLES    (SIM_CORE_HZ / LETIMER_HZ) // core cycles per LFCLK cycle; ticks aligned to time zero
+#define SIM_LETIMER_COMPS     2                     // compare registers
+#define SIM_LETIMER_COMP0     0                     // LETIMER_CompareSet() and LETIMER_RepeatSet() register numbers
+#define SIM_LETIMER_REP0      0
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+// what a simulated I2C master is doing on its bus
+typedef enum
+{
+  op_idle,         /* bus released */
+  op_start,        /* START commanded; waiting for the address in TXDATA */
+  op_addr,         /* address byte on the bus */
+  op_wait,         /* bus held after an address or data byte; waiting for TXDATA or a command */
+  op_tx,           /* data byte on the bus */
+  op_rx,           /* data byte being received */
+  op_rx_held,      /* byte received while RXDATA is still full */
+  op_wait_ack,     /* byte in RXDATA; waiting for ACK or NACK */
+  op_stop,         /* STOP on the bus */
+  op_reset,        /* START + STOP bus reset on the bus */
+}SIM_BUS_STATE_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+// one I2C master and the bus it drives
+typedef struct
+{
+    I2C_TypeDef                  *i2c;                    // master registers
+    SIM_BUS_STATE_Typedef         state;                  // bus operation in progress
+    uint64_t                      due;                    // time the operation completes (SIM_NEVER while waiting)
+    uint32_t                      bits;                   // bit times of the operation
+    uint64_t                      stall_since;            // SCL stretched since (SIM_NEVER when not)
+    uint8_t                       shift;                  // byte in the shift register
+    uint8_t                       held;                   // byte received while RXDATA was full
+    bool                          acked;                  // the last byte written was ACKed
+    bool                          read;                   // addressed for a read
+    bool                          rx_full;                // RXDATA holds a byte
+    bool                          start_pending;          // START commanded mid-byte
+    bool                          stop_pending;           // STOP commanded mid-byte
+    SIM_SLAVE_STRUCT             *slaves;                 // attached slaves
+    SIM_SLAVE_STRUCT             *slave;                  // slave addressed
+    GPIO_Port_TypeDef             sda_port;               // SDA pin
+    uint32_t                      sda_pin;
+    GPIO_Port_TypeDef             scl_port;               // SCL pin
+    uint32_t                      scl_pin;
+    bool                          pwr_gated;              // pull-ups powered from a GPIO
+    GPIO_Port_TypeDef             pwr_port;               // pull-up supply pin
+    uint32_t                      pwr_pin;
+    uint64_t                      pwr_since;              // time the pull-ups were powered
+    uint32_t                      power_ups;              // pull-up supply rising edges
+}SIM_BUS_STRUCT;
+
+
+// one LDMA channel
+typedef struct
+{
+    const LDMA_Descriptor_t      *desc;                   // descriptor being executed
+    LDMA_PeripheralSignal_t       signal;                 // request signal
+    uint32_t                      moved;                  // units moved by the descriptor
+    bool                          active;                 // channel enabled
+    uint64_t                      done_at;                // time the done flag was raised
+}SIM_LDMA_CH_STRUCT;
+
+
+// one LETIMER compare register, as the counter sees it
+typedef struct
+{
+    uint32_t                      value;                  // compare value the counter matches against
+    uint32_t                      pending;                // value written, still synchronizing
+    uint64_t                      pending_at;             // first counter step that sees it (SIM_NEVER: none)
+    uint32_t                      writes;                 // LETIMER_CompareSet() calls
+}SIM_LETIMER_COMP_STRUCT;
+
+
+// one GPIO pin
+typedef struct
+{
+    GPIO_Mode_TypeDef             mode;                   // pin mode
+    uint32_t                      dout;                   // output register bit
+}SIM_PIN_STRUCT;
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+// register blocks
+I2C_TypeDef sim_i2c_regs[I2C_COUNT];
+LDMA_TypeDef sim_ldma_regs;
+TIMER_TypeDef sim_timer_regs[SIM_TIMER_COUNT];
+LETIMER_TypeDef sim_letimer_regs;
+GPIO_TypeDef sim_gpio_regs;
+CoreDebug_Type sim_coredebug;
+static DWT_Type sim_dwt_regs;
+
+// time base and core
+static uint64_t sim_time;                                 // core cycles since sim_init()
+static bool sim_active;                                   // peripherals simulated; off: time base only
+static _Thread_local uint32_t sim_nest;                   // critical section nesting
+static bool sim_in_isr;                                   // a handler is running
+static bool sim_updating;                                 // sim_update() is running
+static uint64_t sim_nvic_enabled;                         // NVIC enable bits
+static uint64_t sim_nvic_pending;                         // NVIC software pending bits
+static SIM_IRQ_STATS_STRUCT sim_irq[SIM_IRQ_COUNT];       // per-line handler host time
+static uint64_t sim_isr_sim_ns;                           // host time spent simulating inside the running handler
+static uint64_t sim_em_time[MAX_ENERGY_MODES];            // cycles slept per energy mode
+static uint32_t sim_em_count[MAX_ENERGY_MODES];           // sleeps per energy mode
+
+// peripherals
+static SIM_BUS_STRUCT sim_bus[I2C_COUNT];
+static SIM_LDMA_CH_STRUCT sim_ldma_ch[DMA_CHAN_COUNT];
+static uint64_t sim_ldma_delay;                           // LDMA done flag to interrupt latency
+static bool sim_timer_running[SIM_TIMER_COUNT];
+static uint64_t sim_timer_last[SIM_TIMER_COUNT];          // time the counter was last brought up to date
+static SIM_PIN_STRUCT sim_pin[SIM_GPIO_PORTS][SIM_GPIO_PINS];
+static bool sim_letimer_running;
+static uint64_t sim_letimer_tick;                         // ticks the counter has been brought up to
+static SIM_LETIMER_COMP_STRUCT sim_letimer_comp[SIM_LETIMER_COMPS];
+static uint64_t sim_letimer_sync;                         // ticks a compare write takes to reach the counter
+static uint64_t sim_letimer_hold_cycles;                  // core held up in the next compare write
+
+// interrupt handlers of the firmware linked in; NULL when absent
+extern void LDMA_IRQHandler(void) __attribute__((weak));
+extern void GPIO_EVEN_IRQHandler(void) __attribute__((weak));
+extern void TIMER0_IRQHandler(void) __attribute__((weak));
+extern void TIMER1_IRQHandler(void) __attribute__((weak));
+extern void I2C0_IRQHandler(void) __attribute__((weak));
+extern void GPIO_ODD_IRQHandler(void) __attribute__((weak));
+extern void LETIMER0_IRQHandler(void) __attribute__((weak));
+extern void I2C1_IRQHandler(void) __attribute__((weak));
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static uint64_t sim_host_ns(void);
+static void sim_update(void);
+static bool sim_dispatch(void);
+static int sim_irq_next(bool enabled_only);
+static uint64_t sim_next_event(void);
+static void sim_sleep(uint32_t em);
+static bool sim_hf_busy(void);
+static uint32_t sim_clto_cycles(SIM_BUS_STRUCT *bus);
+static bool sim_line(SIM_BUS_STRUCT *bus, bool scl);
+static void sim_bus_begin(SIM_BUS_STRUCT *bus, SIM_BUS_STATE_Typedef state, uint32_t bits);
+static bool sim_bus_apply(SIM_BUS_STRUCT *bus);
+static void sim_bus_cmd(SIM_BUS_STRUCT *bus, uint32_t cmd);
+static void sim_bus_complete(SIM_BUS_STRUCT *bus);
+static void sim_bus_deliver(SIM_BUS_STRUCT *bus, uint8_t byte);
+static void sim_bus_waiting(SIM_BUS_STRUCT *bus);
+static void sim_bus_released(SIM_BUS_STRUCT *bus);
+static bool sim_ldma_service(void);
+static void sim_ldma_desc_done(uint32_t ch);
+static void sim_timer_apply(void);
+static void sim_timer_count(void);
+static uint32_t sim_timer_prescale(TIMER_TypeDef *timer);
+static void sim_letimer_apply(void);
+static void sim_letimer_count(void);
+static void sim_letimer_step(uint64_t ticks);
+static uint64_t sim_letimer_next(void);
+static uint64_t sim_letimer_match(uint32_t value, uint64_t from);
+static void sim_pin_write(GPIO_Port_TypeDef port, uint32_t pin, uint32_t dout, GPIO_Mode_TypeDef mode);
+
+
+//***********************************************************************************
+// time base and interrupt dispatch
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   Resets every simulated peripheral and starts the time base
+ *
+ * @details
+ *   The firmware keeps its own state between calls, so a test process
+ *   calls this once, before opening any driver.
+ ******************************************************************************/
+void sim_init(void)
+{
+  memset(sim_i2c_regs, 0, sizeof(sim_i2c_regs));
+  memset(&sim_ldma_regs, 0, sizeof(sim_ldma_regs));
+  memset(sim_timer_regs, 0, sizeof(sim_timer_regs));
+  memset(&sim_letimer_regs, 0, sizeof(sim_letimer_regs));
+  memset(sim_letimer_comp, 0, sizeof(sim_letimer_comp));
+  memset(sim_bus, 0, sizeof(sim_bus));
+  memset(sim_ldma_ch, 0, sizeof(sim_ldma_ch));
+  memset(sim_pin, 0, sizeof(sim_pin));
+  memset(sim_irq, 0, sizeof(sim_irq));
+
+  sim_time = 0;
+  sim_nest = 0;
+  sim_in_isr = false;
+  sim_nvic_enabled = 0;
+  sim_nvic_pending = 0;
+  sim_ldma_delay = 0;
+
+  for(uint32_t n = 0; n < I2C_COUNT; n++)
+  {
+      SIM_BUS_STRUCT *bus = &sim_bus[n];
+      bus->i2c = &sim_i2c_regs[n];
+      bus->i2c->TXDATA = SIM_TX_EMPTY;
+      SIM_REG(bus->i2c->STATUS) = I2C_STATUS_TXBL;
+      bus->due = SIM_NEVER;
+      bus->stall_since = SIM_NEVER;
+  }
+
+  // I2C0 on the Si7021 pins; I2C1 on a second pair
+  sim_bus_pins(0, gpioPortC, 10, gpioPortC, 11);
+  sim_bus_pins(1, gpioPortD, 12, gpioPortD, 13);
+
+  for(uint32_t n = 0; n < SIM_TIMER_COUNT; n++)
+  {
+      sim_timer_regs[n].TOP = 0xFFFF;
+      sim_timer_running[n] = false;
+  }
+
+  sim_letimer_running = false;
+  sim_letimer_tick = 0;
+  sim_letimer_sync = SIM_LETIMER_SYNC_TICKS;
+  sim_letimer_hold_cycles = 0;
+  for(uint32_t n = 0; n < SIM_LETIMER_COMPS; n++)
+  {
+      sim_letimer_comp[n].pending_at = SIM_NEVER;
+  }
+
+  sim_active = true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Current simulated time in core cycles
+ ******************************************************************************/
+uint64_t sim_now(void)
+{
+  return __atomic_load_n(&sim_time, __ATOMIC_RELAXED);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   DWT register block; every access is one core cycle
+ *
+ * @details
+ *   Safe from any thread or signal handler: without sim_init() only the
+ *   counter moves.
+ ******************************************************************************/
+DWT_Type *sim_dwt(void)
+{
+  uint64_t now = __atomic_add_fetch(&sim_time, 1, __ATOMIC_RELAXED);
+  sim_dwt_regs.CYCCNT = (uint32_t)now;
+  if(sim_active)
+  {
+      sim_update();
+  }
+  return &sim_dwt_regs;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Runs one interrupt, or moves time to the next event
+ *
+ * @param[in] deadline
+ *   Time not to run past (SIM_NEVER for none)
+ *
+ * @return
+ *   false once nothing happens before the deadline
+ ******************************************************************************/
+bool sim_step(uint64_t deadline)
+{
+  sim_update();
+  if(sim_dispatch())
+  {
+      return true;
+  }
+
+  uint64_t next = sim_next_event();
+  if(next > deadline)
+  {
+      if((deadline != SIM_NEVER) && (deadline > sim_time))
+      {
+          sim_time = deadline;
+          sim_update();
+      }
+      return false;
+  }
+  sim_time = next;
+  sim_update();
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Runs the simulator for a number of cycles
+ ******************************************************************************/
+void sim_run(uint64_t cycles)
+{
+  uint64_t deadline = sim_time + cycles;
+
+  while(sim_step(deadline));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Runs the simulator while a condition holds
+ *
+ * @param[in] busy
+ *   Condition, checked before every step
+ *
+ * @param[in] arg
+ *   Passed to busy
+ *
+ * @param[in] cycles
+ *   Longest run
+ *
+ * @return
+ *   true if the condition cleared within the run
+ ******************************************************************************/
+bool sim_run_while(bool (*busy)(void *arg), void *arg, uint64_t cycles)
+{
+  uint64_t deadline = sim_time + cycles;
+
+  while(busy(arg))
+  {
+      if(!sim_step(deadline))
+      {
+          return !busy(arg);
+      }
+  }
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads, and optionally clears, the handler timing of an interrupt line
+ *
+ * @details
+ *   Host time spent in the handler itself; time the simulator spends
+ *   catching up with register writes made by the handler is left out.
+ ******************************************************************************/
+void sim_irq_stats(IRQn_Type irqn, SIM_IRQ_STATS_STRUCT *stats, bool reset)
+{
+  *stats = sim_irq[irqn];
+  if(reset)
+  {
+      memset(&sim_irq[irqn], 0, sizeof(sim_irq[irqn]));
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Cycles spent asleep in an energy mode
+ ******************************************************************************/
+uint64_t sim_em_cycles(uint32_t em)
+{
+  return sim_em_time[em];
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Number of times an energy mode was entered
+ ******************************************************************************/
+uint32_t sim_em_entries(uint32_t em)
+{
+  return sim_em_count[em];
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reports a simulation failure and ends the test
+ ******************************************************************************/
+void sim_fail(const char *fmt, ...)
+{
+  va_list args;
+
+  fflush(stdout);
+  fprintf(stderr, "FAIL at %llu cycles: ", (unsigned long long)sim_time);
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fprintf(stderr, "\n");
+  exit(EXIT_FAILURE);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Stops, or restarts, the simulated peripherals
+ *
+ * @details
+ *   While paused only the time base moves: critical sections and DWT reads
+ *   no longer catch the peripherals up, so host benchmarks of firmware code
+ *   measure that code alone. Nothing may be waiting on a peripheral.
+ ******************************************************************************/
+void sim_pause(bool paused)
+{
+  sim_active = !paused;
+  if(!paused)
+  {
+      sim_update();
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   EFM_ASSERT failure: fatal in every test
+ ******************************************************************************/
+void sim_assert_fail(const char *file, int line)
+{
+  sim_fail("EFM_ASSERT %s:%d", file, line);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Host monotonic clock in nanoseconds
+ ******************************************************************************/
+uint64_t sim_host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Brings every peripheral up to the current time
+ *
+ * @details
+ *   Applies pending register writes and completes every bus operation that
+ *   is due, until nothing changes.
+ ******************************************************************************/
+void sim_update(void)
+{
+  uint64_t start = 0;
+  bool progress;
+
+  if(sim_updating || !sim_active)
+  {
+      return;
+  }
+  sim_updating = true;
+  if(sim_in_isr)
+  {
+      start = sim_host_ns();
+  }
+
+  do
+  {
+      progress = false;
+      sim_timer_apply();
+      sim_letimer_apply();
+      for(uint32_t n = 0; n < I2C_COUNT; n++)
+      {
+          progress |= sim_bus_apply(&sim_bus[n]);
+      }
+      progress |= sim_ldma_service();
+
+      // LDMA flag clears
+      if(sim_ldma_regs.IFC)
+      {
+          SIM_REG(sim_ldma_regs.IF) &= ~sim_ldma_regs.IFC;
+          sim_ldma_regs.IFC = 0;
+      }
+      if(sim_ldma_regs.IFS)
+      {
+          SIM_REG(sim_ldma_regs.IF) |= sim_ldma_regs.IFS;
+          sim_ldma_regs.IFS = 0;
+      }
+  } while(progress);
+  sim_timer_count();
+  sim_letimer_count();
+
+  if(sim_in_isr)
+  {
+      sim_isr_sim_ns += sim_host_ns() - start;
+  }
+  sim_updating = false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Raised state of an interrupt line
+ ******************************************************************************/
+static bool sim_irq_raised(uint32_t irqn)
+{
+  switch(irqn)
+  {
+    case LDMA_IRQn:
+      for(uint32_t ch = 0; ch < DMA_CHAN_COUNT; ch++)
+      {
+          if((sim_ldma_regs.IF & sim_ldma_regs.IEN & (1UL << ch)) &&
+             (sim_time >= (sim_ldma_ch[ch].done_at + sim_ldma_delay)))
+          {
+              return true;
+          }
+      }
+      return (sim_ldma_regs.IF & sim_ldma_regs.IEN & LDMA_IF_ERROR) != 0;
+    case TIMER0_IRQn:
+      return (TIMER0->IF & TIMER0->IEN) != 0;
+    case TIMER1_IRQn:
+      return (TIMER1->IF & TIMER1->IEN) != 0;
+    case I2C0_IRQn:
+      return (I2C0->IF & I2C0->IEN) != 0;
+    case I2C1_IRQn:
+      return (I2C1->IF & I2C1->IEN) != 0;
+    case LETIMER0_IRQn:
+      return (sim_letimer_regs.IF & sim_letimer_regs.IEN) != 0;
+    default:
+      return false;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Highest priority raised interrupt: equal priorities, lowest number first
+ *
+ * @param[in] enabled_only
+ *   false to include lines the NVIC has disabled
+ *
+ * @return
+ *   Interrupt number, or -1 for none
+ ******************************************************************************/
+int sim_irq_next(bool enabled_only)
+{
+  for(uint32_t irqn = 0; irqn < SIM_IRQ_COUNT; irqn++)
+  {
+      if(enabled_only && !(sim_nvic_enabled & (1ULL << irqn)))
+      {
+          continue;
+      }
+      if((sim_nvic_pending & (1ULL << irqn)) || sim_irq_raised(irqn))
+      {
+          return (int)irqn;
+      }
+  }
+  return -1;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Takes one interrupt, if one is pending and not masked
+ *
+ * @return
+ *   true if a handler ran
+ ******************************************************************************/
+bool sim_dispatch(void)
+{
+  void (*handler)(void) = NULL;
+  int irqn;
+
+  if(sim_in_isr || sim_nest)
+  {
+      return false;
+  }
+  irqn = sim_irq_next(true);
+  if(irqn < 0)
+  {
+      return false;
+  }
+  sim_nvic_pending &= ~(1ULL << irqn);
+
+  switch(irqn)
+  {
+    case LDMA_IRQn:       handler = LDMA_IRQHandler;      break;
+    case GPIO_EVEN_IRQn:  handler = GPIO_EVEN_IRQHandler; break;
+    case TIMER0_IRQn:     handler = TIMER0_IRQHandler;    break;
+    case TIMER1_IRQn:     handler = TIMER1_IRQHandler;    break;
+    case I2C0_IRQn:       handler = I2C0_IRQHandler;      break;
+    case GPIO_ODD_IRQn:   handler = GPIO_ODD_IRQHandler;  break;
+    case LETIMER0_IRQn:   handler = LETIMER0_IRQHandler;  break;
+    case I2C1_IRQn:       handler = I2C1_IRQHandler;      break;
+    default:              break;
+  }
+  if(!handler)
+  {
+      sim_fail("interrupt %d taken with no handler linked", irqn);
+  }
+
+  // exception entry
+  sim_in_isr = true;
+  sim_time += SIM_IRQ_ENTRY_CYCLES;
+  sim_isr_sim_ns = 0;
+  sim_update();
+  sim_isr_sim_ns = 0;
+
+  uint64_t start = sim_host_ns();
+  handler();
+  uint64_t ns = sim_host_ns() - start;
+  ns = (ns > sim_isr_sim_ns) ? (ns - sim_isr_sim_ns) : 0;
+
+  SIM_IRQ_STATS_STRUCT *stats = &sim_irq[irqn];
+  stats->count++;
+  stats->total_ns += ns;
+  if(ns > stats->max_ns)
+  {
+      stats->max_ns = ns;
+  }
+
+  // exception return
+  sim_time += SIM_IRQ_EXIT_CYCLES;
+  sim_in_isr = false;
+  sim_update();
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Time of the next peripheral event
+ *
+ * @return
+ *   Time, or SIM_NEVER if every peripheral is waiting on the firmware
+ ******************************************************************************/
+uint64_t sim_next_event(void)
+{
+  uint64_t next = SIM_NEVER;
+
+  // bus operations, stretches and clock low timeouts
+  for(uint32_t n = 0; n < I2C_COUNT; n++)
+  {
+      SIM_BUS_STRUCT *bus = &sim_bus[n];
+      if(bus->due < next)
+      {
+          next = bus->due;
+      }
+      if(bus->stall_since != SIM_NEVER)
+      {
+          uint32_t clto = sim_clto_cycles(bus);
+          if(clto && ((bus->stall_since + clto) < next))
+          {
+              next = bus->stall_since + clto;
+          }
+          for(SIM_SLAVE_STRUCT *slave = bus->slaves; slave; slave = slave->next)
+          {
+              if((slave->scl_hold_until > sim_time) && (slave->scl_hold_until < next))
+              {
+                  next = slave->scl_hold_until;
+              }
+          }
+      }
+  }
+
+  // LDMA done interrupts waiting out their latency
+  for(uint32_t ch = 0; ch < DMA_CHAN_COUNT; ch++)
+  {
+      uint64_t at = sim_ldma_ch[ch].done_at + sim_ldma_delay;
+      if((sim_ldma_regs.IF & sim_ldma_regs.IEN & (1UL << ch)) && (at > sim_time) && (at < next))
+      {
+          next = at;
+      }
+  }
+
+  // timer compares
+  for(uint32_t n = 0; n < SIM_TIMER_COUNT; n++)
+  {
+      TIMER_TypeDef *timer = &sim_timer_regs[n];
+      uint64_t pre = sim_timer_prescale(timer);
+      if(!sim_timer_running[n])
+      {
+          continue;
+      }
+      for(uint32_t ch = 0; ch < SIM_TIMER_CC_COUNT; ch++)
+      {
+          uint32_t flag = TIMER_IF_CC0 << ch;
+          if(!(timer->IEN & flag) || (timer->IF & flag))
+          {
+              continue;
+          }
+          uint64_t ticks = (timer->CC[ch].CCV - timer->CNT) & timer->TOP;
+          if(!ticks)
+          {
+              ticks = (uint64_t)timer->TOP + 1;
+          }
+          uint64_t at = ((sim_time / pre) + ticks) * pre;
+          if(at < next)
+          {
+              next = at;
+          }
+      }
+  }
+
+  // LETIMER0 compares and underflow
+  uint64_t at = sim_letimer_next();
+  if(at < next)
+  {
+      next = at;
+  }
+
+  return next;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sleeps the core in an energy mode
+ *
+ * @details
+ *   Lasts until an interrupt is raised, masked or not, as on the part.
+ *   EM2 and EM3 stop the HF peripherals, so entering them with an I2C
+ *   transfer, an LDMA channel or TIMER1 running fails the test; LETIMER0
+ *   is the only wake-up source left, and with none of its interrupts
+ *   enabled they return at once. A raised interrupt is taken straight away
+ *   unless it is masked.
+ ******************************************************************************/
+void sim_sleep(uint32_t em)
+{
+  uint64_t start = sim_time;
+
+  sim_update();
+  sim_em_count[em]++;
+  if((em >= EM2) && sim_hf_busy())
+  {
+      sim_fail("EM%u entered with an HF peripheral running", em);
+  }
+
+  while(sim_irq_next(false) < 0)
+  {
+      uint64_t next = sim_next_event();
+      if(next == SIM_NEVER)
+      {
+          if(em == EM1)
+          {
+              sim_fail("EM1 entered with nothing to wake the core");
+          }
+          break;
+      }
+      sim_time = next;
+      sim_update();
+  }
+  sim_em_time[em] += sim_time - start;
+
+  while(sim_dispatch());
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reports whether an HF peripheral is running
+ ******************************************************************************/
+bool sim_hf_busy(void)
+{
+  for(uint32_t n = 0; n < I2C_COUNT; n++)
+  {
+      if(sim_bus[n].state != op_idle)
+      {
+          return true;
+      }
+  }
+  for(uint32_t ch = 0; ch < DMA_CHAN_COUNT; ch++)
+  {
+      if(sim_ldma_ch[ch].active)
+      {
+          return true;
+      }
+  }
+  return sim_timer_running[1];
+}
+
+
+//***********************************************************************************
+// core, NVIC, EMU, CMU and CHIP
+//***********************************************************************************
+CORE_irqState_t sim_core_enter(void)
+{
+  return sim_nest++;
+}
+
+void sim_core_exit(CORE_irqState_t state)
+{
+  sim_nest = state;
+  if(!sim_nest && sim_active)
+  {
+      sim_update();
+      while(sim_dispatch());
+  }
+}
+
+void NVIC_EnableIRQ(IRQn_Type irqn)
+{
+  sim_nvic_enabled |= (1ULL << irqn);
+  sim_update();
+}
+
+void NVIC_DisableIRQ(IRQn_Type irqn)
+{
+  sim_nvic_enabled &= ~(1ULL << irqn);
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irqn)
+{
+  sim_nvic_pending &= ~(1ULL << irqn);
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type irqn)
+{
+  sim_nvic_pending |= (1ULL << irqn);
+}
+
+void EMU_EnterEM1(void)
+{
+  sim_sleep(EM1);
+}
+
+void EMU_EnterEM2(bool restore)
+{
+  (void)restore;
+  sim_sleep(EM2);
+}
+
+void EMU_EnterEM3(bool restore)
+{
+  (void)restore;
+  sim_sleep(EM3);
+}
+
+bool EMU_DCDCInit(const EMU_DCDCInit_TypeDef *dcdcInit)
+{
+  (void)dcdcInit;
+  return true;
+}
+
+void EMU_EM23Init(const EMU_EM23Init_TypeDef *em23Init)
+{
+  (void)em23Init;
+}
+
+void CHIP_Init(void)
+{
+}
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable)
+{
+  (void)clock;
+  (void)enable;
+}
+
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock)
+{
+  switch(clock)
+  {
+    case cmuClock_CORELE:
+    case cmuClock_LFA:
+    case cmuClock_LETIMER0:
+      return LETIMER_HZ;
+    default:
+      return SIM_CORE_HZ;
+  }
+}
+
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref)
+{
+  (void)clock;
+  (void)ref;
+}
+
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait)
+{
+  (void)osc;
+  (void)enable;
+  (void)wait;
+}
+
+void CMU_HFXOInit(const CMU_HFXOInit_TypeDef *hfxoInit)
+{
+  (void)hfxoInit;
+}
+
+void CMU_HFRCOBandSet(CMU_HFRCOFreq_TypeDef setFreq)
+{
+  (void)setFreq;
+}
+
+
+//***********************************************************************************
+// I2C
+//***********************************************************************************
+void I2C_Init(I2C_TypeDef *i2c, const I2C_Init_TypeDef *init)
+{
+  i2c->IEN = 0;
+  SIM_REG(i2c->IF) = 0;
+  I2C_BusFreqSet(i2c, init->refFreq, init->freq, init->clhr);
+  if(init->enable)
+  {
+      i2c->CTRL |= I2C_CTRL_EN;
+  }
+  else
+  {
+      i2c->CTRL &= ~I2C_CTRL_EN;
+  }
+}
+
+void I2C_BusFreqSet(I2C_TypeDef *i2c, uint32_t freqRef, uint32_t freqScl, I2C_ClockHLR_TypeDef i2cMode)
+{
+  static const uint32_t n_lh[] = { 8, 9, 17 };  // low + high periods: 4:4, 6:3, 11:6
+  uint32_t n = n_lh[i2cMode];
+  uint32_t div;
+
+  if(!freqRef)
+  {
+      freqRef = CMU_ClockFreqGet(cmuClock_HFPER);
+  }
+
+  // f_SCL = f_HFPER / (n * (DIV + 1) + 8); never faster than requested
+  div = ((freqRef - (SIM_I2C_CR_MAX * freqScl)) / (n * freqScl)) - 1;
+  if((freqRef / ((n * (div + 1)) + SIM_I2C_CR_MAX)) > freqScl)
+  {
+      div++;
+  }
+  i2c->CLKDIV = div;
+  i2c->CTRL = (i2c->CTRL & ~_I2C_CTRL_CLHR_MASK) | ((uint32_t)i2cMode << _I2C_CTRL_CLHR_SHIFT);
+}
+
+uint32_t I2C_BusFreqGet(I2C_TypeDef *i2c)
+{
+  return SIM_CORE_HZ / sim_bus_bit_cycles((uint32_t)(i2c - sim_i2c_regs));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Binds the GPIO pins carrying a bus, for bit-banging and line reads
+ ******************************************************************************/
+void sim_bus_pins(uint32_t bus, GPIO_Port_TypeDef sda_port, uint32_t sda_pin,
+                  GPIO_Port_TypeDef scl_port, uint32_t scl_pin)
+{
+  sim_bus[bus].sda_port = sda_port;
+  sim_bus[bus].sda_pin = sda_pin;
+  sim_bus[bus].scl_port = scl_port;
+  sim_bus[bus].scl_pin = scl_pin;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Powers the bus pull-ups, and the slaves, from a GPIO output
+ ******************************************************************************/
+void sim_bus_power_pin(uint32_t bus, GPIO_Port_TypeDef port, uint32_t pin)
+{
+  sim_bus[bus].pwr_gated = true;
+  sim_bus[bus].pwr_port = port;
+  sim_bus[bus].pwr_pin = pin;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reports whether a bus and its slaves are powered
+ *
+ * @param[out] since
+ *   Time the supply came up (0 for an ungated bus); may be NULL
+ ******************************************************************************/
+bool sim_bus_powered(uint32_t bus, uint64_t *since)
+{
+  SIM_BUS_STRUCT *b = &sim_bus[bus];
+  SIM_PIN_STRUCT *pin = &sim_pin[b->pwr_port][b->pwr_pin];
+  bool powered = !b->pwr_gated || ((pin->mode != gpioModeDisabled) && pin->dout);
+
+  if(since)
+  {
+      *since = b->pwr_gated ? b->pwr_since : 0;
+  }
+  return powered;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Number of times the bus supply has come up
+ ******************************************************************************/
+uint32_t sim_bus_power_ups(uint32_t bus)
+{
+  return sim_bus[bus].power_ups;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Adds a slave to a bus
+ ******************************************************************************/
+void sim_bus_attach(uint32_t bus, SIM_SLAVE_STRUCT *slave)
+{
+  slave->next = sim_bus[bus].slaves;
+  sim_bus[bus].slaves = slave;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   SCL period of a bus at its current CLKDIV and CLHR, in core cycles
+ ******************************************************************************/
+uint32_t sim_bus_bit_cycles(uint32_t bus)
+{
+  static const uint32_t n_lh[] = { 8, 9, 17, 17 };
+  I2C_TypeDef *i2c = sim_bus[bus].i2c;
+  uint32_t clhr = (i2c->CTRL & _I2C_CTRL_CLHR_MASK) >> _I2C_CTRL_CLHR_SHIFT;
+
+  return (n_lh[clhr] * ((i2c->CLKDIV & _I2C_CLKDIV_DIV_MASK) + 1)) + SIM_I2C_CR_MAX;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reports whether a bus master has released the bus
+ ******************************************************************************/
+bool sim_bus_idle(uint32_t bus)
+{
+  sim_update();
+  return sim_bus[bus].state == op_idle;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Clock low timeout of a bus in core cycles; 0 when off
+ ******************************************************************************/
+uint32_t sim_clto_cycles(SIM_BUS_STRUCT *bus)
+{
+  static const uint32_t pcc[] = { 0, 40, 80, 160, 320, 1024, 0, 0 };
+  uint32_t clto = (bus->i2c->CTRL & _I2C_CTRL_CLTO_MASK) >> _I2C_CTRL_CLTO_SHIFT;
+
+  return pcc[clto] * ((bus->i2c->CLKDIV & _I2C_CLKDIV_DIV_MASK) + 1);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Level of a bus line
+ *
+ * @details
+ *   Low when the pull-ups are unpowered, a slave holds it, or, while the
+ *   pin is taken from the peripheral, the GPIO drives it low. A disabled
+ *   pin that is not routed reads low.
+ ******************************************************************************/
+bool sim_line(SIM_BUS_STRUCT *bus, bool scl)
+{
+  I2C_TypeDef *i2c = bus->i2c;
+  bool routed = i2c->ROUTEPEN & (scl ? I2C_ROUTEPEN_SCLPEN : I2C_ROUTEPEN_SDAPEN);
+  SIM_PIN_STRUCT *pin = scl ? &sim_pin[bus->scl_port][bus->scl_pin] : &sim_pin[bus->sda_port][bus->sda_pin];
+
+  if(!routed && (pin->mode == gpioModeDisabled))
+  {
+      return false;
+  }
+  if(!sim_bus_powered((uint32_t)(bus - sim_bus), NULL))
+  {
+      return false;
+  }
+  if(!routed && !pin->dout)
+  {
+      return false;
+  }
+  for(SIM_SLAVE_STRUCT *slave = bus->slaves; slave; slave = slave->next)
+  {
+      if(scl ? (slave->scl_hold_until > sim_time) : (slave->sda_hold != 0))
+      {
+          return false;
+      }
+  }
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Puts an operation on the bus; a stretched SCL stalls it
+ ******************************************************************************/
+void sim_bus_begin(SIM_BUS_STRUCT *bus, SIM_BUS_STATE_Typedef state, uint32_t bits)
+{
+  bus->state = state;
+  bus->bits = bits;
+  bus->due = sim_time + ((uint64_t)bits * sim_bus_bit_cycles((uint32_t)(bus - sim_bus)));
+  bus->stall_since = SIM_NEVER;
+  if(!sim_line(bus, true))
+  {
+      bus->due = SIM_NEVER;
+      bus->stall_since = sim_time;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   The master holds the bus, waiting on the firmware
+ ******************************************************************************/
+void sim_bus_waiting(SIM_BUS_STRUCT *bus)
+{
+  bus->state = op_wait;
+  bus->due = SIM_NEVER;
+  if(bus->stop_pending)
+  {
+      bus->stop_pending = false;
+      sim_bus_begin(bus, op_stop, SIM_STOP_BITS);
+  }
+  else if(bus->start_pending)
+  {
+      bus->start_pending = false;
+      bus->state = op_start;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   The master has released the bus
+ ******************************************************************************/
+void sim_bus_released(SIM_BUS_STRUCT *bus)
+{
+  bus->state = op_idle;
+  bus->due = SIM_NEVER;
+  bus->stall_since = SIM_NEVER;
+  bus->slave = NULL;
+  bus->start_pending = false;
+  bus->stop_pending = false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Applies register writes and completes a due bus operation
+ *
+ * @return
+ *   true if anything changed
+ ******************************************************************************/
+bool sim_bus_apply(SIM_BUS_STRUCT *bus)
+{
+  I2C_TypeDef *i2c = bus->i2c;
+  bool progress = false;
+  uint32_t value;
+
+  // flag clears
+  if((value = i2c->IFC))
+  {
+      SIM_REG(i2c->IF) &= ~value;
+      i2c->IFC = 0;
+  }
+
+  // commands
+  if((value = i2c->CMD))
+  {
+      i2c->CMD = 0;
+      sim_bus_cmd(bus, value);
+      progress = true;
+  }
+
+  // transmit buffer: an address after START, or the next data byte after an ACK
+  if(i2c->TXDATA != SIM_TX_EMPTY)
+  {
+      if(bus->state == op_start)
+      {
+          bus->shift = (uint8_t)i2c->TXDATA;
+          i2c->TXDATA = SIM_TX_EMPTY;
+          sim_bus_begin(bus, op_addr, SIM_ADDR_BITS);
+          progress = true;
+      }
+      else if((bus->state == op_wait) && bus->slave && !bus->read && bus->acked)
+      {
+          bus->shift = (uint8_t)i2c->TXDATA;
+          i2c->TXDATA = SIM_TX_EMPTY;
+          sim_bus_begin(bus, op_tx, SIM_BYTE_BITS);
+          progress = true;
+      }
+  }
+
+  // a stretched SCL: resume once released, or time out
+  if(bus->stall_since != SIM_NEVER)
+  {
+      uint32_t clto = sim_clto_cycles(bus);
+      if(sim_line(bus, true))
+      {
+          SIM_BUS_STATE_Typedef state = bus->state;
+          sim_bus_begin(bus, state, bus->bits);
+          progress = true;
+      }
+      else if(clto && (sim_time >= (bus->stall_since + clto)))
+      {
+          SIM_REG(i2c->IF) |= I2C_IF_CLTO;
+          sim_bus_released(bus);
+          progress = true;
+      }
+  }
+
+  // operation complete
+  if(bus->due <= sim_time)
+  {
+      sim_bus_complete(bus);
+      progress = true;
+  }
+
+  // RXDATA read: a held byte moves in
+  if((bus->state == op_rx_held) && !bus->rx_full)
+  {
+      sim_bus_deliver(bus, bus->held);
+      progress = true;
+  }
+
+  // level flags and state
+  if(bus->rx_full)
+  {
+      SIM_REG(i2c->IF) |= I2C_IF_RXDATAV;
+  }
+  else
+  {
+      SIM_REG(i2c->IF) &= ~I2C_IF_RXDATAV;
+  }
+  SIM_REG(i2c->STATE) = (bus->state == op_idle) ? I2C_STATE_STATE_IDLE : (SIM_I2C_STATE_WAIT | I2C_STATE_BUSY);
+
+  return progress;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Executes a CMD register write
+ ******************************************************************************/
+void sim_bus_cmd(SIM_BUS_STRUCT *bus, uint32_t cmd)
+{
+  I2C_TypeDef *i2c = bus->i2c;
+
+  if(cmd & I2C_CMD_ABORT)
+  {
+      sim_bus_released(bus);
+      return;
+  }
+  if(cmd & I2C_CMD_CLEARTX)
+  {
+      i2c->TXDATA = SIM_TX_EMPTY;
+  }
+
+  // START + STOP: bus reset, completes only on a free bus
+  if((cmd & I2C_CMD_START) && (cmd & I2C_CMD_STOP))
+  {
+      sim_bus_released(bus);
+      i2c->TXDATA = SIM_TX_EMPTY;
+      bus->rx_full = false;
+      if(sim_line(bus, false) && sim_line(bus, true))
+      {
+          sim_bus_begin(bus, op_reset, SIM_RESET_BITS);
+      }
+      return;
+  }
+
+  // the master's answer to a byte received
+  if(bus->state == op_wait_ack)
+  {
+      if(cmd & (I2C_CMD_ACK | I2C_CMD_NACK | I2C_CMD_STOP | I2C_CMD_START))
+      {
+          bool ack = (cmd & I2C_CMD_ACK) != 0;
+          if(bus->slave && bus->slave->ack_cb)
+          {
+              bus->slave->ack_cb(bus->slave, ack);
+          }
+          bus->rx_full = false;
+          if(ack)
+          {
+              sim_bus_begin(bus, op_rx, SIM_BYTE_BITS);
+          }
+          else
+          {
+              sim_bus_waiting(bus);
+          }
+      }
+  }
+
+  if(cmd & I2C_CMD_START)
+  {
+      if((bus->state == op_idle) || (bus->state == op_wait))
+      {
+          bus->state = op_start;
+          bus->due = SIM_NEVER;
+      }
+      else if(bus->state != op_start)
+      {
+          bus->start_pending = true;
+      }
+  }
+  else if(cmd & I2C_CMD_STOP)
+  {
+      if((bus->state == op_wait) || (bus->state == op_start))
+      {
+          sim_bus_begin(bus, op_stop, SIM_STOP_BITS);
+      }
+      else if(bus->state != op_idle)
+      {
+          bus->stop_pending = true;
+      }
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Completes the bus operation in progress
+ ******************************************************************************/
+void sim_bus_complete(SIM_BUS_STRUCT *bus)
+{
+  I2C_TypeDef *i2c = bus->i2c;
+  SIM_SLAVE_STRUCT *slave;
+  bool ack;
+
+  bus->due = SIM_NEVER;
+  switch(bus->state)
+  {
+    case op_addr:
+      // slave lookup; only a slave that ACKs is addressed
+      bus->read = bus->shift & 1;
+      bus->slave = NULL;
+      ack = false;
+      for(slave = bus->slaves; slave; slave = slave->next)
+      {
+          if(slave->addr == (uint32_t)(bus->shift >> 1))
+          {
+              ack = !slave->addr_cb || slave->addr_cb(slave, bus->read);
+              break;
+          }
+      }
+      if(ack)
+      {
+          bus->slave = slave;
+      }
+      bus->acked = ack;
+      SIM_REG(i2c->IF) |= ack ? I2C_IF_ACK : I2C_IF_NACK;
+      if(ack && bus->read)
+      {
+          sim_bus_begin(bus, op_rx, SIM_BYTE_BITS);
+      }
+      else
+      {
+          sim_bus_waiting(bus);
+      }
+      break;
+    case op_tx:
+      ack = !bus->slave->write_cb || bus->slave->write_cb(bus->slave, bus->shift);
+      bus->acked = ack;
+      SIM_REG(i2c->IF) |= ack ? I2C_IF_ACK : I2C_IF_NACK;
+      sim_bus_waiting(bus);
+
+      // automatic STOP once the last byte is ACKed and nothing is left to send
+      if(ack && (bus->state == op_wait) && (i2c->CTRL & I2C_CTRL_AUTOSE) && (i2c->TXDATA == SIM_TX_EMPTY))
+      {
+          sim_bus_begin(bus, op_stop, SIM_STOP_BITS);
+      }
+      break;
+    case op_rx:
+      bus->held = bus->slave->read_cb ? bus->slave->read_cb(bus->slave) : 0xFF;
+      if(bus->rx_full)
+      {
+          bus->state = op_rx_held;
+      }
+      else
+      {
+          sim_bus_deliver(bus, bus->held);
+      }
+      break;
+    case op_stop:
+    case op_reset:
+      for(slave = bus->slaves; slave; slave = slave->next)
+      {
+          if(slave->stop_cb && ((bus->state == op_reset) || (slave == bus->slave)))
+          {
+              slave->stop_cb(slave);
+          }
+      }
+      SIM_REG(i2c->IF) |= I2C_IF_MSTOP;
+      sim_bus_released(bus);
+      break;
+    default:
+      break;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Moves a received byte into RXDATA
+ *
+ * @details
+ *   With AUTOACK the byte is ACKed straight away and the next one starts
+ *   into the shift register; otherwise the master waits for ACK or NACK.
+ ******************************************************************************/
+void sim_bus_deliver(SIM_BUS_STRUCT *bus, uint8_t byte)
+{
+  I2C_TypeDef *i2c = bus->i2c;
+
+  SIM_REG(i2c->RXDATA) = byte;
+  bus->rx_full = true;
+  SIM_REG(i2c->IF) |= I2C_IF_RXDATAV;
+  if(i2c->CTRL & I2C_CTRL_AUTOACK)
+  {
+      if(bus->slave->ack_cb)
+      {
+          bus->slave->ack_cb(bus->slave, true);
+      }
+      sim_bus_begin(bus, op_rx, SIM_BYTE_BITS);
+  }
+  else
+  {
+      bus->state = op_wait_ack;
+      bus->due = SIM_NEVER;
+  }
+}
+
+
+//***********************************************************************************
+// LDMA
+//***********************************************************************************
+void LDMA_Init(const LDMA_Init_t *init)
+{
+  (void)init;
+  memset(sim_ldma_ch, 0, sizeof(sim_ldma_ch));
+  SIM_REG(sim_ldma_regs.IF) = 0;
+  sim_ldma_regs.IEN = 0;
+  sim_ldma_regs.CHEN = 0;
+  NVIC_EnableIRQ(LDMA_IRQn);
+}
+
+void LDMA_StartTransfer(int ch, const LDMA_TransferCfg_t *transfer, const LDMA_Descriptor_t *descriptor)
+{
+  sim_ldma_ch[ch].desc = descriptor;
+  sim_ldma_ch[ch].signal = (LDMA_PeripheralSignal_t)transfer->ldmaReqSel;
+  sim_ldma_ch[ch].moved = 0;
+  sim_ldma_ch[ch].active = true;
+  sim_ldma_regs.CHEN |= (1UL << ch);
+  sim_ldma_regs.IEN |= (1UL << ch);
+  sim_update();
+}
+
+void LDMA_StopTransfer(int ch)
+{
+  sim_ldma_ch[ch].active = false;
+  sim_ldma_regs.CHEN &= ~(1UL << ch);
+  sim_ldma_regs.IEN &= ~(1UL << ch);
+  sim_update();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Latency from an LDMA done flag to its interrupt being taken
+ ******************************************************************************/
+void sim_ldma_irq_delay(uint64_t cycles)
+{
+  sim_ldma_delay = cycles;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Serves every LDMA request that is raised
+ *
+ * @return
+ *   true if anything moved
+ ******************************************************************************/
+bool sim_ldma_service(void)
+{
+  bool progress = false;
+
+  for(uint32_t ch = 0; ch < DMA_CHAN_COUNT; ch++)
+  {
+      SIM_LDMA_CH_STRUCT *chan = &sim_ldma_ch[ch];
+      while(chan->active)
+      {
+          const LDMA_Descriptor_t *desc = chan->desc;
+
+          // immediate write
+          if(desc->wri.structType == ldmaCtrlStructTypeWrite)
+          {
+              *(volatile uint32_t *)desc->wri.dstAddr = desc->wri.immVal;
+              sim_ldma_desc_done(ch);
+              progress = true;
+              continue;
+          }
+
+          // one byte per request
+          SIM_BUS_STRUCT *bus;
+          switch(chan->signal)
+          {
+            case ldmaPeripheralSignal_I2C0_RXDATAV:
+            case ldmaPeripheralSignal_I2C1_RXDATAV:
+              bus = &sim_bus[chan->signal == ldmaPeripheralSignal_I2C1_RXDATAV];
+              if(!bus->rx_full)
+              {
+                  break;
+              }
+              ((uint8_t *)desc->xfer.dstAddr)[chan->moved++] = (uint8_t)bus->i2c->RXDATA;
+              bus->rx_full = false;
+              SIM_REG(bus->i2c->IF) &= ~I2C_IF_RXDATAV;
+              progress = true;
+              break;
+            case ldmaPeripheralSignal_I2C0_TXBL:
+            case ldmaPeripheralSignal_I2C1_TXBL:
+              bus = &sim_bus[chan->signal == ldmaPeripheralSignal_I2C1_TXBL];
+              if(bus->i2c->TXDATA != SIM_TX_EMPTY)
+              {
+                  break;
+              }
+              bus->i2c->TXDATA = ((const uint8_t *)desc->xfer.srcAddr)[chan->moved++];
+              progress = true;
+              break;
+            default:
+              sim_fail("LDMA channel %u started without a request signal", ch);
+              break;
+          }
+          if(!progress || (chan->moved <= desc->xfer.xferCnt))
+          {
+              break;
+          }
+          sim_ldma_desc_done(ch);
+      }
+  }
+  return progress;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Ends a descriptor: raises its done flag and follows its link
+ ******************************************************************************/
+void sim_ldma_desc_done(uint32_t ch)
+{
+  SIM_LDMA_CH_STRUCT *chan = &sim_ldma_ch[ch];
+  const LDMA_Descriptor_t *desc = chan->desc;
+
+  if(desc->xfer.doneIfs)
+  {
+      SIM_REG(sim_ldma_regs.IF) |= (1UL << ch);
+      chan->done_at = sim_time;
+  }
+
+  // linkAddr counts words; a descriptor is four words on the part
+  if(desc->xfer.link)
+  {
+      chan->desc = desc + (desc->xfer.linkAddr / 4);
+      chan->moved = 0;
+  }
+  else
+  {
+      chan->active = false;
+      sim_ldma_regs.CHEN &= ~(1UL << ch);
+      sim_ldma_regs.CHDONE |= (1UL << ch);
+  }
+}
+
+
+//***********************************************************************************
+// TIMER
+//***********************************************************************************
+void TIMER_Init(TIMER_TypeDef *timer, const TIMER_Init_TypeDef *init)
+{
+  uint32_t n = (uint32_t)(timer - sim_timer_regs);
+
+  sim_timer_running[n] = false;
+  timer->CTRL = ((uint32_t)init->prescale << SIM_TIMER_PRESC_SHIFT);
+  timer->CNT = 0;
+  if(init->enable)
+  {
+      TIMER_Enable(timer, true);
+  }
+}
+
+void TIMER_InitCC(TIMER_TypeDef *timer, unsigned int ch, const TIMER_InitCC_TypeDef *init)
+{
+  timer->CC[ch].CTRL = init->mode;
+}
+
+void TIMER_TopSet(TIMER_TypeDef *timer, uint32_t val)
+{
+  timer->TOP = val;
+}
+
+void TIMER_Enable(TIMER_TypeDef *timer, bool enable)
+{
+  uint32_t n = (uint32_t)(timer - sim_timer_regs);
+
+  sim_update();
+  sim_timer_running[n] = enable;
+  sim_timer_last[n] = sim_time;
+  SIM_REG(timer->STATUS) = enable ? SIM_TIMER_RUNNING : 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Prescaler division of a timer
+ ******************************************************************************/
+uint32_t sim_timer_prescale(TIMER_TypeDef *timer)
+{
+  return 1UL << ((timer->CTRL >> SIM_TIMER_PRESC_SHIFT) & 0xF);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Applies timer flag set and clear writes, clears first
+ ******************************************************************************/
+void sim_timer_apply(void)
+{
+  for(uint32_t n = 0; n < SIM_TIMER_COUNT; n++)
+  {
+      TIMER_TypeDef *timer = &sim_timer_regs[n];
+      if(timer->IFC)
+      {
+          SIM_REG(timer->IF) &= ~timer->IFC;
+          timer->IFC = 0;
+      }
+      if(timer->IFS)
+      {
+          SIM_REG(timer->IF) |= timer->IFS;
+          timer->IFS = 0;
+      }
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Brings the running timers up to the current time
+ *
+ * @details
+ *   The prescaler is aligned to time zero. A compare flag is raised when the
+ *   counter steps onto its CCV.
+ ******************************************************************************/
+void sim_timer_count(void)
+{
+  for(uint32_t n = 0; n < SIM_TIMER_COUNT; n++)
+  {
+      TIMER_TypeDef *timer = &sim_timer_regs[n];
+      uint64_t pre = sim_timer_prescale(timer);
+      if(!sim_timer_running[n])
+      {
+          continue;
+      }
+
+      uint64_t ticks = (sim_time / pre) - (sim_timer_last[n] / pre);
+      sim_timer_last[n] = sim_time;
+      if(!ticks)
+      {
+          continue;
+      }
+
+      uint32_t top = timer->TOP;
+      uint32_t cnt = timer->CNT;
+      for(uint32_t ch = 0; ch < SIM_TIMER_CC_COUNT; ch++)
+      {
+          if((timer->CC[ch].CTRL == timerCCModeCompare) && (((timer->CC[ch].CCV - cnt - 1) & top) < ticks))
+          {
+              SIM_REG(timer->IF) |= (TIMER_IF_CC0 << ch);
+          }
+      }
+      if((cnt + ticks) > top)
+      {
+          SIM_REG(timer->IF) |= TIMER_IF_OF;
+      }
+      timer->CNT = (uint32_t)((cnt + ticks) % ((uint64_t)top + 1));
+  }
+}
+
+
+//***********************************************************************************
+// LETIMER
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   LETIMER0 register block; every access brings the peripherals up to date
+ ******************************************************************************/
+LETIMER_TypeDef *sim_letimer(void)
+{
+  if(sim_active)
+  {
+      sim_update();
+  }
+  return &sim_letimer_regs;
+}
+
+void LETIMER_Init(LETIMER_TypeDef *letimer, const LETIMER_Init_TypeDef *init)
+{
+  sim_update();
+  letimer->CTRL = init->comp0Top ? LETIMER_CTRL_COMP0TOP : 0;
+  LETIMER_Enable(letimer, init->enable);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Writes a compare register
+ *
+ * @details
+ *   The counter runs on the LFCLK, so it only sees the new value
+ *   SIM_LETIMER_SYNC_TICKS later; until then it matches against the old
+ *   one. A hold set with sim_letimer_hold() is played out first, as if the
+ *   core had been held up on its way to the write.
+ ******************************************************************************/
+void LETIMER_CompareSet(LETIMER_TypeDef *letimer, unsigned int comp, uint32_t value)
+{
+  SIM_LETIMER_COMP_STRUCT *c = &sim_letimer_comp[comp];
+
+  sim_update();
+  if(sim_letimer_hold_cycles)
+  {
+      sim_time += sim_letimer_hold_cycles;
+      sim_letimer_hold_cycles = 0;
+      sim_update();
+  }
+
+  value &= _LETIMER_CNT_MASK;
+  if(comp == SIM_LETIMER_COMP0)
+  {
+      letimer->COMP0 = value;
+  }
+  else
+  {
+      letimer->COMP1 = value;
+  }
+  c->pending = value;
+  c->pending_at = (sim_time / SIM_LETIMER_CYCLES) + sim_letimer_sync;
+  c->writes++;
+}
+
+void LETIMER_RepeatSet(LETIMER_TypeDef *letimer, unsigned int rep, uint32_t value)
+{
+  if(rep == SIM_LETIMER_REP0)
+  {
+      letimer->REP0 = value;
+  }
+  else
+  {
+      letimer->REP1 = value;
+  }
+}
+
+void LETIMER_Enable(LETIMER_TypeDef *letimer, bool enable)
+{
+  sim_update();
+  letimer->CMD = enable ? LETIMER_CMD_START : LETIMER_CMD_STOP;
+  sim_letimer_apply();
+}
+
+uint32_t LETIMER_CounterGet(LETIMER_TypeDef *letimer)
+{
+  sim_update();
+  return letimer->CNT;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sets the number of LFCLK cycles a compare write takes to reach the
+ *   counter (SIM_LETIMER_SYNC_TICKS after sim_init())
+ ******************************************************************************/
+void sim_letimer_sync_ticks(uint64_t ticks)
+{
+  sim_letimer_sync = ticks;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Holds the core up for a number of cycles in the next compare write,
+ *   before the value is written
+ ******************************************************************************/
+void sim_letimer_hold(uint64_t cycles)
+{
+  sim_letimer_hold_cycles = cycles;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Number of LETIMER_CompareSet() calls for a compare register
+ ******************************************************************************/
+uint32_t sim_letimer_writes(uint32_t comp)
+{
+  return sim_letimer_comp[comp].writes;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Applies commands and flag set and clear writes, clears first
+ ******************************************************************************/
+void sim_letimer_apply(void)
+{
+  LETIMER_TypeDef *letimer = &sim_letimer_regs;
+
+  if(letimer->CMD)
+  {
+      // bring the counter up to date before it starts or stops
+      sim_letimer_count();
+      if(letimer->CMD & LETIMER_CMD_CLEAR)
+      {
+          letimer->CNT = 0;
+      }
+      if(letimer->CMD & LETIMER_CMD_START)
+      {
+          sim_letimer_running = true;
+      }
+      if(letimer->CMD & LETIMER_CMD_STOP)
+      {
+          sim_letimer_running = false;
+      }
+      SIM_REG(letimer->STATUS) = sim_letimer_running ? LETIMER_STATUS_RUNNING : 0;
+      letimer->CMD = 0;
+  }
+  if(letimer->IFC)
+  {
+      SIM_REG(letimer->IF) &= ~letimer->IFC;
+      letimer->IFC = 0;
+  }
+  if(letimer->IFS)
+  {
+      SIM_REG(letimer->IF) |= letimer->IFS;
+      letimer->IFS = 0;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Brings the counter up to the current time
+ *
+ * @details
+ *   Counts down one step per LFCLK cycle, from the top value to zero and
+ *   round again; compare writes reach it at their tick.
+ ******************************************************************************/
+void sim_letimer_count(void)
+{
+  uint64_t tick = sim_time / SIM_LETIMER_CYCLES;
+
+  while(sim_letimer_tick < tick)
+  {
+      uint64_t until = tick;
+
+      // compare writes that have reached the counter
+      for(uint32_t n = 0; n < SIM_LETIMER_COMPS; n++)
+      {
+          SIM_LETIMER_COMP_STRUCT *c = &sim_letimer_comp[n];
+          if(c->pending_at <= (sim_letimer_tick + 1))
+          {
+              c->value = c->pending;
+              c->pending_at = SIM_NEVER;
+          }
+          if((c->pending_at - 1) < until)
+          {
+              until = c->pending_at - 1;
+          }
+      }
+
+      if(sim_letimer_running)
+      {
+          sim_letimer_step(until - sim_letimer_tick);
+      }
+      sim_letimer_tick = until;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Counts the counter down a number of steps, raising the compare and
+ *   underflow flags it passes
+ *
+ * @details
+ *   A compare flag is raised when the counter steps onto the compare
+ *   value; the underflow flag when it steps from zero to the top value.
+ ******************************************************************************/
+void sim_letimer_step(uint64_t ticks)
+{
+  LETIMER_TypeDef *letimer = &sim_letimer_regs;
+  uint32_t top = (letimer->CTRL & LETIMER_CTRL_COMP0TOP) ? sim_letimer_comp[SIM_LETIMER_COMP0].value : _LETIMER_CNT_MASK;
+  uint64_t period = (uint64_t)top + 1;
+  uint32_t cnt = letimer->CNT;
+
+  for(uint32_t n = 0; n < SIM_LETIMER_COMPS; n++)
+  {
+      if(sim_letimer_match(sim_letimer_comp[n].value, 1) <= ticks)
+      {
+          SIM_REG(letimer->IF) |= (n == SIM_LETIMER_COMP0) ? LETIMER_IF_COMP0 : LETIMER_IF_COMP1;
+      }
+  }
+  if(ticks > cnt)
+  {
+      SIM_REG(letimer->IF) |= LETIMER_IF_UF;
+      letimer->CNT = top - (uint32_t)((ticks - cnt - 1) % period);
+  }
+  else
+  {
+      letimer->CNT = cnt - (uint32_t)ticks;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Steps until the counter next steps onto a value
+ *
+ * @param[in] value
+ *   Compare value
+ *
+ * @param[in] from
+ *   Fewest steps to look at (at least 1)
+ *
+ * @return
+ *   Steps, or SIM_NEVER if the counter never reaches the value
+ ******************************************************************************/
+uint64_t sim_letimer_match(uint32_t value, uint64_t from)
+{
+  LETIMER_TypeDef *letimer = &sim_letimer_regs;
+  uint32_t top = (letimer->CTRL & LETIMER_CTRL_COMP0TOP) ? sim_letimer_comp[SIM_LETIMER_COMP0].value : _LETIMER_CNT_MASK;
+  uint64_t period = (uint64_t)top + 1;
+
+  if(value > top)
+  {
+      return SIM_NEVER;
+  }
+
+  // after m steps the counter holds (CNT - m) modulo the period
+  uint64_t steps = ((uint64_t)letimer->CNT + period - value) % period;
+  if(steps < from)
+  {
+      steps += ((from - steps + period - 1) / period) * period;
+  }
+  return steps;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Time of the next enabled LETIMER0 flag not yet raised
+ *
+ * @return
+ *   Time, or SIM_NEVER if none is coming
+ ******************************************************************************/
+uint64_t sim_letimer_next(void)
+{
+  LETIMER_TypeDef *letimer = &sim_letimer_regs;
+  uint64_t next = SIM_NEVER;
+
+  if(!sim_letimer_running)
+  {
+      return SIM_NEVER;
+  }
+
+  for(uint32_t n = 0; n < SIM_LETIMER_COMPS; n++)
+  {
+      SIM_LETIMER_COMP_STRUCT *c = &sim_letimer_comp[n];
+      uint32_t flag = (n == SIM_LETIMER_COMP0) ? LETIMER_IF_COMP0 : LETIMER_IF_COMP1;
+      if(!(letimer->IEN & flag) || (letimer->IF & flag))
+      {
+          continue;
+      }
+
+      // the old value until a write reaches the counter, the new one after
+      uint64_t steps = sim_letimer_match(c->value, 1);
+      if(c->pending_at != SIM_NEVER)
+      {
+          uint64_t lands = c->pending_at - sim_letimer_tick;
+          if(steps >= lands)
+          {
+              steps = sim_letimer_match(c->pending, (lands > 1) ? lands : 1);
+          }
+      }
+      if((steps != SIM_NEVER) && ((sim_letimer_tick + steps) < next))
+      {
+          next = sim_letimer_tick + steps;
+      }
+  }
+  if((letimer->IEN & LETIMER_IF_UF) && !(letimer->IF & LETIMER_IF_UF) &&
+     ((sim_letimer_tick + letimer->CNT + 1) < next))
+  {
+      next = sim_letimer_tick + letimer->CNT + 1;
+  }
+
+  return (next == SIM_NEVER) ? SIM_NEVER : next * SIM_LETIMER_CYCLES;
+}
+
+
+//***********************************************************************************
+// GPIO
+//***********************************************************************************
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out)
+{
+  sim_pin_write(port, pin, out, mode);
+}
+
+void GPIO_DriveStrengthSet(GPIO_Port_TypeDef port, GPIO_DriveStrength_TypeDef strength)
+{
+  (void)port;
+  (void)strength;
+}
+
+void GPIO_PinOutSet(GPIO_Port_TypeDef port, unsigned int pin)
+{
+  sim_pin_write(port, pin, 1, sim_pin[port][pin].mode);
+}
+
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin)
+{
+  sim_pin_write(port, pin, 0, sim_pin[port][pin].mode);
+}
+
+void GPIO_PinOutToggle(GPIO_Port_TypeDef port, unsigned int pin)
+{
+  sim_pin_write(port, pin, !sim_pin[port][pin].dout, sim_pin[port][pin].mode);
+}
+
+unsigned int GPIO_PinInGet(GPIO_Port_TypeDef port, unsigned int pin)
+{
+  for(uint32_t n = 0; n < I2C_COUNT; n++)
+  {
+      SIM_BUS_STRUCT *bus = &sim_bus[n];
+      if((port == bus->sda_port) && (pin == bus->sda_pin))
+      {
+          return sim_line(bus, false);
+      }
+      if((port == bus->scl_port) && (pin == bus->scl_pin))
+      {
+          return sim_line(bus, true);
+      }
+  }
+  if(sim_pin[port][pin].mode == gpioModeDisabled)
+  {
+      return 0;
+  }
+  return sim_pin[port][pin].dout;
+}
+
+void GPIO_ExtIntConfig(GPIO_Port_TypeDef port, unsigned int pin, unsigned int intNo,
+                       bool risingEdge, bool fallingEdge, bool enable)
+{
+  (void)port;
+  (void)pin;
+  (void)risingEdge;
+  (void)fallingEdge;
+  if(enable)
+  {
+      sim_gpio_regs.IEN |= (1UL << intNo);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Writes a pin, and plays out its effect on the buses
+ *
+ * @details
+ *   An SCL rising edge bit-banged while the pin is taken from the
+ *   peripheral clocks one bit out of every slave holding SDA. A rising
+ *   edge of a bus supply pin starts its power-up.
+ ******************************************************************************/
+void sim_pin_write(GPIO_Port_TypeDef port, uint32_t pin, uint32_t dout, GPIO_Mode_TypeDef mode)
+{
+  bool scl_was[I2C_COUNT];
+  bool pwr_was[I2C_COUNT];
+
+  for(uint32_t n = 0; n < I2C_COUNT; n++)
+  {
+      scl_was[n] = sim_line(&sim_bus[n], true);
+      pwr_was[n] = sim_bus_powered(n, NULL);
+  }
+
+  sim_pin[port][pin].mode = mode;
+  sim_pin[port][pin].dout = dout ? 1 : 0;
+
+  for(uint32_t n = 0; n < I2C_COUNT; n++)
+  {
+      SIM_BUS_STRUCT *bus = &sim_bus[n];
+      if(!pwr_was[n] && sim_bus_powered(n, NULL))
+      {
+          bus->pwr_since = sim_time;
+          bus->power_ups++;
+      }
+      if((port == bus->scl_port) && (pin == bus->scl_pin) && !scl_was[n] && sim_line(bus, true))
+      {
+          for(SIM_SLAVE_STRUCT *slave = bus->slaves; slave; slave = slave->next)
+          {
+              if(slave->sda_hold && (slave->sda_hold != SIM_HOLD_FOREVER))
+              {
+                  slave->sda_hold--;
+              }
+          }
+      }
+  }
+  sim_update();
+}
+
+
+//***********************************************************************************
+// memory slave
+//***********************************************************************************
+static bool sim_mem_addr(SIM_SLAVE_STRUCT *slave, bool read)
+{
+  SIM_MEM_STRUCT *mem = (SIM_MEM_STRUCT *)slave;
+
+  if(mem->nack_addr)
+  {
+      mem->nack_addr--;
+      mem->addr_nacks++;
+      return false;
+  }
+  mem->addr_acks++;
+  mem->written = 0;
+  mem->read_run = 0;
+  mem->read_nacked = false;
+  if(!read)
+  {
+      mem->ptr_next = true;
+  }
+  return true;
+}
+
+static bool sim_mem_write(SIM_SLAVE_STRUCT *slave, uint8_t byte)
+{
+  SIM_MEM_STRUCT *mem = (SIM_MEM_STRUCT *)slave;
+
+  mem->written++;
+  if(mem->nack_byte == mem->written)
+  {
+      return false;
+  }
+  if(mem->stretch_byte == mem->written)
+  {
+      slave->scl_hold_until = sim_now() + mem->stretch_cycles;
+  }
+  mem->writes++;
+  if(mem->ptr_next)
+  {
+      mem->ptr = byte;
+      mem->ptr_next = false;
+  }
+  else
+  {
+      mem->mem[mem->ptr++] = byte;
+  }
+  return true;
+}
+
+static uint8_t sim_mem_read(SIM_SLAVE_STRUCT *slave)
+{
+  SIM_MEM_STRUCT *mem = (SIM_MEM_STRUCT *)slave;
+
+  if(mem->read_nacked)
+  {
+      mem->reads_after_nack++;
+  }
+  mem->reads++;
+  mem->read_run++;
+  return mem->mem[mem->ptr++];
+}
+
+static void sim_mem_ack(SIM_SLAVE_STRUCT *slave, bool ack)
+{
+  SIM_MEM_STRUCT *mem = (SIM_MEM_STRUCT *)slave;
+
+  if(ack)
+  {
+      mem->master_acks++;
+  }
+  else
+  {
+      mem->master_nacks++;
+      mem->read_nacked = true;
+      mem->last_run = mem->read_run;
+  }
+}
+
+static void sim_mem_stop(SIM_SLAVE_STRUCT *slave)
+{
+  ((SIM_MEM_STRUCT *)slave)->stops++;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes a register file slave
+ ******************************************************************************/
+void sim_mem_init(SIM_MEM_STRUCT *mem, uint32_t addr)
+{
+  memset(mem, 0, sizeof(*mem));
+  mem->slave.addr = addr;
+  mem->slave.addr_cb = sim_mem_addr;
+  mem->slave.write_cb = sim_mem_write;
+  mem->slave.read_cb = sim_mem_read;
+  mem->slave.ack_cb = sim_mem_ack;
+  mem->slave.stop_cb = sim_mem_stop;
+}
+
+
+//***********************************************************************************
+// Si7021 slave
+//***********************************************************************************
+// CRC-8 of the Si7021, bit by bit: polynomial 0x31, initialized to 0x00, MSB first
+static uint8_t sim_si7021_crc(uint8_t crc, uint8_t byte)
+{
+  crc ^= byte;
+  for(uint32_t bit = 0; bit < 8; bit++)
+  {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+  }
+  return crc;
+}
+
+static bool sim_si7021_addr(SIM_SLAVE_STRUCT *slave, bool read)
+{
+  SIM_SI7021_STRUCT *si = (SIM_SI7021_STRUCT *)slave;
+  uint64_t since;
+  uint8_t crc = 0;
+
+  // no answer until the power-up time has elapsed; a power cycle resets the sensor
+  if(!sim_bus_powered(si->bus, &since) || (sim_time < since + si->powerup_cycles))
+  {
+      return false;
+  }
+  if(since != si->powered_since)
+  {
+      si->powered_since = since;
+      si->reg1 = 0x3A;
+      si->result = false;
+  }
+
+  if(!read)
+  {
+      si->cmd_len = 0;
+      si->addr_acks++;
+      return true;
+  }
+
+  // the response follows the command written last
+  si->out_len = 0;
+  si->out_pos = 0;
+  switch(si->cmd[0])
+  {
+    case 0xF5:
+      if(si->result && (sim_time < si->conv_done))
+      {
+          si->early_reads++;
+          return false;
+      }
+      if(!si->result)
+      {
+          return false;
+      }
+      si->out[0] = si->rh_result >> 8;
+      si->out[1] = si->rh_result & 0xFF;
+      si->out[2] = sim_si7021_crc(sim_si7021_crc(0, si->out[0]), si->out[1]);
+      si->out_len = 3;
+      break;
+    case 0xE0:
+      if(!si->result)
+      {
+          return false;
+      }
+      si->out[0] = si->t_result >> 8;
+      si->out[1] = si->t_result & 0xFF;
+      si->out_len = 2;
+      break;
+    case 0xE7:
+      si->out[0] = si->reg1;
+      si->out_len = 1;
+      break;
+    case 0xFA:
+      // SNA_3, CRC, SNA_2, CRC, SNA_1, CRC, SNA_0, CRC; each CRC covers the serial bytes so far
+      for(uint32_t n = 0; n < 4; n++)
+      {
+          uint8_t byte = (uint8_t)(si->serial_a >> (24 - (8 * n)));
+          crc = sim_si7021_crc(crc, byte);
+          si->out[si->out_len++] = byte;
+          si->out[si->out_len++] = crc;
+      }
+      break;
+    case 0xFC:
+      // SNB_3, SNB_2, CRC, SNB_1, SNB_0, CRC
+      for(uint32_t n = 0; n < 4; n++)
+      {
+          uint8_t byte = (uint8_t)(si->serial_b >> (24 - (8 * n)));
+          crc = sim_si7021_crc(crc, byte);
+          si->out[si->out_len++] = byte;
+          if(n & 1)
+          {
+              si->out[si->out_len++] = crc;
+          }
+      }
+      break;
+    case 0x84:
+      si->out[0] = si->fw_rev;
+      si->out_len = 1;
+      break;
+    default:
+      return false;
+  }
+  if((si->cmd[0] == 0xFA) || (si->cmd[0] == 0xFC))
+  {
+      si->out[si->out_len - 1] ^= si->id_crc_xor;
+  }
+  si->addr_acks++;
+  return true;
+}
+
+static bool sim_si7021_write(SIM_SLAVE_STRUCT *slave, uint8_t byte)
+{
+  SIM_SI7021_STRUCT *si = (SIM_SI7021_STRUCT *)slave;
+
+  if(si->cmd_len == 0)
+  {
+      si->cmd[si->cmd_len++] = byte;
+      switch(byte)
+      {
+        case 0xF5:
+          // the conversion measures RH, and T to compensate it
+          si->rh_result = si->rh_code;
+          si->t_result = si->t_code;
+          si->conv_done = sim_time + si->conv_cycles;
+          si->result = true;
+          si->conversions++;
+          return true;
+        case 0xFE:
+          si->reg1 = 0x3A;
+          si->result = false;
+          return true;
+        case 0xE0:
+        case 0xE6:
+        case 0xE7:
+        case 0xFA:
+        case 0xFC:
+        case 0x84:
+          return true;
+        default:
+          si->bad_cmds++;
+          return false;
+      }
+  }
+
+  // second byte: the user register 1 value, or the second identity command byte
+  if(si->cmd_len == 1)
+  {
+      si->cmd[si->cmd_len++] = byte;
+      if(si->cmd[0] == 0xE6)
+      {
+          si->reg1 = byte;
+      }
+      return true;
+  }
+  si->bad_cmds++;
+  return false;
+}
+
+static uint8_t sim_si7021_read(SIM_SLAVE_STRUCT *slave)
+{
+  SIM_SI7021_STRUCT *si = (SIM_SI7021_STRUCT *)slave;
+
+  return (si->out_pos < si->out_len) ? si->out[si->out_pos++] : 0xFF;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes a Si7021 slave: a Si7021 with firmware 2.0, powered from
+ *   the supply of its bus
+ ******************************************************************************/
+void sim_si7021_init(SIM_SI7021_STRUCT *si, uint32_t addr, uint32_t bus)
+{
+  memset(si, 0, sizeof(*si));
+  si->slave.addr = addr;
+  si->slave.addr_cb = sim_si7021_addr;
+  si->slave.write_cb = sim_si7021_write;
+  si->slave.read_cb = sim_si7021_read;
+  si->bus = bus;
+  si->reg1 = 0x3A;
+  si->powered_since = SIM_NEVER;
+  si->serial_a = 0x1A2B3C4D;
+  si->serial_b = 0x15FFB0C0;
+  si->fw_rev = 0x20;
+  si->conv_cycles = SIM_MS(5);            // under the driver's wait at every resolution
+  si->powerup_cycles = SIM_MS(18);        // typical at 25 C (DS Table 2)
+}
@@ -0,0 +1,168 @@
+/***************************************************************************//**
+ * @file
+ *   sim.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host simulator of the EFM32PG12 peripherals the drivers use: I2C masters
+ *   with their buses and slaves, LDMA, TIMER1, LETIMER0, GPIO and the NVIC,
+ *   on one virtual time base counted in core cycles
+ ******************************************************************************/
+#ifndef SIM_HG
+#define SIM_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+
+// Silicon Labs included files
+#include "em_device.h"
+#include "em_gpio.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define SIM_CORE_HZ           32000000UL            // HFRCO band main() selects; core and HFPER clock
+#define SIM_IRQ_ENTRY_CYCLES  12                    // Cortex-M4 exception entry (stacking)
+#define SIM_IRQ_EXIT_CYCLES   12                    // Cortex-M4 exception return (unstacking)
+#define SIM_NEVER             UINT64_MAX            // no event scheduled
+#define SIM_HOLD_FOREVER      UINT32_MAX            // SDA hold released by no number of clocks
+#define SIM_US(us)            ((uint64_t)(us) * (SIM_CORE_HZ / 1000000))   // microseconds -> cycles
+#define SIM_MS(ms)            ((uint64_t)(ms) * (SIM_CORE_HZ / 1000))      // milliseconds -> cycles
+#define SIM_IRQ_COUNT         64                    // NVIC lines tracked
+#define SIM_SLAVE_LOG         64                    // bytes kept by the memory slave logs
+#define SIM_SI7021_OUT        8                     // longest Si7021 response (SNA with its checksums)
+#define SIM_LETIMER_SYNC_TICKS 3                    // LFCLK cycles a LETIMER compare write takes to reach the counter
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+// a slave on a simulated bus. Callbacks run as the byte completes on the
+// bus; any of them may be NULL
+typedef struct SIM_SLAVE
+{
+    uint32_t                      addr;                   // 7-bit address
+    bool                        (*addr_cb)(struct SIM_SLAVE *slave, bool read); // (repeated) START + address; true to ACK
+    bool                        (*write_cb)(struct SIM_SLAVE *slave, uint8_t byte); // byte from the master; true to ACK
+    uint8_t                     (*read_cb)(struct SIM_SLAVE *slave); // next byte to the master
+    void                        (*ack_cb)(struct SIM_SLAVE *slave, bool ack); // master ACK (true) or NACK of the byte read
+    void                        (*stop_cb)(struct SIM_SLAVE *slave); // STOP, or the bus reset
+    uint32_t                      sda_hold;               // SCL rising edges SDA stays held low for (SIM_HOLD_FOREVER)
+    uint64_t                      scl_hold_until;         // SCL held low (stretched) until this time (SIM_NEVER: stuck)
+    struct SIM_SLAVE             *next;                   // next slave on the bus
+}SIM_SLAVE_STRUCT;
+
+
+// register file slave: the first byte written after START sets the register
+// pointer, further bytes are stored and reads return mem[ptr++]
+typedef struct
+{
+    SIM_SLAVE_STRUCT              slave;                  // must stay first
+    uint8_t                       mem[256];               // register file
+    uint8_t                       ptr;                    // register pointer
+    bool                          ptr_next;               // the next byte written sets the pointer
+    uint32_t                      nack_addr;              // address bytes still to NACK
+    uint32_t                      nack_byte;              // NACK the nth byte written after START (0: never)
+    uint32_t                      stretch_byte;           // stretch SCL after the nth byte written after START (0: never)
+    uint64_t                      stretch_cycles;         // length of that stretch
+    uint32_t                      written;                // bytes written since START
+    bool                          read_nacked;            // the master NACKed the last byte read
+    uint32_t                      read_run;               // bytes read since the read address
+    uint32_t                      addr_acks;              // address bytes ACKed
+    uint32_t                      addr_nacks;             // address bytes NACKed
+    uint32_t                      writes;                 // data bytes received
+    uint32_t                      reads;                  // data bytes sent
+    uint32_t                      master_acks;            // bytes the master ACKed
+    uint32_t                      master_nacks;           // bytes the master NACKed
+    uint32_t                      last_run;               // read_run when the master last NACKed
+    uint32_t                      reads_after_nack;       // bytes clocked out after the master's NACK; must stay 0
+    uint32_t                      stops;                  // STOPs seen
+}SIM_MEM_STRUCT;
+
+
+// Si7021 slave: No Hold Master Mode RH conversions and the temperature read
+// from them, user register 1, reset and the identity reads, with checksums
+// (Si7021-A20 DS 5). Addressing for a read NACKs while a conversion runs
+typedef struct
+{
+    SIM_SLAVE_STRUCT              slave;                  // must stay first
+    uint32_t                      bus;                    // bus whose supply powers the sensor
+    uint16_t                      rh_code;                // RH code the next conversion returns
+    uint16_t                      t_code;                 // T code the next conversion captures
+    uint64_t                      conv_cycles;            // conversion time
+    uint64_t                      powerup_cycles;         // power-up time; addressing NACKs until it has elapsed
+    uint32_t                      serial_a;               // SNA_3..SNA_0
+    uint32_t                      serial_b;               // SNB_3..SNB_0; SNB_3 is the device identification
+    uint8_t                       fw_rev;                 // firmware revision
+    uint8_t                       reg1;                   // user register 1
+    uint8_t                       cmd[2];                 // command bytes written since the write address
+    uint32_t                      cmd_len;
+    uint8_t                       out[SIM_SI7021_OUT];    // response of the read addressed last
+    uint32_t                      out_len;
+    uint32_t                      out_pos;
+    bool                          result;                 // a conversion result is held
+    uint16_t                      rh_result;              // RH code of the last conversion
+    uint16_t                      t_result;               // T code captured by the last conversion
+    uint64_t                      conv_done;              // time the last conversion completes
+    uint64_t                      powered_since;          // supply power-up the sensor last reset at
+    uint32_t                      conversions;            // conversions started
+    uint32_t                      early_reads;            // read addresses NACKed during a conversion
+    uint32_t                      bad_cmds;               // commands NACKed as unknown
+    uint32_t                      addr_acks;              // address bytes ACKed
+    uint8_t                       id_crc_xor;             // fault: flips these bits of the last checksum of each identity read
+}SIM_SI7021_STRUCT;
+
+
+// host time spent in the handler of one interrupt line
+typedef struct
+{
+    uint32_t                      count;                  // handler runs
+    uint64_t                      total_ns;               // host time in the handler
+    uint64_t                      max_ns;                 // longest handler run
+}SIM_IRQ_STATS_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+// time base and interrupt dispatch
+void sim_init(void);
+uint64_t sim_now(void);
+bool sim_step(uint64_t deadline);
+void sim_run(uint64_t cycles);
+bool sim_run_while(bool (*busy)(void *arg), void *arg, uint64_t cycles);
+void sim_irq_stats(IRQn_Type irqn, SIM_IRQ_STATS_STRUCT *stats, bool reset);
+uint64_t sim_em_cycles(uint32_t em);
+uint32_t sim_em_entries(uint32_t em);
+void sim_fail(const char *fmt, ...);
+void sim_pause(bool paused);
+
+// buses and slaves
+void sim_bus_pins(uint32_t bus, GPIO_Port_TypeDef sda_port, uint32_t sda_pin,
+                  GPIO_Port_TypeDef scl_port, uint32_t scl_pin);
+void sim_bus_power_pin(uint32_t bus, GPIO_Port_TypeDef port, uint32_t pin);
+bool sim_bus_powered(uint32_t bus, uint64_t *since);
+uint32_t sim_bus_power_ups(uint32_t bus);
+void sim_bus_attach(uint32_t bus, SIM_SLAVE_STRUCT *slave);
+uint32_t sim_bus_bit_cycles(uint32_t bus);
+bool sim_bus_idle(uint32_t bus);
+void sim_mem_init(SIM_MEM_STRUCT *mem, uint32_t addr);
+void sim_si7021_init(SIM_SI7021_STRUCT *si, uint32_t addr, uint32_t bus);
+
+// LDMA
+void sim_ldma_irq_delay(uint64_t cycles);
+
+// LETIMER
+void sim_letimer_sync_ticks(uint64_t ticks);
+void sim_letimer_hold(uint64_t cycles);
+uint32_t sim_letimer_writes(uint32_t comp);
+
+#endif
@@ -0,0 +1,18 @@
+/***************************************************************************//**
+ * @file
+ *   em_assert.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host stand-in for emlib em_assert.h: a failed assert stops the test
+ ******************************************************************************/
+#ifndef EM_ASSERT_H
+#define EM_ASSERT_H
+
+void sim_assert_fail(const char *file, int line);
+
+#define EFM_ASSERT(expr)  ((expr) ? (void)0 : sim_assert_fail(__FILE__, __LINE__))
+
+#endif
@@ -0,0 +1,18 @@
+/***************************************************************************//**
+ * @file
+ *   em_chip.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host stand-in for emlib em_chip.h
+ ******************************************************************************/
+#ifndef EM_CHIP_H
+#define EM_CHIP_H
+
+#include "em_device.h"
+
+void CHIP_Init(void);
+
+#endif
@@ -0,0 +1,37 @@
+/***************************************************************************//**
+ * @file
+ *   em_cmu.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host stand-in for emlib em_cmu.h
+ ******************************************************************************/
+#ifndef EM_CMU_H
+#define EM_CMU_H
+
+#include "em_device.h"
+
+typedef enum
+{
+  cmuClock_HF, cmuClock_CORE, cmuClock_HFPER, cmuClock_CORELE, cmuClock_LFA,
+  cmuClock_GPIO, cmuClock_I2C0, cmuClock_I2C1, cmuClock_LDMA, cmuClock_LETIMER0,
+  cmuClock_TIMER0, cmuClock_TIMER1,
+}CMU_Clock_TypeDef;
+
+typedef enum { cmuOsc_LFXO, cmuOsc_LFRCO, cmuOsc_ULFRCO, cmuOsc_HFXO, cmuOsc_HFRCO }CMU_Osc_TypeDef;
+typedef enum { cmuSelect_ULFRCO, cmuSelect_LFRCO, cmuSelect_LFXO, cmuSelect_HFRCO, cmuSelect_HFXO }CMU_Select_TypeDef;
+typedef enum { cmuHFRCOFreq_19M0Hz, cmuHFRCOFreq_32M0Hz }CMU_HFRCOFreq_TypeDef;
+
+typedef struct { uint32_t ctuneStartup; }CMU_HFXOInit_TypeDef;
+#define CMU_HFXOINIT_DEFAULT  { 0 }
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable);
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock);
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref);
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait);
+void CMU_HFXOInit(const CMU_HFXOInit_TypeDef *hfxoInit);
+void CMU_HFRCOBandSet(CMU_HFRCOFreq_TypeDef setFreq);
+
+#endif
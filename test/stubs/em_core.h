@@ -0,0 +1,25 @@
+/***************************************************************************//**
+ * @file
+ *   em_core.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host stand-in for emlib em_core.h: critical sections mask the simulated interrupts
+ ******************************************************************************/
+#ifndef EM_CORE_H
+#define EM_CORE_H
+
+#include "em_device.h"
+
+typedef uint32_t CORE_irqState_t;
+
+CORE_irqState_t sim_core_enter(void);
+void sim_core_exit(CORE_irqState_t state);
+
+#define CORE_DECLARE_IRQ_STATE    CORE_irqState_t irqState
+#define CORE_ENTER_CRITICAL()     irqState = sim_core_enter()
+#define CORE_EXIT_CRITICAL()      sim_core_exit(irqState)
+
+#endif
@@ -0,0 +1,298 @@
+/***************************************************************************//**
+ * @file
+ *   em_device.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host stand-in for the EFM32PG12 device header: register blocks of the
+ *   peripherals the drivers touch, backed by the simulator in test/sim
+ ******************************************************************************/
+#ifndef EM_DEVICE_H
+#define EM_DEVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define __IOM volatile
+#define __IM  volatile const
+#define __OM  volatile
+
+
+//***********************************************************************************
+// interrupts
+//***********************************************************************************
+typedef enum
+{
+  LDMA_IRQn       = 8,
+  GPIO_EVEN_IRQn  = 10,
+  TIMER0_IRQn     = 11,
+  TIMER1_IRQn     = 12,
+  I2C0_IRQn       = 17,
+  GPIO_ODD_IRQn   = 18,
+  LETIMER0_IRQn   = 26,
+  I2C1_IRQn       = 42,
+}IRQn_Type;
+
+void NVIC_EnableIRQ(IRQn_Type irqn);
+void NVIC_DisableIRQ(IRQn_Type irqn);
+void NVIC_ClearPendingIRQ(IRQn_Type irqn);
+void NVIC_SetPendingIRQ(IRQn_Type irqn);
+
+
+//***********************************************************************************
+// core
+//***********************************************************************************
+static inline uint8_t __CLZ(uint32_t value) { return value ? (uint8_t)__builtin_clz(value) : 32; }
+static inline void __DMB(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+typedef struct
+{
+  __IOM uint32_t CTRL;
+  __IOM uint32_t CYCCNT;
+}DWT_Type;
+
+typedef struct
+{
+  __IOM uint32_t DEMCR;
+}CoreDebug_Type;
+
+// every DWT access advances simulated time by one core cycle and lets the
+// simulated peripherals catch up, so bounded busy waits make progress
+DWT_Type *sim_dwt(void);
+extern CoreDebug_Type sim_coredebug;
+#define DWT                         (sim_dwt())
+#define CoreDebug                   (&sim_coredebug)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk      1UL
+
+
+//***********************************************************************************
+// I2C
+//***********************************************************************************
+// IFS shares IF: i2c_open() reads the START flag back straight after setting it
+typedef struct
+{
+  __IOM uint32_t CTRL;
+  __IOM uint32_t CMD;
+  __IM  uint32_t STATE;
+  __IM  uint32_t STATUS;
+  __IOM uint32_t CLKDIV;
+  __IOM uint32_t SADDR;
+  __IOM uint32_t SADDRMASK;
+  __IM  uint32_t RXDATA;
+  __IM  uint32_t RXDOUBLE;
+  __IM  uint32_t RXDATAP;
+  __IM  uint32_t RXDOUBLEP;
+  __IOM uint32_t TXDATA;
+  __IOM uint32_t TXDOUBLE;
+  union
+  {
+    __IM  uint32_t IF;
+    __IOM uint32_t IFS;
+  };
+  __IOM uint32_t IFC;
+  __IOM uint32_t IEN;
+  __IOM uint32_t ROUTEPEN;
+  __IOM uint32_t ROUTELOC0;
+}I2C_TypeDef;
+
+extern I2C_TypeDef sim_i2c_regs[2];
+#define I2C0        (&sim_i2c_regs[0])
+#define I2C1        (&sim_i2c_regs[1])
+#define I2C_COUNT   2
+
+#define I2C_IF_START                0x1UL
+#define I2C_IF_RSTART               0x2UL
+#define I2C_IF_ADDR                 0x4UL
+#define I2C_IF_TXC                  0x8UL
+#define I2C_IF_TXBL                 0x10UL
+#define I2C_IF_RXDATAV              0x20UL
+#define I2C_IF_ACK                  0x40UL
+#define I2C_IF_NACK                 0x80UL
+#define I2C_IF_MSTOP                0x100UL
+#define I2C_IF_ARBLOST              0x200UL
+#define I2C_IF_BUSERR               0x400UL
+#define I2C_IF_BUSHOLD              0x800UL
+#define I2C_IF_TXOF                 0x1000UL
+#define I2C_IF_RXUF                 0x2000UL
+#define I2C_IF_BITO                 0x4000UL
+#define I2C_IF_CLTO                 0x8000UL
+#define I2C_IFS_START               I2C_IF_START
+#define I2C_IFC_START               I2C_IF_START
+#define I2C_IFC_ACK                 I2C_IF_ACK
+#define I2C_IFC_MSTOP               I2C_IF_MSTOP
+#define I2C_IEN_ACK                 I2C_IF_ACK
+#define I2C_IEN_NACK                I2C_IF_NACK
+#define I2C_IEN_MSTOP               I2C_IF_MSTOP
+#define I2C_IEN_RXDATAV             I2C_IF_RXDATAV
+#define I2C_IEN_TXC                 I2C_IF_TXC
+#define I2C_IEN_ARBLOST             I2C_IF_ARBLOST
+#define I2C_IEN_BUSERR              I2C_IF_BUSERR
+#define I2C_IEN_CLTO                I2C_IF_CLTO
+#define _I2C_IFC_MASK               0x7FFFFUL
+#define _I2C_IF_MASK                0x7FFFFUL
+#define _I2C_IEN_RESETVALUE         0UL
+
+#define I2C_CMD_START               0x1UL
+#define I2C_CMD_STOP                0x2UL
+#define I2C_CMD_ACK                 0x4UL
+#define I2C_CMD_NACK                0x8UL
+#define I2C_CMD_CONT                0x10UL
+#define I2C_CMD_ABORT               0x20UL
+#define I2C_CMD_CLEARTX             0x40UL
+#define I2C_CMD_CLEARPC             0x80UL
+
+#define I2C_STATE_BUSY              0x1UL
+#define I2C_STATE_BUSHOLD           0x10UL
+#define _I2C_STATE_STATE_MASK       0xE0UL
+#define I2C_STATE_STATE_IDLE        0x0UL
+
+#define I2C_STATUS_TXC              0x40UL
+#define I2C_STATUS_TXBL             0x80UL
+#define I2C_STATUS_RXDATAV          0x100UL
+
+#define I2C_CTRL_EN                 0x1UL
+#define I2C_CTRL_AUTOACK            0x4UL
+#define I2C_CTRL_AUTOSE             0x8UL
+#define I2C_CTRL_AUTOSN             0x10UL
+#define _I2C_CTRL_CLHR_SHIFT        8
+#define _I2C_CTRL_CLHR_MASK         0x300UL
+#define _I2C_CTRL_CLTO_SHIFT        16
+#define _I2C_CTRL_CLTO_MASK         0x70000UL
+#define I2C_CTRL_CLTO_OFF           (0x0UL << _I2C_CTRL_CLTO_SHIFT)
+#define I2C_CTRL_CLTO_40PCC         (0x1UL << _I2C_CTRL_CLTO_SHIFT)
+#define I2C_CTRL_CLTO_80PCC         (0x2UL << _I2C_CTRL_CLTO_SHIFT)
+#define I2C_CTRL_CLTO_160PCC        (0x3UL << _I2C_CTRL_CLTO_SHIFT)
+#define I2C_CTRL_CLTO_320PCC        (0x4UL << _I2C_CTRL_CLTO_SHIFT)
+#define I2C_CTRL_CLTO_1024PCC       (0x5UL << _I2C_CTRL_CLTO_SHIFT)
+#define _I2C_CLKDIV_DIV_MASK        0x1FFUL
+
+#define I2C_ROUTEPEN_SDAPEN         0x1UL
+#define I2C_ROUTEPEN_SCLPEN         0x2UL
+#define I2C_ROUTELOC0_SDALOC_LOC15  15UL
+#define I2C_ROUTELOC0_SCLLOC_LOC15  (15UL << 8)
+#define I2C_ROUTELOC0_SDALOC_LOC19  19UL
+#define I2C_ROUTELOC0_SCLLOC_LOC19  (19UL << 8)
+
+
+//***********************************************************************************
+// LDMA
+//***********************************************************************************
+typedef struct
+{
+  __IOM uint32_t CTRL;
+  __IOM uint32_t CHEN;
+  __IM  uint32_t CHBUSY;
+  __IOM uint32_t CHDONE;
+  __IM  uint32_t IF;
+  __IOM uint32_t IFS;
+  __IOM uint32_t IFC;
+  __IOM uint32_t IEN;
+}LDMA_TypeDef;
+
+extern LDMA_TypeDef sim_ldma_regs;
+#define LDMA                (&sim_ldma_regs)
+#define DMA_CHAN_COUNT      8
+#define LDMA_IF_ERROR       0x80000000UL
+#define _LDMA_IF_DONE_MASK  0xFFUL
+
+
+//***********************************************************************************
+// TIMER
+//***********************************************************************************
+typedef struct
+{
+  __IOM uint32_t CTRL;
+  __IOM uint32_t CCV;
+}TIMER_CC_TypeDef;
+
+typedef struct
+{
+  __IOM uint32_t CTRL;
+  __IOM uint32_t CMD;
+  __IM  uint32_t STATUS;
+  __IM  uint32_t IF;
+  __IOM uint32_t IFS;
+  __IOM uint32_t IFC;
+  __IOM uint32_t IEN;
+  __IOM uint32_t TOP;
+  __IOM uint32_t CNT;
+  TIMER_CC_TypeDef CC[4];
+}TIMER_TypeDef;
+
+extern TIMER_TypeDef sim_timer_regs[2];
+#define TIMER0              (&sim_timer_regs[0])
+#define TIMER1              (&sim_timer_regs[1])
+#define TIMER_IF_OF         0x1UL
+#define TIMER_IF_CC0        0x10UL
+#define TIMER_IEN_CC0       0x10UL
+#define _TIMER_IFC_MASK     0xFF7UL
+
+
+//***********************************************************************************
+// LETIMER
+//***********************************************************************************
+typedef struct
+{
+  __IOM uint32_t CTRL;
+  __IOM uint32_t CMD;
+  __IM  uint32_t STATUS;
+  __IOM uint32_t CNT;
+  __IOM uint32_t COMP0;
+  __IOM uint32_t COMP1;
+  __IOM uint32_t REP0;
+  __IOM uint32_t REP1;
+  __IM  uint32_t IF;
+  __IOM uint32_t IFS;
+  __IOM uint32_t IFC;
+  __IOM uint32_t IEN;
+  __IM  uint32_t SYNCBUSY;
+  __IOM uint32_t ROUTEPEN;
+  __IOM uint32_t ROUTELOC0;
+}LETIMER_TypeDef;
+
+// every LETIMER0 access lets the simulated peripherals catch up, so flag
+// clears are seen straight away and CNT reads the current count
+LETIMER_TypeDef *sim_letimer(void);
+extern LETIMER_TypeDef sim_letimer_regs;
+#define LETIMER0                  (sim_letimer())
+#define LETIMER_CTRL_COMP0TOP     (1UL << 9)
+#define LETIMER_CMD_START         1UL
+#define LETIMER_CMD_STOP          2UL
+#define LETIMER_CMD_CLEAR         4UL
+#define LETIMER_STATUS_RUNNING    1UL
+#define LETIMER_IF_COMP0          1UL
+#define LETIMER_IF_COMP1          2UL
+#define LETIMER_IF_UF             4UL
+#define LETIMER_IFS_COMP0         1UL
+#define LETIMER_IFS_COMP1         2UL
+#define LETIMER_IFS_UF            4UL
+#define LETIMER_IEN_COMP0         1UL
+#define LETIMER_IEN_COMP1         2UL
+#define LETIMER_IEN_UF            4UL
+#define _LETIMER_IEN_COMP1_MASK   2UL
+#define _LETIMER_IEN_UF_MASK      4UL
+#define _LETIMER_IFC_RESETVALUE   0UL
+#define _LETIMER_IFC_MASK         0x1FUL
+#define _LETIMER_CNT_MASK         0xFFFFUL
+
+
+//***********************************************************************************
+// GPIO
+//***********************************************************************************
+typedef struct
+{
+  __IM  uint32_t IF;
+  __IOM uint32_t IFS;
+  __IOM uint32_t IFC;
+  __IOM uint32_t IEN;
+}GPIO_TypeDef;
+
+extern GPIO_TypeDef sim_gpio_regs;
+#define GPIO                  (&sim_gpio_regs)
+#define _GPIO_IFC_RESETVALUE  0UL
+
+#endif
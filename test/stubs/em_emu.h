@@ -0,0 +1,33 @@
+/***************************************************************************//**
+ * @file
+ *   em_emu.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host stand-in for emlib em_emu.h: sleeping runs the simulator to the next interrupt
+ ******************************************************************************/
+#ifndef EM_EMU_H
+#define EM_EMU_H
+
+#include "em_device.h"
+
+typedef struct { uint32_t dcdcMode; }EMU_DCDCInit_TypeDef;
+#define EMU_DCDCINIT_DEFAULT  { 0 }
+
+typedef enum { emuVScaleEM23_FastWakeup, emuVScaleEM23_LowPower }EMU_VScaleEM23_TypeDef;
+typedef struct
+{
+  bool                    em23VregFullEn;
+  EMU_VScaleEM23_TypeDef  vScaleEM23Voltage;
+}EMU_EM23Init_TypeDef;
+#define EMU_EM23INIT_DEFAULT  { false, emuVScaleEM23_FastWakeup }
+
+void EMU_EnterEM1(void);
+void EMU_EnterEM2(bool restore);
+void EMU_EnterEM3(bool restore);
+bool EMU_DCDCInit(const EMU_DCDCInit_TypeDef *dcdcInit);
+void EMU_EM23Init(const EMU_EM23Init_TypeDef *em23Init);
+
+#endif
@@ -0,0 +1,39 @@
+/***************************************************************************//**
+ * @file
+ *   em_gpio.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host stand-in for emlib em_gpio.h
+ ******************************************************************************/
+#ifndef EM_GPIO_H
+#define EM_GPIO_H
+
+#include "em_device.h"
+
+typedef enum { gpioPortA, gpioPortB, gpioPortC, gpioPortD, gpioPortF = 5 }GPIO_Port_TypeDef;
+typedef enum
+{
+  gpioModeDisabled, gpioModeInput, gpioModeInputPull, gpioModePushPull,
+  gpioModeWiredAnd, gpioModeWiredAndPullUp,
+}GPIO_Mode_TypeDef;
+typedef enum
+{
+  gpioDriveStrengthStrongAlternateStrong, gpioDriveStrengthWeakAlternateStrong,
+  gpioDriveStrengthStrongAlternateWeak, gpioDriveStrengthWeakAlternateWeak,
+}GPIO_DriveStrength_TypeDef;
+#define gpioDriveStrengthStrong   gpioDriveStrengthStrongAlternateStrong
+#define gpioDriveStrengthWeak     gpioDriveStrengthWeakAlternateWeak
+
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out);
+void GPIO_DriveStrengthSet(GPIO_Port_TypeDef port, GPIO_DriveStrength_TypeDef strength);
+void GPIO_PinOutSet(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_PinOutToggle(GPIO_Port_TypeDef port, unsigned int pin);
+unsigned int GPIO_PinInGet(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_ExtIntConfig(GPIO_Port_TypeDef port, unsigned int pin, unsigned int intNo,
+                       bool risingEdge, bool fallingEdge, bool enable);
+
+#endif
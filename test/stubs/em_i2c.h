@@ -0,0 +1,40 @@
+/***************************************************************************//**
+ * @file
+ *   em_i2c.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host stand-in for emlib em_i2c.h
+ ******************************************************************************/
+#ifndef EM_I2C_H
+#define EM_I2C_H
+
+#include "em_device.h"
+
+#define I2C_FREQ_STANDARD_MAX   92000
+#define I2C_FREQ_FAST_MAX       392000
+#define I2C_FREQ_FASTPLUS_MAX   987500
+
+typedef enum
+{
+  i2cClockHLRStandard   = 0,  /* 4:4 */
+  i2cClockHLRAsymetric  = 1,  /* 6:3 */
+  i2cClockHLRFast       = 2,  /* 11:6 */
+}I2C_ClockHLR_TypeDef;
+
+typedef struct
+{
+  bool                  enable;
+  bool                  master;
+  uint32_t              refFreq;
+  uint32_t              freq;
+  I2C_ClockHLR_TypeDef  clhr;
+}I2C_Init_TypeDef;
+
+void I2C_Init(I2C_TypeDef *i2c, const I2C_Init_TypeDef *init);
+void I2C_BusFreqSet(I2C_TypeDef *i2c, uint32_t freqRef, uint32_t freqScl, I2C_ClockHLR_TypeDef i2cMode);
+uint32_t I2C_BusFreqGet(I2C_TypeDef *i2c);
+
+#endif
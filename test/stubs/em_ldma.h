@@ -0,0 +1,115 @@
+/***************************************************************************//**
+ * @file
+ *   em_ldma.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host stand-in for emlib em_ldma.h; descriptors keep the emlib field layout
+ ******************************************************************************/
+#ifndef EM_LDMA_H
+#define EM_LDMA_H
+
+#include "em_device.h"
+
+typedef enum
+{
+  ldmaPeripheralSignal_NONE,
+  ldmaPeripheralSignal_I2C0_RXDATAV,
+  ldmaPeripheralSignal_I2C0_TXBL,
+  ldmaPeripheralSignal_I2C1_RXDATAV,
+  ldmaPeripheralSignal_I2C1_TXBL,
+}LDMA_PeripheralSignal_t;
+
+#define ldmaCtrlStructTypeXfer  0
+#define ldmaCtrlStructTypeSync  1
+#define ldmaCtrlStructTypeWrite 2
+
+typedef union
+{
+  struct
+  {
+    uint32_t  structType   : 2;
+    uint32_t  reserved0    : 1;
+    uint32_t  structReq    : 1;
+    uint32_t  xferCnt      : 11;
+    uint32_t  byteSwap     : 1;
+    uint32_t  blockSize    : 4;
+    uint32_t  doneIfs      : 1;
+    uint32_t  reqMode      : 1;
+    uint32_t  decLoopCnt   : 1;
+    uint32_t  ignoreSrec   : 1;
+    uint32_t  srcInc       : 2;
+    uint32_t  size         : 2;
+    uint32_t  dstInc       : 2;
+    uint32_t  srcAddrMode  : 1;
+    uint32_t  dstAddrMode  : 1;
+    uintptr_t srcAddr;
+    uintptr_t dstAddr;
+    uint32_t  linkMode     : 1;
+    uint32_t  link         : 1;
+    int32_t   linkAddr     : 30;
+  }xfer;
+  struct
+  {
+    uint32_t  structType   : 2;
+    uint32_t  reserved0    : 1;
+    uint32_t  structReq    : 1;
+    uint32_t  xferCnt      : 11;
+    uint32_t  byteSwap     : 1;
+    uint32_t  blockSize    : 4;
+    uint32_t  doneIfs      : 1;
+    uint32_t  reqMode      : 1;
+    uint32_t  decLoopCnt   : 1;
+    uint32_t  ignoreSrec   : 1;
+    uint32_t  srcInc       : 2;
+    uint32_t  size         : 2;
+    uint32_t  dstInc       : 2;
+    uint32_t  srcAddrMode  : 1;
+    uint32_t  dstAddrMode  : 1;
+    uint32_t  immVal;
+    uintptr_t dstAddr;
+    uint32_t  linkMode     : 1;
+    uint32_t  link         : 1;
+    int32_t   linkAddr     : 30;
+  }wri;
+}LDMA_Descriptor_t;
+
+typedef struct
+{
+  uint32_t  ldmaReqSel;
+  uint8_t   ldmaCtrlSyncPrsClrOff;
+}LDMA_TransferCfg_t;
+
+typedef struct
+{
+  uint8_t   ldmaInitCtrlNumFixed;
+  uint8_t   ldmaInitCtrlSyncPrsClrEn;
+  uint8_t   ldmaInitCtrlSyncPrsSetEn;
+  uint8_t   ldmaInitIrqPriority;
+}LDMA_Init_t;
+
+#define LDMA_INIT_DEFAULT                   { 0, 0, 0, 3 }
+#define LDMA_TRANSFER_CFG_PERIPHERAL(signal) { (signal), 0 }
+
+// linkAddr counts words, as on the part: one descriptor is four words
+#define LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(src, dest, count)                       \
+  { .xfer = { .structType = ldmaCtrlStructTypeXfer, .xferCnt = (count) - 1,    \
+              .doneIfs = 1, .srcAddr = (uintptr_t)(src), .dstAddr = (uintptr_t)(dest) } }
+#define LDMA_DESCRIPTOR_SINGLE_P2M_BYTE(src, dest, count)                       \
+  { .xfer = { .structType = ldmaCtrlStructTypeXfer, .xferCnt = (count) - 1,    \
+              .doneIfs = 1, .srcAddr = (uintptr_t)(src), .dstAddr = (uintptr_t)(dest) } }
+#define LDMA_DESCRIPTOR_LINKREL_P2M_BYTE(src, dest, count, linkjmp)             \
+  { .xfer = { .structType = ldmaCtrlStructTypeXfer, .xferCnt = (count) - 1,    \
+              .doneIfs = 0, .srcAddr = (uintptr_t)(src), .dstAddr = (uintptr_t)(dest), \
+              .link = 1, .linkAddr = (linkjmp) * 4 } }
+#define LDMA_DESCRIPTOR_SINGLE_WRITE(value, address)                            \
+  { .wri = { .structType = ldmaCtrlStructTypeWrite, .doneIfs = 1,              \
+             .immVal = (value), .dstAddr = (uintptr_t)(address) } }
+
+void LDMA_Init(const LDMA_Init_t *init);
+void LDMA_StartTransfer(int ch, const LDMA_TransferCfg_t *transfer, const LDMA_Descriptor_t *descriptor);
+void LDMA_StopTransfer(int ch);
+
+#endif
@@ -0,0 +1,39 @@
+/***************************************************************************//**
+ * @file
+ *   em_letimer.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host stand-in for emlib em_letimer.h
+ ******************************************************************************/
+#ifndef EM_LETIMER_H
+#define EM_LETIMER_H
+
+#include "em_device.h"
+
+typedef enum { letimerRepeatFree, letimerRepeatOneshot, letimerRepeatBuffered, letimerRepeatDouble }LETIMER_RepeatMode_TypeDef;
+typedef enum { letimerUFOANone, letimerUFOAToggle, letimerUFOAPulse, letimerUFOAPwm }LETIMER_UFOA_TypeDef;
+
+typedef struct
+{
+  bool                        enable;
+  bool                        debugRun;
+  bool                        comp0Top;
+  bool                        bufTop;
+  uint8_t                     out0Pol;
+  uint8_t                     out1Pol;
+  LETIMER_UFOA_TypeDef        ufoa0;
+  LETIMER_UFOA_TypeDef        ufoa1;
+  LETIMER_RepeatMode_TypeDef  repMode;
+  uint32_t                    topValue;
+}LETIMER_Init_TypeDef;
+
+void LETIMER_Init(LETIMER_TypeDef *letimer, const LETIMER_Init_TypeDef *init);
+void LETIMER_CompareSet(LETIMER_TypeDef *letimer, unsigned int comp, uint32_t value);
+void LETIMER_RepeatSet(LETIMER_TypeDef *letimer, unsigned int rep, uint32_t value);
+void LETIMER_Enable(LETIMER_TypeDef *letimer, bool enable);
+uint32_t LETIMER_CounterGet(LETIMER_TypeDef *letimer);
+
+#endif
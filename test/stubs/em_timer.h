@@ -0,0 +1,64 @@
+/***************************************************************************//**
+ * @file
+ *   em_timer.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Host stand-in for emlib em_timer.h
+ ******************************************************************************/
+#ifndef EM_TIMER_H
+#define EM_TIMER_H
+
+#include "em_device.h"
+
+typedef enum
+{
+  timerPrescale1, timerPrescale2, timerPrescale4, timerPrescale8, timerPrescale16,
+  timerPrescale32, timerPrescale64, timerPrescale128, timerPrescale256,
+  timerPrescale512, timerPrescale1024,
+}TIMER_Prescale_TypeDef;
+typedef enum { timerModeUp, timerModeDown, timerModeUpDown, timerModeQDec }TIMER_Mode_TypeDef;
+typedef enum { timerCCModeOff, timerCCModeCapture, timerCCModeCompare, timerCCModePWM }TIMER_CCMode_TypeDef;
+
+typedef struct
+{
+  bool                    enable;
+  bool                    debugRun;
+  TIMER_Prescale_TypeDef  prescale;
+  uint32_t                clkSel;
+  bool                    count2x;
+  bool                    ati;
+  uint32_t                fallAction;
+  uint32_t                riseAction;
+  TIMER_Mode_TypeDef      mode;
+  bool                    dmaClrAct;
+  bool                    quadModeX4;
+  bool                    oneShot;
+  bool                    sync;
+}TIMER_Init_TypeDef;
+#define TIMER_INIT_DEFAULT  { true, false, timerPrescale1, 0, false, false, 0, 0, timerModeUp, false, false, false, false }
+
+typedef struct
+{
+  uint32_t                eventCtrl;
+  uint32_t                edge;
+  uint32_t                prsSel;
+  uint32_t                cufoa;
+  uint32_t                cofoa;
+  uint32_t                cmoa;
+  TIMER_CCMode_TypeDef    mode;
+  bool                    filter;
+  bool                    prsInput;
+  bool                    coist;
+  bool                    outInvert;
+}TIMER_InitCC_TypeDef;
+#define TIMER_INITCC_DEFAULT  { 0, 0, 0, 0, 0, 0, timerCCModeOff, false, false, false, false }
+
+void TIMER_Init(TIMER_TypeDef *timer, const TIMER_Init_TypeDef *init);
+void TIMER_InitCC(TIMER_TypeDef *timer, unsigned int ch, const TIMER_InitCC_TypeDef *init);
+void TIMER_Enable(TIMER_TypeDef *timer, bool enable);
+void TIMER_TopSet(TIMER_TypeDef *timer, uint32_t val);
+
+#endif
@@ -0,0 +1,249 @@
+/***************************************************************************//**
+ * @file
+ *   test_energy_model.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Energy per sample with and without Si7021 power gating, and the sample
+ *   period at which gating starts to pay
+ *
+ * @details
+ *   Two simulated Si7021 run from SENSOR_EN. The test runs the sample cycle
+ *   of app.c both ways: always powered, and powered up APP_POWER_LEAD ahead
+ *   of the sample and down from the first read callback, while the other
+ *   sensor is still busy. It checks that the waiting power-down happens once
+ *   the last sensor goes idle, and measures how long the sensors stay
+ *   powered and how much longer the core is held in EM1 per gated sample.
+ *
+ *   Those times feed a charge model at 3.3 V:
+ *
+ *     always on:  V * (I_sb * T + Q_conv)
+ *     gated:      V * (I_sb * t_on + Q_pu + Q_conv + Q_mcu)
+ *
+ *   so gating pays above T = (Q_pu + Q_mcu) / I_sb + t_on. The power-up
+ *   charge is not specified; the worst case takes the 4 mA peak (DS
+ *   Table 2) for the whole 5 ms, the low case 3.5 mA for 0.2 ms on top of
+ *   the decoupling charge. The crossover at 25 C must agree with the
+ *   "roughly 20-340 s" that app.h gives for leaving the mode off.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "test_util.h"
+#include "app.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define ENERGY_ADDR_2       (SI7021_ADDR + 1)       // second sensor on the bus
+#define ENERGY_CB_2         0x08                    // read callback event of the second sensor
+#define ENERGY_REG1         ((SI7021_REG1_RESET & ~SI7021_REG1_RES_MASK) | APP_SI7021_RES) // user register 1 at APP_SI7021_RES
+#define ENERGY_CYCLES       10                      // sample cycles run per mode
+#define ENERGY_V            3.3                     // supply voltage
+#define ENERGY_I_SB_25C     0.06e-6                 // Si7021 standby current, typical at 25 C (DS Table 2)
+#define ENERGY_I_SB_85C     0.62e-6                 // Si7021 standby current, max at 85 C (DS Table 2)
+#define ENERGY_Q_PU_WORST   (4e-3 * 5e-3)           // power-up charge: 4 mA peak for 5 ms
+#define ENERGY_Q_PU_LOW     (0.33e-6 + (3.5e-3 * 0.2e-3)) // power-up charge: decoupling + 3.5 mA for 0.2 ms
+#define ENERGY_I_CONV       150e-6                  // Si7021 current during a conversion (DS Table 2)
+#define ENERGY_T_CONV       (2.6e-3 + 2.4e-3)       // 8-bit RH + 12-bit T conversion, typical (DS Table 2)
+#define ENERGY_I_EM0        1.33e-3                 // core running at 32 MHz
+#define ENERGY_I_EM1        0.9e-3                  // core asleep in EM1, HF peripherals running
+#define ENERGY_T_CPU        30e-6                   // handler time a gated sample adds: power-up, ready, power-down
+#define ENERGY_PER_25C_LOW  20.0                    // crossover at 25 C app.h quotes, low power-up charge
+#define ENERGY_PER_25C_HIGH 340.0                   // crossover at 25 C app.h quotes, worst power-up charge
+#define ENERGY_PER_TOL      0.1                     // relative tolerance of "roughly"
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+static SIM_SI7021_STRUCT energy_si7021[2];
+static uint32_t energy_sensor[2];
+static uint32_t energy_power_offs;                        // si7021_power_off() calls that waited
+
+// sample periods the energies are reported for, in seconds
+static const double energy_periods[] = { APP_SAMPLE_PER, 30, 300, 3000 };
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+static bool energy_probing(void *arg)
+{
+  (void)arg;
+  return (si7021_identity(energy_sensor[0])->probe == si7021_probe_pending) ||
+         (si7021_identity(energy_sensor[1])->probe == si7021_probe_pending);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Runs a sample through the main loop of main(): the read callbacks
+ *   of both sensors, then sleep until the sensors and the power-down are
+ *   done
+ ******************************************************************************/
+static void energy_sample(bool gated)
+{
+  uint32_t pending = SI7021_HUM_READ_CB | ENERGY_CB_2;
+  uint64_t deadline = sim_now() + SIM_MS(1000);
+
+  si7021_sample_all();
+  while(pending || (current_block_energy_mode() != EM4))
+  {
+      uint32_t events = get_scheduled_events() & pending;
+      if(events)
+      {
+          // the hum read callback of app.c: power down once every sensor is idle
+          remove_scheduled_event(events);
+          pending &= ~events;
+          if(gated && !si7021_power_off())
+          {
+              energy_power_offs++;
+          }
+          continue;
+      }
+      TEST_CHECK(sim_now() < deadline);
+
+      // EM1 while the bus or TIMER1 runs; otherwise nothing to wait for but the simulator
+      CORE_DECLARE_IRQ_STATE;
+      CORE_ENTER_CRITICAL();
+      if(current_block_energy_mode() == EM2)
+      {
+          enter_sleep();
+      }
+      CORE_EXIT_CRITICAL();
+      if(current_block_energy_mode() != EM2)
+      {
+          sim_step(deadline);
+      }
+  }
+  TEST_CHECK(si7021_status(energy_sensor[0]) == si7021_status_ok);
+  TEST_CHECK(si7021_status(energy_sensor[1]) == si7021_status_ok);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Energy per sample, in joules
+ ******************************************************************************/
+static double energy_on(double period, double i_sb)
+{
+  return ENERGY_V * ((i_sb * period) + (ENERGY_I_CONV * ENERGY_T_CONV));
+}
+
+static double energy_gated(double t_on, double q_pu, double q_mcu, double i_sb)
+{
+  return ENERGY_V * ((i_sb * t_on) + q_pu + (ENERGY_I_CONV * ENERGY_T_CONV) + q_mcu);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sample period above which gating takes less energy, in seconds
+ ******************************************************************************/
+static double energy_crossover(double t_on, double q_pu, double q_mcu, double i_sb)
+{
+  return ((q_pu + q_mcu) / i_sb) + t_on;
+}
+
+
+int main(void)
+{
+  sim_init();
+  cmu_open();
+  scheduler_open();
+
+  // both sensors and the pull-ups run from SENSOR_EN, as on the board
+  GPIO_PinModeSet(SI7021_SENSOR_EN_PORT, SI7021_SENSOR_EN_PIN, gpioModePushPull, 0);
+  sim_bus_power_pin(0, SI7021_SENSOR_EN_PORT, SI7021_SENSOR_EN_PIN);
+  sim_si7021_init(&energy_si7021[0], SI7021_ADDR, 0);
+  sim_si7021_init(&energy_si7021[1], ENERGY_ADDR_2, 0);
+  sim_bus_attach(0, &energy_si7021[0].slave);
+  sim_bus_attach(0, &energy_si7021[1].slave);
+  GPIO_PinModeSet(gpioPortC, 11, gpioModeWiredAnd, 1);
+  GPIO_PinModeSet(gpioPortC, 10, gpioModeWiredAnd, 1);
+
+  // boot as app_peripheral_setup() does
+  si7021_power_on(true);
+  si7021_i2c_open(I2C0);
+  energy_sensor[0] = si7021_register(I2C0, SI7021_ADDR, SI7021_HUM_READ_CB);
+  energy_sensor[1] = si7021_register(I2C0, ENERGY_ADDR_2, ENERGY_CB_2);
+  si7021_set_resolution(energy_sensor[0], APP_SI7021_RES, 0);
+  si7021_set_resolution(energy_sensor[1], APP_SI7021_RES, 0);
+  TEST_CHECK(sim_run_while(energy_probing, NULL, SIM_MS(1000)));
+  energy_sample(false);
+
+  // always powered: EM1 time per sample
+  uint64_t em1 = sim_em_cycles(EM1);
+  for(uint32_t n = 0; n < ENERGY_CYCLES; n++)
+  {
+      energy_sample(false);
+      TEST_CHECK(sim_bus_powered(0, NULL));
+  }
+  uint64_t em1_on = (sim_em_cycles(EM1) - em1) / ENERGY_CYCLES;
+
+  // gated: powered up a lead ahead of the sample, down from the first read callback
+  uint32_t power_ups = sim_bus_power_ups(0);
+  uint64_t powered = 0;
+  em1 = sim_em_cycles(EM1);
+  TEST_CHECK(si7021_power_off());
+  for(uint32_t n = 0; n < ENERGY_CYCLES; n++)
+  {
+      uint64_t since;
+
+      TEST_CHECK(!sim_bus_powered(0, NULL));
+      si7021_power_on(false);
+      sim_run(SIM_US(APP_POWER_LEAD * 1000000));
+      si7021_power_ready();
+      energy_sample(true);
+
+      // the second sensor was still busy at the first callback: the
+      // power-down waited for it
+      TEST_CHECK(!sim_bus_powered(0, NULL));
+      sim_bus_powered(0, &since);
+      powered += sim_now() - since;
+  }
+  uint64_t em1_gated = (sim_em_cycles(EM1) - em1) / ENERGY_CYCLES;
+  TEST_CHECK(sim_bus_power_ups(0) == power_ups + ENERGY_CYCLES);
+  TEST_CHECK(energy_power_offs == ENERGY_CYCLES);
+  TEST_CHECK((energy_si7021[0].early_reads == 0) && (energy_si7021[1].early_reads == 0));
+  TEST_CHECK((energy_si7021[0].reg1 == ENERGY_REG1) && (energy_si7021[1].reg1 == ENERGY_REG1));
+
+  // the measured times feed the charge model
+  double t_on = (double)powered / ENERGY_CYCLES / SIM_CORE_HZ;
+  double t_em1 = (em1_gated > em1_on) ? (double)(em1_gated - em1_on) / SIM_CORE_HZ : 0;
+  double q_mcu = (ENERGY_I_EM0 * ENERGY_T_CPU) + (ENERGY_I_EM1 * t_em1);
+  printf("gated sample: powered %.1f ms, EM1 %.1f us longer (%.3f uC of MCU charge)\n",
+         t_on * 1e3, t_em1 * 1e6, q_mcu * 1e6);
+
+  printf("energy per sample, uJ:   always on        gated worst/low\n");
+  printf("  period                25 C    85 C      25 C            85 C\n");
+  for(uint32_t p = 0; p < sizeof(energy_periods) / sizeof(energy_periods[0]); p++)
+  {
+      double period = energy_periods[p];
+      printf("  %6.0f s %12.1f %7.1f %7.1f/%-7.1f %7.1f/%-7.1f\n", period,
+             energy_on(period, ENERGY_I_SB_25C) * 1e6, energy_on(period, ENERGY_I_SB_85C) * 1e6,
+             energy_gated(t_on, ENERGY_Q_PU_WORST, q_mcu, ENERGY_I_SB_25C) * 1e6,
+             energy_gated(t_on, ENERGY_Q_PU_LOW, q_mcu, ENERGY_I_SB_25C) * 1e6,
+             energy_gated(t_on, ENERGY_Q_PU_WORST, q_mcu, ENERGY_I_SB_85C) * 1e6,
+             energy_gated(t_on, ENERGY_Q_PU_LOW, q_mcu, ENERGY_I_SB_85C) * 1e6);
+  }
+
+  double low_25 = energy_crossover(t_on, ENERGY_Q_PU_LOW, q_mcu, ENERGY_I_SB_25C);
+  double worst_25 = energy_crossover(t_on, ENERGY_Q_PU_WORST, q_mcu, ENERGY_I_SB_25C);
+  double low_85 = energy_crossover(t_on, ENERGY_Q_PU_LOW, q_mcu, ENERGY_I_SB_85C);
+  double worst_85 = energy_crossover(t_on, ENERGY_Q_PU_WORST, q_mcu, ENERGY_I_SB_85C);
+  printf("gating pays above %.0f-%.0f s at 25 C, %.0f-%.0f s at 85 C\n", low_25, worst_25, low_85, worst_85);
+
+  // app.h: roughly 20-340 s at 25 C, so off for the 3 s sample period
+  TEST_CHECK((low_25 > ENERGY_PER_25C_LOW * (1 - ENERGY_PER_TOL)) && (low_25 < ENERGY_PER_25C_LOW * (1 + ENERGY_PER_TOL)));
+  TEST_CHECK((worst_25 > ENERGY_PER_25C_HIGH * (1 - ENERGY_PER_TOL)) && (worst_25 < ENERGY_PER_25C_HIGH * (1 + ENERGY_PER_TOL)));
+  TEST_CHECK(APP_SAMPLE_PER < low_25);
+
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,189 @@
+/***************************************************************************//**
+ * @file
+ *   test_i2c_ldma.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   I2C LDMA mode against a register file slave
+ *
+ * @details
+ *   Built with I2C_LDMA_MODE. Runs reads and writes of every length up to
+ *   32 bytes, and the write-then-read shapes, with the LDMA done interrupt
+ *   taken at once, a few bytes late and many bytes late. Checks the data,
+ *   that the slave saw an ACK for every byte read but the last and a NACK
+ *   for the last, that nothing was clocked out after the NACK, and the
+ *   number of I2C and LDMA interrupts per transaction. Late done interrupts
+ *   stay under the clock low timeout, since the master holds SCL low while
+ *   it waits.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include <string.h>
+
+#include "test_util.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define LDMA_MAX_LEN        32                      // longest transfer tested
+#define LDMA_REG            0x40                    // register the transactions start at
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+static SIM_MEM_STRUCT ldma_mem;
+
+// LDMA done interrupt latency: none, a few bytes, most of the clock low timeout
+static const uint64_t ldma_delays[] = { 0, SIM_US(20), SIM_US(200) };
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   Runs one transaction, checks its data and slave-side ACKs, and returns
+ *   the I2C0 and LDMA interrupts it took
+ ******************************************************************************/
+static void ldma_txn(uint32_t tx_len, uint32_t rx_len, bool repeated_start,
+                     uint32_t *i2c_isrs, uint32_t *ldma_isrs)
+{
+  static uint8_t tx[LDMA_MAX_LEN + 1];
+  static uint8_t rx[LDMA_MAX_LEN];
+  static uint8_t seed;
+  SIM_IRQ_STATS_STRUCT stats;
+  I2C_TRANSACTION_STRUCT txn =
+  {
+      .slave_addr = TEST_MEM_ADDR,
+      .tx_buf = tx,
+      .tx_len = tx_len,
+      .rx_buf = rx,
+      .rx_len = rx_len,
+      .repeated_start = repeated_start,
+  };
+
+  // register contents and bytes to write differ every run
+  seed += 17;
+  for(uint32_t i = 0; i < 2 * LDMA_MAX_LEN; i++)
+  {
+      ldma_mem.mem[LDMA_REG + i] = (uint8_t)(seed + (i * 29));
+  }
+  tx[0] = LDMA_REG;
+  for(uint32_t i = 1; i < tx_len; i++)
+  {
+      tx[i] = (uint8_t)(~seed + (i * 11));
+  }
+  memset(rx, 0, sizeof(rx));
+  ldma_mem.ptr = LDMA_REG;
+  ldma_mem.master_acks = 0;
+  ldma_mem.master_nacks = 0;
+  sim_irq_stats(I2C0_IRQn, &stats, true);
+  sim_irq_stats(LDMA_IRQn, &stats, true);
+
+  TEST_CHECK(test_txn_run(I2C0, &txn) == i2c_status_ok);
+
+  // written bytes follow the register pointer; a read continues after them
+  for(uint32_t i = 1; i < tx_len; i++)
+  {
+      TEST_CHECK(ldma_mem.mem[LDMA_REG + i - 1] == tx[i]);
+  }
+  uint32_t rx_at = (tx_len > 1) ? (tx_len - 1) : 0;
+  for(uint32_t i = 0; i < rx_len; i++)
+  {
+      TEST_CHECK(rx[i] == ldma_mem.mem[LDMA_REG + rx_at + i]);
+  }
+
+  // every byte read is ACKed but the last, which is NACKed; nothing after it
+  if(rx_len)
+  {
+      TEST_CHECK(ldma_mem.master_acks == rx_len - 1);
+      TEST_CHECK(ldma_mem.master_nacks == 1);
+      TEST_CHECK(ldma_mem.last_run == rx_len);
+  }
+  TEST_CHECK(ldma_mem.reads_after_nack == 0);
+
+  // the peripheral is back to per-byte operation
+  TEST_CHECK(!(I2C0->CTRL & (I2C_CTRL_AUTOACK | I2C_CTRL_AUTOSE)));
+  TEST_CHECK(I2C0->IEN == I2C_IEN_MASK);
+  TEST_CHECK(sim_bus_idle(0));
+
+  sim_irq_stats(I2C0_IRQn, &stats, true);
+  *i2c_isrs = stats.count;
+  sim_irq_stats(LDMA_IRQn, &stats, true);
+  *ldma_isrs = stats.count;
+}
+
+
+int main(void)
+{
+  uint32_t i2c_isrs;
+  uint32_t ldma_isrs;
+  uint32_t long_i2c_isrs = 0;
+  uint32_t long_ldma_isrs = 0;
+
+  sim_init();
+  cmu_open();
+  sim_mem_init(&ldma_mem, TEST_MEM_ADDR);
+  sim_bus_attach(0, &ldma_mem.slave);
+  test_i2c_open(I2C0, I2C_CLTO);
+
+  for(uint32_t d = 0; d < sizeof(ldma_delays) / sizeof(ldma_delays[0]); d++)
+  {
+      sim_ldma_irq_delay(ldma_delays[d]);
+
+      for(uint32_t len = 1; len <= LDMA_MAX_LEN; len++)
+      {
+          // read: ACK, [LDMA done], RXDATAV for the bytes left to the CPU, MSTOP
+          bool ldma = len >= I2C_LDMA_MIN_BYTES;
+          ldma_txn(0, len, false, &i2c_isrs, &ldma_isrs);
+          TEST_CHECK(i2c_isrs == 2 + (ldma ? I2C_LDMA_RX_CPU_BYTES : len));
+          TEST_CHECK(ldma_isrs == (ldma ? 1 : 0));
+          long_i2c_isrs = i2c_isrs;
+          long_ldma_isrs = ldma_isrs;
+
+          // write (register pointer + len - 1 bytes): ACK of the address,
+          // ACK per byte on the CPU path, MSTOP
+          ldma = (len - 1) >= (I2C_LDMA_MIN_BYTES - 1);
+          ldma_txn(len, 0, false, &i2c_isrs, &ldma_isrs);
+          TEST_CHECK(i2c_isrs == 2 + (ldma ? 0 : len));
+          TEST_CHECK(ldma_isrs == 0);
+      }
+
+      // write, STOP, read: both phases on the LDMA
+      ldma_txn(8, 16, false, &i2c_isrs, &ldma_isrs);
+      TEST_CHECK(i2c_isrs == 2 + 2 + I2C_LDMA_RX_CPU_BYTES);
+      TEST_CHECK(ldma_isrs == 1);
+
+      // write, repeated START, read: the write needs its last ACK, so stays on the CPU
+      ldma_txn(8, 16, true, &i2c_isrs, &ldma_isrs);
+      TEST_CHECK(i2c_isrs == 1 + 8 + 1 + I2C_LDMA_RX_CPU_BYTES + 1);
+      TEST_CHECK(ldma_isrs == 1);
+
+      printf("LDMA done latency %6.1f us: %u byte read %u I2C + %u LDMA interrupts (%u on the CPU path)\n",
+             (double)ldma_delays[d] / (SIM_CORE_HZ / 1e6), LDMA_MAX_LEN, long_i2c_isrs, long_ldma_isrs,
+             LDMA_MAX_LEN + 2);
+  }
+
+  // a NACK while the LDMA feeds a write ends the phase and frees the LDMA
+  I2C_TRANSACTION_STRUCT txn =
+  {
+      .slave_addr = TEST_MEM_ADDR,
+      .tx_buf = (const uint8_t[]){ LDMA_REG, 1, 2, 3, 4, 5, 6, 7 },
+      .tx_len = 8,
+  };
+  ldma_mem.nack_byte = 4;
+  TEST_CHECK(test_txn_run(I2C0, &txn) == i2c_status_nack);
+  TEST_CHECK(!(I2C0->CTRL & (I2C_CTRL_AUTOACK | I2C_CTRL_AUTOSE)));
+  TEST_CHECK(I2C0->IEN == I2C_IEN_MASK);
+  ldma_mem.nack_byte = 0;
+  ldma_txn(8, 8, false, &i2c_isrs, &ldma_isrs);
+
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,191 @@
+/***************************************************************************//**
+ * @file
+ *   test_i2c_queue.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   I2C transaction queue throughput
+ *
+ * @details
+ *   Submits thousands of write-then-read transactions from the main loop,
+ *   sleeping the way main() does whenever the queue is full. Checks that
+ *   every transaction completes in submission order with the right data,
+ *   that the MSTOP interrupt chains queued transactions without bus idle
+ *   time beyond interrupt latency, and that EM2 stays blocked from the first
+ *   submission until the queue drains. Reports the throughput.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "test_util.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define QUEUE_TXNS          10000                   // transactions submitted
+#define QUEUE_POOL          (2 * I2C_QUEUE_DEPTH)   // descriptors in rotation
+#define QUEUE_RX_LEN        2                       // bytes read per transaction
+#define QUEUE_ISRS          6                       // ACK x3, RXDATAV x2, MSTOP
+#define QUEUE_BITS          (10 + 9 + 10 + (QUEUE_RX_LEN * 9) + 1) // S addr, reg, Sr addr, data, P
+#define QUEUE_ISR_SLACK     64                      // simulated cycles a handler may add to the bus time
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+// a transaction descriptor and what it must return
+typedef struct
+{
+    I2C_TRANSACTION_STRUCT        txn;                    // must stay first
+    uint8_t                       reg;                    // register read
+    uint8_t                       rx[QUEUE_RX_LEN];       // bytes read
+    uint32_t                      seq;                    // submission order
+}QUEUE_TXN_STRUCT;
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+static SIM_MEM_STRUCT queue_mem;
+static QUEUE_TXN_STRUCT queue_pool[QUEUE_POOL];
+static uint32_t queue_done;                               // transactions completed
+static uint64_t queue_last_done;                          // time of the last completion
+static uint64_t queue_max_gap;                            // longest time between completions
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   Completion hook: checks order, data and the EM2 block
+ ******************************************************************************/
+static void queue_done_cb(I2C_TRANSACTION_STRUCT *txn)
+{
+  QUEUE_TXN_STRUCT *q = (QUEUE_TXN_STRUCT *)txn;
+  uint64_t now = sim_now();
+
+  TEST_CHECK(txn->status == i2c_status_ok);
+  TEST_CHECK(q->seq == queue_done);
+  for(uint32_t i = 0; i < QUEUE_RX_LEN; i++)
+  {
+      TEST_CHECK(q->rx[i] == (uint8_t)((q->reg + i) ^ 0x5A));
+  }
+
+  // the bus keeps EM2 blocked until the queue drains
+  TEST_CHECK(current_block_energy_mode() == EM2);
+
+  if(queue_done && ((now - queue_last_done) > queue_max_gap))
+  {
+      queue_max_gap = now - queue_last_done;
+  }
+  queue_last_done = now;
+  queue_done++;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Main loop idle: sleep as main() does
+ ******************************************************************************/
+static void queue_sleep(void)
+{
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  enter_sleep();
+  CORE_EXIT_CRITICAL();
+}
+
+
+static bool queue_busy(void *arg)
+{
+  (void)arg;
+  return queue_done < QUEUE_TXNS;
+}
+
+
+int main(void)
+{
+  uint32_t rejected = 0;
+
+  sim_init();
+  cmu_open();
+  sim_mem_init(&queue_mem, TEST_MEM_ADDR);
+  for(uint32_t i = 0; i < sizeof(queue_mem.mem); i++)
+  {
+      queue_mem.mem[i] = (uint8_t)(i ^ 0x5A);
+  }
+  sim_bus_attach(0, &queue_mem.slave);
+  test_i2c_open(I2C0, I2C_CLTO);
+  sim_irq_stats(I2C0_IRQn, &(SIM_IRQ_STATS_STRUCT){0}, true);
+  TEST_CHECK(current_block_energy_mode() == EM4);
+
+  uint64_t host_start = test_host_ns();
+  uint64_t start = sim_now();
+  for(uint32_t seq = 0; seq < QUEUE_TXNS; seq++)
+  {
+      QUEUE_TXN_STRUCT *q = &queue_pool[seq % QUEUE_POOL];
+
+      // a descriptor is reused only once its transaction completed
+      while(q->txn.status == i2c_status_pending)
+      {
+          queue_sleep();
+      }
+
+      q->seq = seq;
+      q->reg = (uint8_t)(seq * 37);
+      q->txn = (I2C_TRANSACTION_STRUCT)
+      {
+          .slave_addr = TEST_MEM_ADDR,
+          .tx_buf = &q->reg,
+          .tx_len = 1,
+          .rx_buf = q->rx,
+          .rx_len = QUEUE_RX_LEN,
+          .repeated_start = true,
+          .done_cb = queue_done_cb,
+      };
+
+      // non-blocking submission; a full queue is reported, never waited on
+      while(!i2c_init_sm(I2C0, &q->txn))
+      {
+          rejected++;
+          queue_sleep();
+      }
+  }
+  TEST_CHECK(sim_run_while(queue_busy, NULL, SIM_MS(1000)));
+  uint64_t cycles = sim_now() - start;
+  uint64_t host_ns = test_host_ns() - host_start;
+
+  // the queue drained and released EM2
+  TEST_CHECK(current_block_energy_mode() == EM4);
+  TEST_CHECK(queue_done == QUEUE_TXNS);
+  TEST_CHECK(queue_mem.reads_after_nack == 0);
+
+  // one run of interrupts per transaction, none spent waiting for the bus
+  SIM_IRQ_STATS_STRUCT stats;
+  sim_irq_stats(I2C0_IRQn, &stats, false);
+  TEST_CHECK(stats.count == QUEUE_TXNS * QUEUE_ISRS);
+
+  // back to back: the bus only idles for interrupt latency between transactions
+  uint64_t ideal = (uint64_t)QUEUE_BITS * sim_bus_bit_cycles(0);
+  uint64_t latency = QUEUE_ISRS * (SIM_IRQ_ENTRY_CYCLES + SIM_IRQ_EXIT_CYCLES + QUEUE_ISR_SLACK);
+  TEST_CHECK(queue_max_gap <= ideal + latency);
+  TEST_CHECK(cycles <= (uint64_t)QUEUE_TXNS * (ideal + latency));
+
+  double seconds = (double)cycles / SIM_CORE_HZ;
+  printf("%u transactions in %.1f ms simulated: %.0f transactions/s, bus %.1f%% busy, "
+         "%u submissions rejected by a full queue (retried after each wake-up)\n",
+         QUEUE_TXNS, seconds * 1000.0, QUEUE_TXNS / seconds,
+         100.0 * (double)ideal * QUEUE_TXNS / (double)cycles, rejected);
+  printf("gap between completions %.2f us max (transaction %.2f us on the bus); "
+         "core in EM1 %.1f%% of the time; host %.0f ns per transaction\n",
+         (double)queue_max_gap / (SIM_CORE_HZ / 1e6), (double)ideal / (SIM_CORE_HZ / 1e6),
+         100.0 * (double)sim_em_cycles(EM1) / (double)cycles, (double)host_ns / QUEUE_TXNS);
+
+  printf("PASS\n");
+  return 0;
+}
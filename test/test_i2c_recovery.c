@@ -0,0 +1,167 @@
+/***************************************************************************//**
+ * @file
+ *   test_i2c_recovery.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   I2C bus recovery and clock low timeout with stuck-low lines injected
+ *
+ * @details
+ *   A slave left mid-byte holds SDA low for a few SCL clocks; a dead slave
+ *   holds SDA or SCL low for good; a slave stretches SCL past the clock low
+ *   timeout in the middle of a write. Every case must return within its
+ *   bound, report the recovery, and leave the bus usable once the slave
+ *   lets go.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "test_util.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define RECOVERY_SDA_CLOCKS     3                   // clocks a slave left mid-byte holds SDA for
+#define RECOVERY_STRETCH        SIM_MS(5)           // SCL stretch injected mid-transaction
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+static SIM_MEM_STRUCT recovery_mem;
+static uint32_t recovery_done;                            // completion hooks run
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+static void recovery_done_cb(I2C_TRANSACTION_STRUCT *txn)
+{
+  (void)txn;
+  recovery_done++;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   A write-then-read that must succeed
+ ******************************************************************************/
+static void recovery_check_bus(void)
+{
+  uint8_t reg = 0x20;
+  uint8_t rx[2];
+  I2C_TRANSACTION_STRUCT txn =
+  {
+      .slave_addr = TEST_MEM_ADDR,
+      .tx_buf = &reg,
+      .tx_len = 1,
+      .rx_buf = rx,
+      .rx_len = sizeof(rx),
+      .repeated_start = true,
+  };
+
+  recovery_mem.mem[0x20] = 0xA5;
+  recovery_mem.mem[0x21] = 0x5A;
+  TEST_CHECK(test_txn_run(I2C0, &txn) == i2c_status_ok);
+  TEST_CHECK((rx[0] == 0xA5) && (rx[1] == 0x5A));
+  TEST_CHECK(sim_bus_idle(0));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Resets the bus the way a sensor power cycle does, and returns how long
+ *   it took in microseconds
+ ******************************************************************************/
+static uint64_t recovery_reset(void)
+{
+  uint64_t start = sim_now();
+
+  i2c_pins_enable(I2C0, false);
+  i2c_pins_enable(I2C0, true);
+  return (sim_now() - start) / (SIM_CORE_HZ / 1000000);
+}
+
+
+int main(void)
+{
+  uint32_t count;
+  uint32_t last_us;
+  uint64_t took_us;
+
+  sim_init();
+  cmu_open();
+  sim_mem_init(&recovery_mem, TEST_MEM_ADDR);
+  sim_bus_attach(0, &recovery_mem.slave);
+
+  // SDA held for a few clocks at open: one recovery frees it
+  recovery_mem.slave.sda_hold = RECOVERY_SDA_CLOCKS;
+  uint64_t start = sim_now();
+  test_i2c_open(I2C0, I2C_CLTO);
+  took_us = (sim_now() - start) / (SIM_CORE_HZ / 1000000);
+  i2c_recovery_get(I2C0, &count, &last_us);
+  TEST_CHECK(recovery_mem.slave.sda_hold == 0);
+  TEST_CHECK(count == 1);
+  TEST_CHECK((last_us >= RECOVERY_SDA_CLOCKS * 2 * I2C_RECOVERY_HALF_US) && (last_us < 200));
+  printf("SDA held %u clocks: open %llu us, %u recovery of %u us\n",
+         RECOVERY_SDA_CLOCKS, (unsigned long long)took_us, count, last_us);
+  recovery_check_bus();
+
+  // SDA stuck for good: recovery, bounded wait for the reset, recovery again
+  recovery_mem.slave.sda_hold = SIM_HOLD_FOREVER;
+  took_us = recovery_reset();
+  i2c_recovery_get(I2C0, &count, &last_us);
+  TEST_CHECK(count == 3);
+  TEST_CHECK(took_us < I2C_RESET_TIMEOUT_US + 2 * 200);
+  printf("SDA stuck: bus reset returned in %llu us after 2 recoveries of %u us\n",
+         (unsigned long long)took_us, last_us);
+  recovery_mem.slave.sda_hold = 0;
+  recovery_check_bus();
+
+  // SCL stuck for good: bounded wait for the reset, one recovery bounded by its stretch limit
+  recovery_mem.slave.scl_hold_until = SIM_NEVER;
+  took_us = recovery_reset();
+  i2c_recovery_get(I2C0, &count, &last_us);
+  TEST_CHECK(count == 4);
+  TEST_CHECK(last_us < I2C_RECOVERY_STRETCH_US + 200);
+  TEST_CHECK(took_us < I2C_RESET_TIMEOUT_US + I2C_RECOVERY_STRETCH_US + 200);
+  printf("SCL stuck: bus reset returned in %llu us after 1 recovery of %u us\n",
+         (unsigned long long)took_us, last_us);
+  recovery_mem.slave.scl_hold_until = 0;
+  recovery_check_bus();
+
+  // SCL stretched past the clock low timeout mid-write: the transaction
+  // fails with a bus error, its hook runs and EM2 is released
+  uint8_t tx[] = { 0x30, 1, 2, 3 };
+  I2C_TRANSACTION_STRUCT txn =
+  {
+      .slave_addr = TEST_MEM_ADDR,
+      .tx_buf = tx,
+      .tx_len = sizeof(tx),
+      .done_cb = recovery_done_cb,
+  };
+  recovery_mem.stretch_byte = 1;
+  recovery_mem.stretch_cycles = RECOVERY_STRETCH;
+  start = sim_now();
+  TEST_CHECK(test_txn_run(I2C0, &txn) == i2c_status_bus_error);
+  took_us = (sim_now() - start) / (SIM_CORE_HZ / 1000000);
+  i2c_recovery_get(I2C0, &count, &last_us);
+  TEST_CHECK(recovery_done == 1);
+  TEST_CHECK(count == 5);
+  TEST_CHECK(current_block_energy_mode() == EM4);
+  TEST_CHECK(took_us < (RECOVERY_STRETCH / (SIM_CORE_HZ / 1000000)));
+  printf("SCL stretched %llu us mid-write: bus error after %llu us (recovery %u us)\n",
+         (unsigned long long)(RECOVERY_STRETCH / (SIM_CORE_HZ / 1000000)), (unsigned long long)took_us, last_us);
+
+  // usable again once the slave lets go
+  recovery_mem.stretch_byte = 0;
+  sim_run(RECOVERY_STRETCH);
+  recovery_check_bus();
+
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,192 @@
+/***************************************************************************//**
+ * @file
+ *   test_i2c_timing.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   I2C interrupt and transaction timing against a register file slave
+ *
+ * @details
+ *   Runs each transaction shape of the state machine many times and checks
+ *   the data, the number of I2C0 interrupts and the bus time, which must be
+ *   the ideal bit count at the configured SCL period plus interrupt latency
+ *   only. Reports the host time spent in the handler per interrupt and the
+ *   simulated time per transaction, and checks the I2C_PERF_COUNTERS
+ *   totals against what the simulator counted.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include <string.h>
+
+#include "test_util.h"
+#include "letimer.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define TIMING_RUNS         2000                    // transactions per shape
+#define TIMING_REG          0x10                    // register the transactions start at
+#define TIMING_ISR_SLACK    64                      // simulated cycles a handler may add to the bus time
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+// one transaction shape and what it must cost
+typedef struct
+{
+    const char                   *name;                   // shape
+    uint32_t                      tx_len;                 // bytes written, register pointer first
+    uint32_t                      rx_len;                 // bytes read
+    bool                          repeated_start;         // repeated START between write and read
+    uint32_t                      isrs;                   // I2C0 interrupts per transaction
+    uint32_t                      bits;                   // SCL periods per transaction
+}TIMING_CASE_STRUCT;
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+// address + ACK is 10 bits with its (repeated) START, a byte 9, STOP 1
+static const TIMING_CASE_STRUCT timing_cases[] =
+{
+    // ACK x5, MSTOP
+    { "write 4",                  4, 0, false, 6, 10 + (4 * 9) + 1 },
+    // ACK, RXDATAV x3, MSTOP
+    { "read 3",                   0, 3, false, 5, 10 + (3 * 9) + 1 },
+    // ACK x2, ACK of the repeated START, RXDATAV x3, MSTOP
+    { "write 1, Sr, read 3",      1, 3, true,  7, 10 + 9 + 10 + (3 * 9) + 1 },
+    // ACK x2, MSTOP, ACK, RXDATAV x2, MSTOP
+    { "write 1, P, S, read 2",    1, 2, false, 7, 10 + 9 + 1 + 10 + (2 * 9) + 1 },
+};
+
+static SIM_MEM_STRUCT timing_mem;
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+int main(void)
+{
+  uint32_t total_isrs = 0;
+  uint32_t total_txns = 0;
+
+  sim_init();
+  cmu_open();
+
+  // the tick time base the transaction times are read from, as app.c opens it
+  letimer_timer_open(LETIMER0, false);
+  letimer_start(LETIMER0, true);
+  sim_mem_init(&timing_mem, TEST_MEM_ADDR);
+  sim_bus_attach(0, &timing_mem.slave);
+  test_i2c_open(I2C0, I2C_CLTO);
+
+  uint32_t bit = sim_bus_bit_cycles(0);
+  printf("SCL period %u cycles (%.1f kHz)\n", bit, (double)SIM_CORE_HZ / bit / 1000.0);
+
+  // bus reset at open is not part of the measurement
+  SIM_IRQ_STATS_STRUCT stats;
+  I2C_PERF_STRUCT perf;
+  sim_irq_stats(I2C0_IRQn, &stats, true);
+  i2c_perf_snapshot(I2C0, &perf, true);
+
+  for(uint32_t c = 0; c < sizeof(timing_cases) / sizeof(timing_cases[0]); c++)
+  {
+      const TIMING_CASE_STRUCT *tc = &timing_cases[c];
+      uint8_t tx[8];
+      uint8_t rx[8];
+      uint64_t bus_min = SIM_NEVER;
+      uint64_t bus_max = 0;
+      uint64_t bus_total = 0;
+      I2C_TRANSACTION_STRUCT txn =
+      {
+          .slave_addr = TEST_MEM_ADDR,
+          .tx_buf = tx,
+          .tx_len = tc->tx_len,
+          .rx_buf = rx,
+          .rx_len = tc->rx_len,
+          .repeated_start = tc->repeated_start,
+      };
+
+      for(uint32_t run = 0; run < TIMING_RUNS; run++)
+      {
+          // fresh register contents every run
+          uint8_t seed = (uint8_t)(run * 7 + c);
+          for(uint32_t i = 0; i < 8; i++)
+          {
+              timing_mem.mem[TIMING_REG + i] = (uint8_t)(seed + (i * 31));
+          }
+          tx[0] = TIMING_REG;
+          for(uint32_t i = 1; i < tc->tx_len; i++)
+          {
+              tx[i] = (uint8_t)(seed ^ (i * 13));
+          }
+          memset(rx, 0, sizeof(rx));
+
+          // a read without a write phase continues from the register pointer
+          timing_mem.ptr = TIMING_REG;
+
+          uint64_t start = sim_now();
+          TEST_CHECK(test_txn_run(I2C0, &txn) == i2c_status_ok);
+          uint64_t cycles = sim_now() - start;
+
+          // written bytes landed, read bytes are the register contents
+          for(uint32_t i = 1; i < tc->tx_len; i++)
+          {
+              TEST_CHECK(timing_mem.mem[TIMING_REG + i - 1] == tx[i]);
+          }
+          for(uint32_t i = 0; i < tc->rx_len; i++)
+          {
+              TEST_CHECK(rx[i] == (uint8_t)(seed + (i * 31)));
+          }
+          TEST_CHECK(timing_mem.reads_after_nack == 0);
+
+          bus_total += cycles;
+          bus_min = (cycles < bus_min) ? cycles : bus_min;
+          bus_max = (cycles > bus_max) ? cycles : bus_max;
+      }
+
+      // exactly the interrupts the shape needs, no spurious ones
+      sim_irq_stats(I2C0_IRQn, &stats, true);
+      TEST_CHECK(stats.count == tc->isrs * TIMING_RUNS);
+
+      // bus time is the ideal bit count plus handler latency, nothing more
+      uint64_t ideal = (uint64_t)tc->bits * bit;
+      TEST_CHECK(bus_min >= ideal);
+      TEST_CHECK(bus_max <= ideal + (tc->isrs * (SIM_IRQ_ENTRY_CYCLES + SIM_IRQ_EXIT_CYCLES + TIMING_ISR_SLACK)));
+
+      printf("%-22s %u ISRs, handler %5.0f ns avg %6llu ns max; "
+             "transaction %.2f us (ideal %.2f us, max %.2f us)\n",
+             tc->name, tc->isrs, (double)stats.total_ns / stats.count, (unsigned long long)stats.max_ns,
+             (double)bus_total / TIMING_RUNS / (SIM_CORE_HZ / 1e6), (double)ideal / (SIM_CORE_HZ / 1e6),
+             (double)bus_max / (SIM_CORE_HZ / 1e6));
+
+      total_isrs += tc->isrs * TIMING_RUNS;
+      total_txns += TIMING_RUNS;
+  }
+
+  // the firmware's own counters agree with the simulator
+  i2c_perf_snapshot(I2C0, &perf, false);
+  TEST_CHECK(perf.isr_count == total_isrs);
+  TEST_CHECK(perf.txn_ok == total_txns);
+  TEST_CHECK((perf.txn_nack == 0) && (perf.txn_bus_error == 0) && (perf.nacks == 0));
+  uint32_t hist_isrs = 0;
+  uint32_t hist_txns = 0;
+  for(uint32_t b = 0; b < I2C_PERF_BINS; b++)
+  {
+      hist_isrs += perf.isr_hist[b];
+      hist_txns += perf.txn_hist[b];
+  }
+  TEST_CHECK(hist_isrs == total_isrs);
+  TEST_CHECK(hist_txns == total_txns);
+  printf("perf counters: %u ISRs (longest %u cycles), %u transactions (longest %u ticks)\n",
+         perf.isr_count, perf.isr_max_cycles, perf.txn_ok, perf.txn_max_ticks);
+
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,418 @@
+/***************************************************************************//**
+ * @file
+ *   test_letimer_timers.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Software timers on LETIMER0: deadlines, counter wraps, the horizon and
+ *   compares the counter gets past while they are armed
+ *
+ * @details
+ *   letimer.c runs unchanged on the simulated LETIMER0, whose counter only
+ *   sees a compare write SIM_LETIMER_SYNC_TICKS after it is made. A main
+ *   loop like the one in main.c dispatches the timer callbacks and sleeps
+ *   in EM3 between them; every callback checks the tick it runs at against
+ *   the deadline its timer was given.
+ *
+ *   Periodic and long one-shot timers run across several counter wraps and
+ *   must expire on their deadline tick with no drift. A one-shot beyond
+ *   LETIMER_TIMER_HORIZON must take exactly the horizon wakeups it needs.
+ *   Random starts, restarts and cancels on a full heap must never leave a
+ *   timer expiring more than LETIMER_TIMER_MIN_TICKS late, or not at all.
+ *   Last, the core is held up between reading CNT and writing COMP1, so
+ *   that the counter reaches the compare value before the write does; the
+ *   timer must still expire, no later than the hold. The wakeup, expiry
+ *   and COMP1 write counters are checked against the expected counts, and
+ *   against the writes and interrupts the simulator saw.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "test_util.h"
+#include "letimer.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define TIMERS_COUNT        LETIMER_TIMER_MAX       // one record per heap entry
+#define TIMERS_DRIVER       (TIMERS_COUNT - 1)      // record of the timer that drives a phase
+#define TIMERS_TICK_CYCLES  (SIM_CORE_HZ / LETIMER_HZ) // core cycles per tick
+#define TIMERS_WRAP         (_LETIMER_CNT_MASK + 1) // ticks per counter wrap
+#define TIMERS_WRAP_RUN     300000                  // ticks of the wrap phase: over 4 counter wraps
+#define TIMERS_A_PER        1000                    // wrap phase: periodic timer A
+#define TIMERS_B_DELAY      1500                    // wrap phase: periodic timer B, offset from A
+#define TIMERS_B_PER        3000
+#define TIMERS_C_DELAY      100000                  // wrap phase: one-shot C, on one of A's deadlines
+#define TIMERS_D_DELAY      100000                  // horizon phase: lone one-shot D
+#define TIMERS_RANDOM_RUN   400000                  // ticks of the random phase
+#define TIMERS_RANDOM_PER   13                      // random phase: period of the driver
+#define TIMERS_RANDOM_DELAY 3000                    // random phase: longest delay
+#define TIMERS_RANDOM_MAXP  2000                    // random phase: longest period
+#define TIMERS_HOLD_LEAD    100                     // hold phase: ticks from one case to the next
+#define TIMERS_HOLD_LIMIT   1000                    // hold phase: longest a case may take; a missed match takes a wrap
+#define TIMERS_EM3_MIN      0.99                    // least share of the time spent in EM3
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+// what the driver timer does when it expires
+typedef enum
+{
+  timers_phase_idle,        /* nothing */
+  timers_phase_random,      /* starts, restarts or cancels a random timer */
+  timers_phase_hold,        /* starts timer 0 with the core held up in the COMP1 write */
+}TIMERS_PHASE_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+// one software timer and what the test expects of it
+typedef struct
+{
+    LETIMER_TIMER_STRUCT          timer;                  // the timer under test
+    uint32_t                      period;                 // ticks between expiries (0 for one-shot)
+    uint32_t                      deadline;               // next deadline
+    bool                          armed;                  // started and not yet expired or cancelled
+    uint32_t                      expiries;               // callbacks run
+    uint32_t                      last;                   // tick of the last callback
+}TIMERS_REC_STRUCT;
+
+
+// a compare write the core is held up in, and what it must cost
+typedef struct
+{
+    uint32_t                      hold;                   // ticks the core is held up before the write
+    uint32_t                      delay;                  // delay timer 0 is started with
+    uint32_t                      expiry;                 // ticks from the start to the expiry
+    uint32_t                      wakeups;                // LETIMER0 interrupts
+    uint32_t                      idle;                   // of them, wakeups that expired nothing
+    uint32_t                      writes;                 // COMP1 writes
+}TIMERS_HOLD_STRUCT;
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+static TIMERS_REC_STRUCT timers_rec[TIMERS_COUNT];
+static TIMERS_PHASE_Typedef timers_phase;
+static uint32_t timers_late_max;                          // latest expiry allowed, in ticks after the deadline
+static uint32_t timers_instants;                          // distinct ticks with an expiry
+static uint32_t timers_instant;                           // tick of the last expiry
+static uint32_t timers_seed = 12345;                      // random phase generator
+static const TIMERS_HOLD_STRUCT *timers_hold_case;        // hold phase: case the driver starts
+static uint32_t timers_hold_writes;                       // hold phase: simulator's COMP1 writes before the case
+
+// min tick margin 4 against a write sync of 3: a hold of up to one tick
+// less than the margin lets the write land in time; a longer one raises
+// the interrupt in software
+static const TIMERS_HOLD_STRUCT timers_hold_cases[] =
+{
+    { 0,  6,  6, 1, 0, 1 },
+    { 0,  1,  LETIMER_TIMER_MIN_TICKS, 1, 0, 1 },
+    { 2,  6,  6, 1, 0, 1 },
+    { 3,  6,  6, 1, 0, 1 },
+    // raised at 4, before the deadline; re-armed the minimum ahead
+    { 4,  6,  4 + LETIMER_TIMER_MIN_TICKS, 2, 1, 2 },
+    // counter past the compare value before the write
+    { 10, 5,  10, 1, 0, 1 },
+    { 500, 5, 500, 1, 0, 1 },
+};
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   Starts a timer and records its deadline
+ ******************************************************************************/
+static void timers_start(uint32_t n, uint32_t delay, uint32_t period)
+{
+  TIMERS_REC_STRUCT *rec = &timers_rec[n];
+
+  rec->deadline = letimer_timer_now() + delay;
+  rec->period = period;
+  rec->armed = true;
+  letimer_timer_start(&rec->timer, delay, period, 1UL << n);
+}
+
+
+static void timers_cancel(uint32_t n)
+{
+  letimer_timer_cancel(&timers_rec[n].timer);
+  timers_rec[n].armed = false;
+}
+
+
+static uint32_t timers_random(uint32_t range)
+{
+  timers_seed = (timers_seed * 1103515245UL) + 12345UL;
+  return (timers_seed >> 8) % range;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Callback of timer n: the expiry is on its deadline, or at most
+ *   timers_late_max after it
+ ******************************************************************************/
+static void timers_expired(uint32_t n)
+{
+  TIMERS_REC_STRUCT *rec = &timers_rec[n];
+  uint32_t now = letimer_timer_now();
+  int32_t late = (int32_t)(now - rec->deadline);
+
+  TEST_CHECK(rec->armed);
+  TEST_CHECK((late >= 0) && ((uint32_t)late <= timers_late_max));
+  rec->expiries++;
+  rec->last = now;
+  if(!timers_instants || (now != timers_instant))
+  {
+      timers_instants++;
+      timers_instant = now;
+  }
+
+  // the next deadline is a whole period on, however late this one ran
+  if(rec->period)
+  {
+      rec->deadline += rec->period;
+  }
+  else
+  {
+      rec->armed = false;
+  }
+
+  if(n != TIMERS_DRIVER)
+  {
+      return;
+  }
+  if(timers_phase == timers_phase_random)
+  {
+      // start, restart or cancel one of the others; not one whose expiry
+      // is scheduled but not yet handled, which would still be delivered
+      uint32_t k = timers_random(TIMERS_DRIVER);
+      if(get_scheduled_events() & (1UL << k))
+      {
+          return;
+      }
+      if(timers_random(4) == 0)
+      {
+          timers_cancel(k);
+      }
+      else
+      {
+          uint32_t period = timers_random(2) ? 0 : LETIMER_TIMER_MIN_TICKS + timers_random(TIMERS_RANDOM_MAXP);
+          timers_start(k, 1 + timers_random(TIMERS_RANDOM_DELAY), period);
+      }
+  }
+  else if(timers_phase == timers_phase_hold)
+  {
+      // counted from here
+      LETIMER_WAKE_STRUCT wake;
+      SIM_IRQ_STATS_STRUCT irqs;
+      letimer_wake_snapshot(&wake, true);
+      sim_irq_stats(LETIMER0_IRQn, &irqs, true);
+      timers_hold_writes = sim_letimer_writes(1);
+      sim_letimer_hold((uint64_t)timers_hold_case->hold * TIMERS_TICK_CYCLES);
+      timers_start(0, timers_hold_case->delay, 0);
+  }
+}
+
+
+#define TIMERS_HANDLER(n) static void timers_handler_##n(void) { timers_expired(n); }
+TIMERS_HANDLER(0)
+TIMERS_HANDLER(1)
+TIMERS_HANDLER(2)
+TIMERS_HANDLER(3)
+TIMERS_HANDLER(4)
+TIMERS_HANDLER(5)
+TIMERS_HANDLER(6)
+TIMERS_HANDLER(7)
+
+static void (*const timers_handlers[TIMERS_COUNT])(void) =
+{
+  timers_handler_0, timers_handler_1, timers_handler_2, timers_handler_3,
+  timers_handler_4, timers_handler_5, timers_handler_6, timers_handler_7,
+};
+
+
+/***************************************************************************//**
+ * @brief
+ *   The main loop of main() until a timer has expired a number of times
+ ******************************************************************************/
+static void timers_run(uint32_t n, uint32_t expiries, uint32_t max_ticks)
+{
+  uint32_t start = letimer_timer_now();
+
+  while(timers_rec[n].expiries < expiries)
+  {
+      TEST_CHECK((letimer_timer_now() - start) <= max_ticks);
+      while(scheduler_dispatch());
+
+      // sleep only if nothing was scheduled since the last dispatch
+      uint64_t slept = sim_now();
+      CORE_DECLARE_IRQ_STATE;
+      CORE_ENTER_CRITICAL();
+      if(!get_scheduled_events() && (timers_rec[n].expiries < expiries))
+      {
+          enter_sleep();
+          TEST_CHECK(sim_now() != slept);
+      }
+      CORE_EXIT_CRITICAL();
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Wakeup counters against the expected counts, and against the
+ *   interrupts and COMP1 writes the simulator saw since they were reset
+ ******************************************************************************/
+static void timers_check_wake(const LETIMER_WAKE_STRUCT *wake, uint32_t wakeups, uint32_t idle,
+                              uint32_t expiries, uint32_t writes, uint32_t irqs, uint32_t sim_writes)
+{
+  TEST_CHECK(wake->wakeups == wakeups);
+  TEST_CHECK(wake->idle_wakeups == idle);
+  TEST_CHECK(wake->expiries == expiries);
+  TEST_CHECK(wake->comp1_writes == writes);
+  TEST_CHECK(irqs == wakeups);
+  TEST_CHECK(sim_writes == writes);
+}
+
+
+int main(void)
+{
+  LETIMER_WAKE_STRUCT wake;
+  SIM_IRQ_STATS_STRUCT irqs;
+  uint32_t writes;
+
+  sim_init();
+  cmu_open();
+  sleep_open();
+  scheduler_open();
+  for(uint32_t n = 0; n < TIMERS_COUNT; n++)
+  {
+      scheduler_register(1UL << n, timers_handlers[n]);
+  }
+
+  // tickless time base: nothing armed, nothing enabled
+  letimer_timer_open(LETIMER0, false);
+  letimer_start(LETIMER0, true);
+  uint64_t tick0 = sim_now() / TIMERS_TICK_CYCLES;
+  TEST_CHECK(current_block_energy_mode() == EM4);
+  TEST_CHECK(!(LETIMER0->IEN & LETIMER_IEN_COMP1));
+
+  // wraps: every deadline on its tick; one wakeup per distinct deadline,
+  // one COMP1 write per wakeup and for the first start
+  letimer_wake_snapshot(&wake, true);
+  sim_irq_stats(LETIMER0_IRQn, &irqs, true);
+  writes = sim_letimer_writes(1);
+  uint64_t em3_start = sim_em_cycles(EM3);
+  uint64_t run_start = sim_now();
+  uint32_t t0 = letimer_timer_now();
+  timers_late_max = 0;
+  timers_start(0, TIMERS_A_PER, TIMERS_A_PER);
+  timers_start(1, TIMERS_B_DELAY, TIMERS_B_PER);
+  timers_start(2, TIMERS_C_DELAY, 0);
+  timers_run(0, TIMERS_WRAP_RUN / TIMERS_A_PER, TIMERS_WRAP_RUN);
+  uint32_t b_expiries = ((TIMERS_WRAP_RUN - TIMERS_B_DELAY) / TIMERS_B_PER) + 1;
+  TEST_CHECK(timers_rec[0].last == (t0 + TIMERS_WRAP_RUN));
+  TEST_CHECK(timers_rec[1].expiries == b_expiries);
+  TEST_CHECK((timers_rec[2].expiries == 1) && (timers_rec[2].last == (t0 + TIMERS_C_DELAY)));
+  TEST_CHECK(letimer_timer_now() == ((sim_now() / TIMERS_TICK_CYCLES) - tick0));
+  TEST_CHECK(letimer_timer_now() > (4 * TIMERS_WRAP));
+  letimer_wake_snapshot(&wake, true);
+  sim_irq_stats(LETIMER0_IRQn, &irqs, true);
+  uint32_t wakeups = (TIMERS_WRAP_RUN / TIMERS_A_PER) + b_expiries;
+  timers_check_wake(&wake, wakeups, 0, wakeups + 1, wakeups + 1, irqs.count, sim_letimer_writes(1) - writes);
+  double em3 = (double)(sim_em_cycles(EM3) - em3_start) / (double)(sim_now() - run_start);
+  TEST_CHECK(em3 >= TIMERS_EM3_MIN);
+  printf("wraps: %u ticks, %u counter wraps; %u expiries on %u wakeups, %u COMP1 writes; %.4f of the time in EM3\n",
+         letimer_timer_now(), letimer_timer_now() / (uint32_t)TIMERS_WRAP, wake.expiries, wake.wakeups, wake.comp1_writes, em3);
+  timers_cancel(0);
+  timers_cancel(1);
+  TEST_CHECK(!(LETIMER0->IEN & LETIMER_IEN_COMP1));
+
+  // horizon: a lone deadline beyond it costs a wakeup, and a write, per horizon
+  letimer_wake_snapshot(&wake, true);
+  sim_irq_stats(LETIMER0_IRQn, &irqs, true);
+  writes = sim_letimer_writes(1);
+  timers_start(0, TIMERS_D_DELAY, 0);
+  uint32_t d_deadline = timers_rec[0].deadline;
+  timers_run(0, timers_rec[0].expiries + 1, TIMERS_D_DELAY);
+  TEST_CHECK(timers_rec[0].last == d_deadline);
+  letimer_wake_snapshot(&wake, true);
+  sim_irq_stats(LETIMER0_IRQn, &irqs, true);
+  uint32_t horizons = (TIMERS_D_DELAY + LETIMER_TIMER_HORIZON - 1) / LETIMER_TIMER_HORIZON;
+  timers_check_wake(&wake, horizons, horizons - 1, 1, horizons, irqs.count, sim_letimer_writes(1) - writes);
+  printf("horizon: %u tick one-shot in %u wakeups, %u of them idle\n", TIMERS_D_DELAY, wake.wakeups, wake.idle_wakeups);
+
+  // random starts, restarts and cancels on a full heap: never more than the
+  // minimum arming distance late, and every wakeup accounted for
+  letimer_wake_snapshot(&wake, true);
+  sim_irq_stats(LETIMER0_IRQn, &irqs, true);
+  writes = sim_letimer_writes(1);
+  timers_instants = 0;
+  timers_late_max = LETIMER_TIMER_MIN_TICKS - 1;
+  timers_phase = timers_phase_random;
+  uint32_t expiries = 0;
+  for(uint32_t n = 0; n < TIMERS_COUNT; n++)
+  {
+      expiries += timers_rec[n].expiries;
+  }
+  timers_start(TIMERS_DRIVER, TIMERS_RANDOM_PER, TIMERS_RANDOM_PER);
+  timers_run(TIMERS_DRIVER, timers_rec[TIMERS_DRIVER].expiries + (TIMERS_RANDOM_RUN / TIMERS_RANDOM_PER),
+             TIMERS_RANDOM_RUN);
+  timers_phase = timers_phase_idle;
+  letimer_wake_snapshot(&wake, true);
+  sim_irq_stats(LETIMER0_IRQn, &irqs, true);
+  uint32_t now = letimer_timer_now();
+  for(uint32_t n = 0; n < TIMERS_COUNT; n++)
+  {
+      // none overdue: a missed match would leave its deadline behind
+      if(timers_rec[n].armed)
+      {
+          TEST_CHECK((int32_t)(now - timers_rec[n].deadline) < 0);
+          timers_cancel(n);
+      }
+      expiries -= timers_rec[n].expiries;
+  }
+  expiries = -expiries;
+  TEST_CHECK(wake.wakeups == (timers_instants + wake.idle_wakeups));
+  TEST_CHECK(wake.expiries == expiries);
+  TEST_CHECK(irqs.count == wake.wakeups);
+  TEST_CHECK(wake.comp1_writes == (sim_letimer_writes(1) - writes));
+  printf("random: %u expiries on %u wakeups (%u idle), %u COMP1 writes\n",
+         wake.expiries, wake.wakeups, wake.idle_wakeups, wake.comp1_writes);
+
+  // hold-ups between the read of CNT and the COMP1 write: the timer
+  // expires no later than the hold, never a counter wrap later
+  timers_phase = timers_phase_hold;
+  timers_late_max = TIMERS_HOLD_LIMIT;
+  for(uint32_t c = 0; c < sizeof(timers_hold_cases) / sizeof(timers_hold_cases[0]); c++)
+  {
+      // timer 0 may expire in the same dispatch as the driver that starts it
+      uint32_t target = timers_rec[0].expiries + 1;
+      timers_hold_case = &timers_hold_cases[c];
+      timers_start(TIMERS_DRIVER, TIMERS_HOLD_LEAD, 0);
+      timers_run(TIMERS_DRIVER, timers_rec[TIMERS_DRIVER].expiries + 1, TIMERS_HOLD_LEAD);
+      uint32_t start = timers_rec[TIMERS_DRIVER].last;
+      timers_run(0, target, TIMERS_HOLD_LIMIT);
+      letimer_wake_snapshot(&wake, true);
+      sim_irq_stats(LETIMER0_IRQn, &irqs, true);
+      TEST_CHECK((timers_rec[0].last - start) == timers_hold_case->expiry);
+      timers_check_wake(&wake, timers_hold_case->wakeups, timers_hold_case->idle, 1, timers_hold_case->writes,
+                        irqs.count, sim_letimer_writes(1) - timers_hold_writes);
+      printf("held %3u ticks in the COMP1 write of a %u tick one-shot: expired after %u ticks, %u wakeups\n",
+             timers_hold_case->hold, timers_hold_case->delay, timers_rec[0].last - start, wake.wakeups);
+  }
+
+  printf("PASS\n");
+  return 0;
+}
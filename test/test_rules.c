@@ -0,0 +1,216 @@
+/***************************************************************************//**
+ * @file
+ *   test_rules.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Hysteresis rules: a sweep of every value around the band, and noisy RH
+ *   at the LED1 threshold
+ *
+ * @details
+ *   Sweep: for rising and falling rules, every value from well below to
+ *   well above the band is evaluated from each starting state. The new
+ *   state, and whether the action ran, must follow the rule definition:
+ *   active at or beyond the threshold, inactive beyond the far side of the
+ *   band, unchanged inside it, and inactive inside it for a rule with no
+ *   state yet. Rules of another channel are never touched.
+ *
+ *   Noise: the LED1 rule of app.c, with RH_LED_ON and RH_LED_HYST, sees
+ *   RH_NOISE_SAMPLES of +/-0.60 %RH noise around 30.00 %RH. A plain
+ *   comparison against RH_LED_ON, as the app made before the rule table,
+ *   is counted alongside. Then a slow RH ramp through the threshold and
+ *   back, with noise narrower than the band, must switch LED1 exactly once
+ *   each way per cycle.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "test_util.h"
+#include "app.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define RULES_THRESHOLD     500                     // sweep: threshold of the rules under test
+#define RULES_HYST          20                      // sweep: their band
+#define RULES_MARGIN        10                      // sweep: values beyond the band on either side
+#define RULES_CH            3                       // sweep: channel of the rules under test
+#define RULES_OTHER_CH      4                       // sweep: channel of the bystander rule
+#define RH_NOISE_SAMPLES    10000                   // noise: samples around RH_LED_ON
+#define RH_NOISE            60                      // noise: +/- 0.60 %RH
+#define RH_RAMP_LOW         2500                    // ramp: 25.00 %RH ...
+#define RH_RAMP_HIGH        3500                    // ... to 35.00 %RH and back
+#define RH_RAMP_STEP        1                       // ramp: 0.01 %RH per sample
+#define RH_RAMP_NOISE       40                      // ramp: +/- 0.40 %RH, peak to peak inside RH_LED_HYST
+#define RH_RAMP_CYCLES      20                      // ramp: up and down cycles
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+static uint32_t rules_calls;                              // actions run
+static bool rules_last;                                   // argument of the last action
+static uint32_t rules_other_calls;                        // actions of the bystander rule
+static uint32_t rules_seed = 12345;                       // noise generator
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+static void rules_action(bool active)
+{
+  rules_calls++;
+  rules_last = active;
+}
+
+
+static void rules_other_action(bool active)
+{
+  (void)active;
+  rules_other_calls++;
+}
+
+
+static int32_t rules_noise(int32_t amplitude)
+{
+  rules_seed = (rules_seed * 1103515245UL) + 12345UL;
+  return (int32_t)((rules_seed >> 8) % (uint32_t)((2 * amplitude) + 1)) - amplitude;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   State a rule must move to on a value, by its definition
+ ******************************************************************************/
+static RULE_STATE_Typedef rules_expected(RULE_DIRECTION_Typedef direction, RULE_STATE_Typedef state, int32_t value)
+{
+  // distance into the active side; the band is the hysteresis short of it
+  int32_t past = (direction == rule_rising) ? value - RULES_THRESHOLD : RULES_THRESHOLD - value;
+
+  if(past >= 0)
+  {
+      return rule_state_active;
+  }
+  if(past < -RULES_HYST)
+  {
+      return rule_state_inactive;
+  }
+  return (state == rule_state_unknown) ? rule_state_inactive : state;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Every value around the band, from every starting state
+ ******************************************************************************/
+static void rules_sweep(RULE_DIRECTION_Typedef direction)
+{
+  RULE_STRUCT rules[2] =
+  {
+      { .channel = RULES_OTHER_CH, .direction = rule_rising, .threshold = RULES_THRESHOLD,
+        .hysteresis = RULES_HYST, .action = rules_other_action },
+      { .channel = RULES_CH, .direction = direction, .threshold = RULES_THRESHOLD,
+        .hysteresis = RULES_HYST, .action = rules_action },
+  };
+
+  for(int32_t value = RULES_THRESHOLD - RULES_HYST - RULES_MARGIN;
+      value <= RULES_THRESHOLD + RULES_HYST + RULES_MARGIN; value++)
+  {
+      for(RULE_STATE_Typedef from = rule_state_unknown; from <= rule_state_active; from++)
+      {
+          rules_init(rules, 2);
+          rules[1].state = from;
+          rules_calls = 0;
+
+          RULE_STATE_Typedef want = rules_expected(direction, from, value);
+          rules_eval(rules, 2, RULES_CH, value);
+          TEST_CHECK(rules[1].state == want);
+          TEST_CHECK(rules_calls == ((want != from) ? 1 : 0));
+          TEST_CHECK(!rules_calls || (rules_last == (want == rule_state_active)));
+
+          // the same value again changes nothing
+          rules_eval(rules, 2, RULES_CH, value);
+          TEST_CHECK((rules[1].state == want) && (rules_calls == ((want != from) ? 1 : 0)));
+          TEST_CHECK(rules[0].state == rule_state_unknown);
+      }
+  }
+  TEST_CHECK(rules_other_calls == 0);
+}
+
+
+int main(void)
+{
+  RULE_STRUCT led1;
+
+  // sweep
+  rules_sweep(rule_rising);
+  rules_sweep(rule_falling);
+  printf("sweep: values %d..%d from each state, rising and falling, all as defined\n",
+         RULES_THRESHOLD - RULES_HYST - RULES_MARGIN, RULES_THRESHOLD + RULES_HYST + RULES_MARGIN);
+
+  // LED1 as app_rules_open() sets it up
+  led1.channel = APP_CH_RH;
+  led1.direction = rule_rising;
+  led1.threshold = RH_LED_ON;
+  led1.hysteresis = RH_LED_HYST;
+  led1.action = rules_action;
+
+  // noise: the rule settles once; a plain comparison follows every sample
+  rules_init(&led1, 1);
+  rules_calls = 0;
+  uint32_t cmp_toggles = 0;
+  bool cmp_on = false;
+  for(uint32_t n = 0; n < RH_NOISE_SAMPLES; n++)
+  {
+      int32_t rh = RH_LED_ON + rules_noise(RH_NOISE);
+      bool on = (rh >= RH_LED_ON);
+      cmp_toggles += (n && (on != cmp_on));
+      cmp_on = on;
+      rules_eval(&led1, 1, APP_CH_RH, rh);
+  }
+  TEST_CHECK(rules_calls <= 2);
+  TEST_CHECK(rules_last && (led1.state == rule_state_active));
+  printf("noise: %u samples at %u +/- %u: compare writes %u, toggles %u; rule actions %u\n",
+         RH_NOISE_SAMPLES, RH_LED_ON, RH_NOISE, RH_NOISE_SAMPLES, cmp_toggles, rules_calls);
+
+  // ramp: one switch each way per cycle, on the right side of the band
+  rules_init(&led1, 1);
+  rules_calls = 0;
+  uint32_t on_calls = 0;
+  for(uint32_t c = 0; c < RH_RAMP_CYCLES; c++)
+  {
+      for(int32_t rh = RH_RAMP_LOW; rh <= RH_RAMP_HIGH; rh += RH_RAMP_STEP)
+      {
+          uint32_t calls = rules_calls;
+          int32_t value = rh + rules_noise(RH_RAMP_NOISE);
+          rules_eval(&led1, 1, APP_CH_RH, value);
+          if((rules_calls != calls) && rules_last)
+          {
+              TEST_CHECK(value >= RH_LED_ON);
+              on_calls++;
+          }
+      }
+      for(int32_t rh = RH_RAMP_HIGH; rh >= RH_RAMP_LOW; rh -= RH_RAMP_STEP)
+      {
+          uint32_t calls = rules_calls;
+          int32_t value = rh + rules_noise(RH_RAMP_NOISE);
+          rules_eval(&led1, 1, APP_CH_RH, value);
+          if((rules_calls != calls) && !rules_last)
+          {
+              TEST_CHECK(value < (RH_LED_ON - RH_LED_HYST));
+          }
+      }
+  }
+  // the first sample decides the initial state: off, at the bottom of the ramp
+  TEST_CHECK(rules_calls == (1 + (2 * RH_RAMP_CYCLES)));
+  TEST_CHECK(on_calls == RH_RAMP_CYCLES);
+  printf("ramp: %u cycles %u..%u +/- %u: %u rule actions\n",
+         RH_RAMP_CYCLES, RH_RAMP_LOW, RH_RAMP_HIGH, RH_RAMP_NOISE, rules_calls);
+
+  printf("PASS\n");
+  return 0;
+}
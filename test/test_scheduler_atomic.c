@@ -0,0 +1,316 @@
+/***************************************************************************//**
+ * @file
+ *   test_scheduler_atomic.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   add_scheduled_event() and remove_scheduled_event() under concurrency:
+ *   no update is lost
+ *
+ * @details
+ *   Threads stand in for the main loop and the handlers at thread level, a
+ *   periodic POSIX timer signal for an interrupt that preempts any of them
+ *   at an arbitrary point, including inside a read-modify-write.
+ *
+ *   Toggle phase: every thread, and the signal handler, owns event bits
+ *   that only it sets and clears. After each update the owner reads the
+ *   event mask back; another context's update landing on a stale copy of
+ *   the mask would show up as an owned bit with the wrong value.
+ *
+ *   Dispatch phase: producer threads, and the signal handler, schedule
+ *   their event whenever its previous one has been handled, while the main
+ *   thread runs scheduler_dispatch(). A lost add, or a dispatch clearing
+ *   more than its own bit, leaves a producer waiting for good; the counts
+ *   of events scheduled and handled must agree.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "test_util.h"
+#include "scheduler.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define ATOMIC_THREADS      4                       // thread contexts
+#define ATOMIC_BITS         4                       // event bits owned per context in the toggle phase
+#define ATOMIC_TOGGLES      2000000                 // updates per thread in the toggle phase
+#define ATOMIC_EVENTS       20000                   // events per producer thread in the dispatch phase
+#define ATOMIC_IRQ          ATOMIC_THREADS          // context index of the signal handler
+#define ATOMIC_SIG          SIGUSR1                 // simulated interrupt
+#define ATOMIC_IRQ_NS       17000                   // interrupt period
+#define ATOMIC_TIMEOUT_NS   20000000000ULL          // longest wait for a handshake
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+static atomic_uint atomic_bad;                            // owned bits read back with the wrong value
+static atomic_uint atomic_irq_updates;                    // updates made by the signal handler
+static atomic_bool atomic_dispatch_phase;                 // the signal handler schedules events instead of toggling
+static uint32_t atomic_irq_mask;                          // bits the signal handler owns, and their expected values
+static uint32_t atomic_irq_set;
+static atomic_uint atomic_scheduled[ATOMIC_THREADS + 1];  // events scheduled per context
+static atomic_uint atomic_handled[ATOMIC_THREADS + 1];    // events handled per context
+static atomic_bool atomic_stop;                           // the producers give up
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   Event bits owned by a context in the toggle phase
+ ******************************************************************************/
+static uint32_t atomic_bits(uint32_t ctx)
+{
+  return ((1UL << ATOMIC_BITS) - 1) << (ctx * ATOMIC_BITS);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sets or clears one owned bit and checks every owned bit afterwards
+ *
+ * @return
+ *   Updated expected value of the owned bits
+ ******************************************************************************/
+static uint32_t atomic_toggle(uint32_t mask, uint32_t set, uint32_t n)
+{
+  uint32_t bit = 1UL << (31 - __CLZ(mask));
+
+  // walk the owned bits: the n-th update flips one of them
+  for(uint32_t skip = n % ATOMIC_BITS; skip; skip--)
+  {
+      bit = 1UL << (31 - __CLZ(mask & (bit - 1)));
+  }
+  if(set & bit)
+  {
+      remove_scheduled_event(bit);
+      set &= ~bit;
+  }
+  else
+  {
+      add_scheduled_event(bit);
+      set |= bit;
+  }
+  if((get_scheduled_events() & mask) != set)
+  {
+      atomic_fetch_add(&atomic_bad, 1);
+  }
+  return set;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Simulated interrupt handler
+ ******************************************************************************/
+static void atomic_irq(int sig)
+{
+  (void)sig;
+
+  // dispatch phase: schedule again once the last event has been handled
+  if(atomic_load(&atomic_dispatch_phase))
+  {
+      if(atomic_load(&atomic_handled[ATOMIC_IRQ]) == atomic_load(&atomic_scheduled[ATOMIC_IRQ]))
+      {
+          atomic_fetch_add(&atomic_scheduled[ATOMIC_IRQ], 1);
+          add_scheduled_event(1UL << ATOMIC_IRQ);
+      }
+      return;
+  }
+
+  atomic_irq_set = atomic_toggle(atomic_irq_mask, atomic_irq_set, atomic_fetch_add(&atomic_irq_updates, 1));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Toggle phase thread
+ ******************************************************************************/
+static void *atomic_toggler(void *arg)
+{
+  uint32_t ctx = (uint32_t)(uintptr_t)arg;
+  uint32_t mask = atomic_bits(ctx);
+  uint32_t set = 0;
+
+  for(uint32_t n = 0; n < ATOMIC_TOGGLES; n++)
+  {
+      set = atomic_toggle(mask, set, n);
+      if((n % 64) == 0)
+      {
+          sched_yield();
+      }
+  }
+
+  // leave the owned bits clear
+  remove_scheduled_event(mask);
+  return NULL;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Dispatch phase producer thread: one event at a time, each scheduled
+ *   once the previous one has been handled
+ ******************************************************************************/
+static void *atomic_producer(void *arg)
+{
+  uint32_t ctx = (uint32_t)(uintptr_t)arg;
+
+  for(uint32_t n = 0; (n < ATOMIC_EVENTS) && !atomic_load(&atomic_stop); n++)
+  {
+      while((atomic_load(&atomic_handled[ctx]) != n) && !atomic_load(&atomic_stop))
+      {
+          sched_yield();
+      }
+      atomic_fetch_add(&atomic_scheduled[ctx], 1);
+      add_scheduled_event(1UL << ctx);
+  }
+  return NULL;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Event handlers of the dispatch phase
+ ******************************************************************************/
+#define ATOMIC_HANDLER(ctx) static void atomic_handler_##ctx(void) { atomic_fetch_add(&atomic_handled[ctx], 1); }
+ATOMIC_HANDLER(0)
+ATOMIC_HANDLER(1)
+ATOMIC_HANDLER(2)
+ATOMIC_HANDLER(3)
+ATOMIC_HANDLER(4)
+
+static void (*const atomic_handlers[ATOMIC_THREADS + 1])(void) =
+{
+  atomic_handler_0, atomic_handler_1, atomic_handler_2, atomic_handler_3, atomic_handler_4,
+};
+
+
+int main(void)
+{
+  pthread_t threads[ATOMIC_THREADS];
+  struct sigaction sa;
+  struct sigevent sev;
+  struct itimerspec its;
+  timer_t timer;
+
+  // a single CPU interleaves the threads at their yields and at the timer signal
+  setvbuf(stdout, NULL, _IONBF, 0);
+  scheduler_open();
+  atomic_irq_mask = atomic_bits(ATOMIC_IRQ);
+
+  // the simulated interrupt
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = atomic_irq;
+  sigemptyset(&sa.sa_mask);
+  sigaction(ATOMIC_SIG, &sa, NULL);
+  memset(&sev, 0, sizeof(sev));
+  sev.sigev_notify = SIGEV_SIGNAL;
+  sev.sigev_signo = ATOMIC_SIG;
+  TEST_CHECK(timer_create(CLOCK_MONOTONIC, &sev, &timer) == 0);
+  its.it_value.tv_sec = 0;
+  its.it_value.tv_nsec = ATOMIC_IRQ_NS;
+  its.it_interval = its.it_value;
+  TEST_CHECK(timer_settime(timer, 0, &its, NULL) == 0);
+
+  // toggle phase: owned bits only ever read back as their owner left them
+  uint64_t start = test_host_ns();
+  for(uint32_t t = 0; t < ATOMIC_THREADS; t++)
+  {
+      TEST_CHECK(pthread_create(&threads[t], NULL, atomic_toggler, (void *)(uintptr_t)t) == 0);
+  }
+  for(uint32_t t = 0; t < ATOMIC_THREADS; t++)
+  {
+      TEST_CHECK(pthread_join(threads[t], NULL) == 0);
+  }
+  uint64_t toggle_ns = test_host_ns() - start;
+
+  // the interrupt held off while the result is read and it changes phase;
+  // in the dispatch phase it schedules a bit of the toggle phase threads
+  sigset_t irqs;
+  sigemptyset(&irqs);
+  sigaddset(&irqs, ATOMIC_SIG);
+  sigprocmask(SIG_BLOCK, &irqs, NULL);
+  uint32_t irq_updates = atomic_load(&atomic_irq_updates);
+  TEST_CHECK(atomic_load(&atomic_bad) == 0);
+  TEST_CHECK(irq_updates > 0);
+  TEST_CHECK((get_scheduled_events() & ~atomic_irq_mask) == 0);
+  TEST_CHECK((get_scheduled_events() & atomic_irq_mask) == atomic_irq_set);
+  remove_scheduled_event(atomic_irq_mask);
+  atomic_store(&atomic_dispatch_phase, true);
+  sigprocmask(SIG_UNBLOCK, &irqs, NULL);
+  printf("toggle phase: %u thread and %u interrupt updates, none lost (%.0f ns host per update)\n",
+         ATOMIC_THREADS * ATOMIC_TOGGLES, irq_updates,
+         (double)toggle_ns / (ATOMIC_THREADS * ATOMIC_TOGGLES + irq_updates));
+
+  // dispatch phase: every event scheduled is handled exactly once
+  for(uint32_t ctx = 0; ctx <= ATOMIC_THREADS; ctx++)
+  {
+      scheduler_register(1UL << ctx, atomic_handlers[ctx]);
+  }
+  start = test_host_ns();
+  for(uint32_t t = 0; t < ATOMIC_THREADS; t++)
+  {
+      TEST_CHECK(pthread_create(&threads[t], NULL, atomic_producer, (void *)(uintptr_t)t) == 0);
+  }
+  for(;;)
+  {
+      bool done = true;
+      for(uint32_t t = 0; t < ATOMIC_THREADS; t++)
+      {
+          done &= (atomic_load(&atomic_handled[t]) == ATOMIC_EVENTS);
+      }
+      if(done)
+      {
+          break;
+      }
+      if((test_host_ns() - start) > ATOMIC_TIMEOUT_NS)
+      {
+          // a lost update: some producer waits for an event that will never be handled
+          atomic_store(&atomic_stop, true);
+          break;
+      }
+      if(!scheduler_dispatch())
+      {
+          sched_yield();
+      }
+  }
+  for(uint32_t t = 0; t < ATOMIC_THREADS; t++)
+  {
+      TEST_CHECK(pthread_join(threads[t], NULL) == 0);
+  }
+  TEST_CHECK(!atomic_load(&atomic_stop));
+
+  // no more interrupts; run what is left
+  timer_delete(timer);
+  sigprocmask(SIG_BLOCK, &irqs, NULL);
+  while(scheduler_dispatch());
+  uint64_t dispatch_ns = test_host_ns() - start;
+
+  uint32_t events = 0;
+  for(uint32_t ctx = 0; ctx <= ATOMIC_THREADS; ctx++)
+  {
+      TEST_CHECK(atomic_load(&atomic_handled[ctx]) == atomic_load(&atomic_scheduled[ctx]));
+      events += atomic_load(&atomic_handled[ctx]);
+  }
+  TEST_CHECK(atomic_load(&atomic_handled[ATOMIC_IRQ]) > 0);
+  TEST_CHECK(get_scheduled_events() == 0);
+  printf("dispatch phase: %u thread and %u interrupt events, each handled once (%.0f ns host per event)\n",
+         ATOMIC_THREADS * ATOMIC_EVENTS, atomic_load(&atomic_handled[ATOMIC_IRQ]), (double)dispatch_ns / events);
+
+  printf("PASS\n");
+  return 0;
+}
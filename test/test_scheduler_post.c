@@ -0,0 +1,268 @@
+/***************************************************************************//**
+ * @file
+ *   test_scheduler_post.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   scheduler_post() stress with producers in simulated interrupts
+ *
+ * @details
+ *   The main thread is the main loop: it dispatches, and posts events of
+ *   its own. Two POSIX signals stand in for interrupts of two priorities:
+ *   the high priority one may preempt the low priority handler, neither
+ *   preempts itself, and either may land anywhere in the main loop,
+ *   including in the middle of a post or a take. Two periodic POSIX timers
+ *   of unrelated periods raise them, so they land at arbitrary points. Every
+ *   post carries its producer's sequence number; the low priority handler
+ *   posts twice with some work between, where the high priority interrupt
+ *   can land. Now and then the main loop stops dispatching for a while so
+ *   that the queue fills up.
+ *
+ *   Checks that every event either arrives or is counted as an overflow,
+ *   that each producer's events arrive in the order they were posted with
+ *   nothing duplicated, that timestamps never go backwards per producer,
+ *   and that the queue counters agree with what the producers saw.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+#include "test_util.h"
+#include "scheduler.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define POST_SOURCES        3                       // main loop, low and high priority interrupt
+#define POST_MAIN           0                       // producer index: main loop
+#define POST_LOW            1                       // producer index: low priority interrupt
+#define POST_HIGH           2                       // producer index: high priority interrupt
+#define POST_SIG_LOW        SIGUSR1                 // low priority interrupt
+#define POST_SIG_HIGH       SIGUSR2                 // high priority interrupt
+#define POST_IRQS           100000                  // interrupts taken before the test ends
+#define POST_LOW_NS         23000                   // low priority interrupt period
+#define POST_HIGH_NS        37000                   // high priority interrupt period
+#define POST_TIMEOUT_NS     20000000000ULL          // longest run
+#define POST_LOW_WORK_NS    5000                    // low priority handler work between its two posts
+#define POST_STALL_EVERY    4096                    // main loop iterations between stalls
+#define POST_STALL_NS       1000000                 // length of a stall
+#define POST_SEQ_MASK       0x00FFFFFF              // payload: sequence number ...
+#define POST_SRC_SHIFT      24                      // ... and producer above it
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+// one producer and what the consumer has seen of it
+typedef struct
+{
+    uint32_t                      event;                  // event bit posted
+    volatile uint32_t             seq;                    // next sequence number to post
+    volatile uint32_t             dropped;                // posts refused by a full queue
+    uint32_t                      received;               // events delivered
+    uint32_t                      next;                   // sequence number expected next
+    uint32_t                      last_stamp;             // timestamp of the last event delivered
+}POST_SOURCE_STRUCT;
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+static POST_SOURCE_STRUCT post_src[POST_SOURCES] =
+{
+    { .event = 0x20 },
+    { .event = 0x40 },
+    { .event = 0x80 },
+};
+static volatile sig_atomic_t post_in_queue;               // the main loop is inside scheduler_post() or a take
+static volatile uint32_t post_preempted;                  // interrupts that landed inside one
+static volatile uint32_t post_nested;                     // high priority interrupts taken inside the low priority handler
+static volatile sig_atomic_t post_in_low;
+static volatile uint32_t post_irqs;                       // interrupts taken
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   Posts the next event of a producer
+ ******************************************************************************/
+static void post_one(uint32_t src)
+{
+  POST_SOURCE_STRUCT *s = &post_src[src];
+
+  if(scheduler_post(s->event, (src << POST_SRC_SHIFT) | (s->seq & POST_SEQ_MASK)))
+  {
+      s->seq++;
+  }
+  else
+  {
+      s->dropped++;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Simulated interrupt handlers
+ ******************************************************************************/
+static void post_irq(int sig)
+{
+  post_irqs++;
+  if(post_in_queue)
+  {
+      post_preempted++;
+  }
+  if(sig == POST_SIG_LOW)
+  {
+      // two posts with handler work between them, where the high priority interrupt can land
+      post_in_low = 1;
+      post_one(POST_LOW);
+      uint64_t work = test_host_ns();
+      while((test_host_ns() - work) < POST_LOW_WORK_NS);
+      post_one(POST_LOW);
+      post_in_low = 0;
+  }
+  else
+  {
+      if(post_in_low)
+      {
+          post_nested++;
+      }
+      post_one(POST_HIGH);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Handler of every queued event: order, payload and timestamp checks
+ ******************************************************************************/
+static void post_handler(const SCHEDULER_EVENT_STRUCT *event)
+{
+  uint32_t src = event->payload >> POST_SRC_SHIFT;
+
+  TEST_CHECK(src < POST_SOURCES);
+  POST_SOURCE_STRUCT *s = &post_src[src];
+  TEST_CHECK(event->event == s->event);
+
+  // in posting order, none lost once queued, none twice
+  TEST_CHECK((event->payload & POST_SEQ_MASK) == (s->next & POST_SEQ_MASK));
+  TEST_CHECK(!s->received || ((int32_t)(event->timestamp - s->last_stamp) >= 0));
+  s->next++;
+  s->received++;
+  s->last_stamp = event->timestamp;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a periodic timer raising a simulated interrupt
+ ******************************************************************************/
+static void post_timer(int sig, long period_ns)
+{
+  struct sigevent sev;
+  struct itimerspec its;
+  timer_t timer;
+
+  memset(&sev, 0, sizeof(sev));
+  sev.sigev_notify = SIGEV_SIGNAL;
+  sev.sigev_signo = sig;
+  TEST_CHECK(timer_create(CLOCK_MONOTONIC, &sev, &timer) == 0);
+  its.it_value.tv_sec = 0;
+  its.it_value.tv_nsec = period_ns;
+  its.it_interval = its.it_value;
+  TEST_CHECK(timer_settime(timer, 0, &its, NULL) == 0);
+}
+
+
+int main(void)
+{
+  struct sigaction sa;
+  SCHEDULER_QUEUE_STRUCT counters;
+  uint32_t loops = 0;
+
+  scheduler_open();
+  for(uint32_t src = 0; src < POST_SOURCES; src++)
+  {
+      scheduler_register_queued(post_src[src].event, post_handler);
+  }
+
+  // the high priority interrupt may preempt the low priority one, not itself
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = post_irq;
+  sigemptyset(&sa.sa_mask);
+  sigaction(POST_SIG_HIGH, &sa, NULL);
+  sigaddset(&sa.sa_mask, POST_SIG_LOW);
+  sigaction(POST_SIG_LOW, &sa, NULL);
+
+  uint64_t host_start = test_host_ns();
+  post_timer(POST_SIG_LOW, POST_LOW_NS);
+  post_timer(POST_SIG_HIGH, POST_HIGH_NS);
+  while(post_irqs < POST_IRQS)
+  {
+      TEST_CHECK((test_host_ns() - host_start) < POST_TIMEOUT_NS);
+
+      // a stall: the interrupts fill the queue and overflow it while nothing is taken
+      if((++loops % POST_STALL_EVERY) == 0)
+      {
+          uint64_t stall = test_host_ns();
+          while((test_host_ns() - stall) < POST_STALL_NS);
+          continue;
+      }
+
+      post_in_queue = 1;
+      post_one(POST_MAIN);
+      while(scheduler_dispatch());
+      post_in_queue = 0;
+  }
+
+  // no more interrupts; drain
+  sigset_t irqs;
+  sigemptyset(&irqs);
+  sigaddset(&irqs, POST_SIG_LOW);
+  sigaddset(&irqs, POST_SIG_HIGH);
+  sigprocmask(SIG_BLOCK, &irqs, NULL);
+  while(scheduler_dispatch());
+  uint64_t host_ns = test_host_ns() - host_start;
+
+  // every post either arrived or was counted as dropped
+  uint32_t posted = 0;
+  uint32_t dropped = 0;
+  for(uint32_t src = 0; src < POST_SOURCES; src++)
+  {
+      POST_SOURCE_STRUCT *s = &post_src[src];
+      TEST_CHECK(s->received == s->seq);
+      posted += s->seq;
+      dropped += s->dropped;
+  }
+  scheduler_queue_snapshot(&counters, false);
+  TEST_CHECK(counters.posted == posted);
+  TEST_CHECK(counters.overflows == dropped);
+  TEST_CHECK(counters.high_water <= SCHEDULER_QUEUE_DEPTH);
+  TEST_CHECK(get_scheduled_events() == 0);
+
+  // the interleavings the test is for did happen
+  TEST_CHECK(post_src[POST_LOW].received && post_src[POST_HIGH].received);
+  TEST_CHECK(post_preempted > 0);
+  TEST_CHECK(post_nested > 0);
+  TEST_CHECK(dropped > 0);
+  TEST_CHECK(counters.high_water == SCHEDULER_QUEUE_DEPTH);
+
+  printf("%u events delivered (main %u, low %u, high %u), %u dropped by a full queue, high water %u\n",
+         posted, post_src[POST_MAIN].received, post_src[POST_LOW].received, post_src[POST_HIGH].received,
+         dropped, counters.high_water);
+  printf("%u interrupts inside a main loop post or take, %u high inside low; %.0f ns host per event\n",
+         post_preempted, post_nested, (double)host_ns / (posted + dropped));
+
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,191 @@
+/***************************************************************************//**
+ * @file
+ *   test_si7021_codes.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Si7021 code conversions over every 16-bit code, read through the driver
+ *
+ * @details
+ *   A simulated Si7021 returns each of the 65536 RH codes, and a T code that
+ *   also walks every value, to combined measurements made with
+ *   si7021_i2c_read_rh_t(). For every sample the fixed point conversions
+ *   must equal the floor of 100 times the datasheet formula exactly,
+ *   computed here in integer arithmetic, and the floating point ones must
+ *   be within single precision rounding of it. Then reports the host cost
+ *   of the floating point and the fixed point conversions.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include <math.h>
+
+#include "test_util.h"
+#include "si7021.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define CODES_COUNT         65536                   // every 16-bit code
+#define CODES_T_XOR         0xA5A5                  // T code of a sample: its RH code with these bits flipped
+#define CODES_CB            0x20                    // callback event of the measurements
+#define CODES_FLOAT_TOL     1e-4                    // float result against the exact value, %RH or degC
+#define CODES_BENCH_CALLS   (1 << 20)               // calls per conversion in the benchmark
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+static SIM_SI7021_STRUCT codes_si7021;
+static volatile float codes_float_sink;
+static volatile int32_t codes_centi_sink;
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   sim_run_while() condition: the measurement's callback event is not yet
+ *   scheduled
+ ******************************************************************************/
+static bool codes_pending(void *arg)
+{
+  (void)arg;
+  return !(get_scheduled_events() & CODES_CB);
+}
+
+
+static bool codes_probing(void *sensor)
+{
+  return si7021_identity(*(uint32_t *)sensor)->probe == si7021_probe_pending;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   floor(num / 65536) for a signed numerator
+ ******************************************************************************/
+static int64_t codes_floor_div(int64_t num)
+{
+  int64_t q = num / 65536;
+
+  return ((num % 65536) < 0) ? q - 1 : q;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Host time per call of a conversion, in nanoseconds
+ ******************************************************************************/
+static double codes_bench_float(float (*calc)(uint32_t sensor), uint32_t sensor)
+{
+  uint64_t start = test_host_ns();
+
+  for(uint32_t n = 0; n < CODES_BENCH_CALLS; n++)
+  {
+      codes_float_sink = calc(sensor);
+  }
+  return (double)(test_host_ns() - start) / CODES_BENCH_CALLS;
+}
+
+static double codes_bench_centi(int32_t (*calc)(uint32_t sensor), uint32_t sensor)
+{
+  uint64_t start = test_host_ns();
+
+  for(uint32_t n = 0; n < CODES_BENCH_CALLS; n++)
+  {
+      codes_centi_sink = calc(sensor);
+  }
+  return (double)(test_host_ns() - start) / CODES_BENCH_CALLS;
+}
+
+
+int main(void)
+{
+  double rh_err_max = 0;
+  double t_err_max = 0;
+  uint32_t rh_float_differs = 0;
+  uint32_t t_float_differs = 0;
+
+  sim_init();
+  cmu_open();
+  scheduler_open();
+
+  // the sensor and the pull-ups run from SENSOR_EN, as on the board
+  GPIO_PinModeSet(gpioPortB, 10, gpioModePushPull, 0);
+  sim_bus_power_pin(0, gpioPortB, 10);
+  sim_si7021_init(&codes_si7021, SI7021_ADDR, 0);
+  sim_bus_attach(0, &codes_si7021.slave);
+  GPIO_PinModeSet(gpioPortC, 11, gpioModeWiredAnd, 1);
+  GPIO_PinModeSet(gpioPortC, 10, gpioModeWiredAnd, 1);
+
+  // power up, open and identify the sensor
+  si7021_power_on(true);
+  si7021_i2c_open(I2C0);
+  uint32_t sensor = si7021_register(I2C0, SI7021_ADDR, 0);
+  TEST_CHECK(sim_run_while(codes_probing, &sensor, SIM_MS(1000)));
+  const SI7021_ID_STRUCT *id = si7021_identity(sensor);
+  TEST_CHECK(id->probe == si7021_probe_ok);
+  TEST_CHECK(id->device == SI7021_DEV_SI7021);
+  TEST_CHECK(id->fw_rev == SI7021_FW_2_0);
+  TEST_CHECK((id->serial_a == codes_si7021.serial_a) && (id->serial_b == codes_si7021.serial_b));
+
+  uint64_t host_start = test_host_ns();
+  for(uint32_t code = 0; code < CODES_COUNT; code++)
+  {
+      uint32_t t_code = code ^ CODES_T_XOR;
+
+      // one combined measurement through the bus
+      codes_si7021.rh_code = (uint16_t)code;
+      codes_si7021.t_code = (uint16_t)t_code;
+      si7021_i2c_read_rh_t(sensor, CODES_CB);
+      TEST_CHECK(sim_run_while(codes_pending, NULL, SIM_MS(1000)));
+      remove_scheduled_event(CODES_CB);
+      TEST_CHECK(si7021_status(sensor) == si7021_status_ok);
+
+      // fixed point: exactly floor(100 x the datasheet formula)
+      int64_t rh_centi = codes_floor_div((int64_t)12500 * code - (int64_t)600 * 65536);
+      int64_t t_centi = codes_floor_div((int64_t)17572 * t_code - (int64_t)4685 * 65536);
+      TEST_CHECK(si7021_calc_RH_centi(sensor) == rh_centi);
+      TEST_CHECK(si7021_calc_T_centi(sensor) == t_centi);
+
+      // floating point: within single precision rounding of the formula
+      double rh_exact = (125.0 * code / 65536) - 6;
+      double t_exact = (175.72 * t_code / 65536) - 46.85;
+      float rh = si7021_calc_RH(sensor);
+      float t = si7021_calc_T(sensor);
+      rh_err_max = fmax(rh_err_max, fabs(rh - rh_exact));
+      t_err_max = fmax(t_err_max, fabs(t - t_exact));
+      rh_float_differs += (floor(100.0 * rh) != rh_centi);
+      t_float_differs += (floor(100.0 * t) != t_centi);
+  }
+  uint64_t host_ns = test_host_ns() - host_start;
+
+  TEST_CHECK(rh_err_max <= CODES_FLOAT_TOL);
+  TEST_CHECK(t_err_max <= CODES_FLOAT_TOL);
+  TEST_CHECK(codes_si7021.conversions == CODES_COUNT);
+  TEST_CHECK(codes_si7021.early_reads == 0);
+  TEST_CHECK(codes_si7021.bad_cmds == 0);
+  printf("%u RH and T codes: fixed point exact; float error max %.2e %%RH, %.2e degC; "
+         "floor of 100x float differs for %u RH and %u T codes\n",
+         CODES_COUNT, rh_err_max, t_err_max, rh_float_differs, t_float_differs);
+  printf("%.1f us host per measurement through the bus\n", (double)host_ns / CODES_COUNT / 1000.0);
+
+  // conversions alone: the peripherals are paused so critical sections cost a call
+  sim_pause(true);
+  double rh_float_ns = codes_bench_float(si7021_calc_RH, sensor);
+  double t_float_ns = codes_bench_float(si7021_calc_T, sensor);
+  double rh_centi_ns = codes_bench_centi(si7021_calc_RH_centi, sensor);
+  double t_centi_ns = codes_bench_centi(si7021_calc_T_centi, sensor);
+  sim_pause(false);
+  printf("host ns per call: calc_RH %.1f, calc_RH_centi %.1f; calc_T %.1f, calc_T_centi %.1f\n",
+         rh_float_ns, rh_centi_ns, t_float_ns, t_centi_ns);
+
+  printf("PASS\n");
+  return 0;
+}
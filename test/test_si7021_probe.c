@@ -0,0 +1,199 @@
+/***************************************************************************//**
+ * @file
+ *   test_si7021_probe.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Si7021 identity probe with faults injected: a missing part, a bad
+ *   checksum and an unknown device
+ *
+ * @details
+ *   Four sensors are registered on one bus:
+ *   - a Si7021 with firmware 2.0, whose resolution is changed while it is
+ *     still being probed;
+ *   - an address nothing answers on: every address byte is NACKed;
+ *   - a Si7021 whose electronic serial number checksums are corrupted;
+ *   - a part reporting a device identification the driver does not know.
+ *
+ *   The probes must end ok, absent, invalid and unsupported, with the
+ *   identity of the good part decoded and cached and its resolution
+ *   written once its probe has ended. Each faulty part must have been
+ *   addressed exactly as often as its probe needed, and never again:
+ *   sampling rounds, measurements and resolution changes afterwards reach
+ *   only the good part.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "test_util.h"
+#include "si7021.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define PROBE_SENSORS       4                       // registered sensors
+#define PROBE_GOOD          0                       // sensor index: Si7021, fw 2.0
+#define PROBE_MISSING       1                       // sensor index: nothing at the address
+#define PROBE_BAD_CRC       2                       // sensor index: corrupt serial number checksums
+#define PROBE_UNKNOWN       3                       // sensor index: unknown device identification
+#define PROBE_UNKNOWN_DEV   0x33                    // SNB_3 of the unknown part
+#define PROBE_SAMPLE_CB(n)  (0x10UL << (n))         // si7021_sample_all() callback event of sensor n
+#define PROBE_RES_CB        0x100                   // callback event of the resolution change
+#define PROBE_READ_CB       0x200                   // callback event of a single measurement
+#define PROBE_ROUNDS        10                      // sampling rounds after the probes
+#define PROBE_NACK_ALL      0xFFFFFFFF              // register file slave: NACK every address byte
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+static SIM_SI7021_STRUCT probe_si[PROBE_SENSORS];         // slaves of the sensors that are there
+static SIM_MEM_STRUCT probe_missing;                      // stands in for the missing part, to count its addressing
+static uint32_t probe_sensor[PROBE_SENSORS];              // sensor handles
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   sim_run_while() conditions: a probe is pending; an event is not yet
+ *   scheduled
+ ******************************************************************************/
+static bool probe_probing(void *arg)
+{
+  (void)arg;
+  for(uint32_t n = 0; n < PROBE_SENSORS; n++)
+  {
+      if(si7021_identity(probe_sensor[n])->probe == si7021_probe_pending)
+      {
+          return true;
+      }
+  }
+  return false;
+}
+
+
+static bool probe_event_pending(void *event)
+{
+  return !(get_scheduled_events() & *(uint32_t *)event);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Runs the simulator until an event is scheduled, and takes it
+ ******************************************************************************/
+static void probe_wait(uint32_t event)
+{
+  TEST_CHECK(sim_run_while(probe_event_pending, &event, SIM_MS(1000)));
+  remove_scheduled_event(event);
+}
+
+
+int main(void)
+{
+  uint32_t acks[PROBE_SENSORS];
+
+  sim_init();
+  cmu_open();
+  scheduler_open();
+
+  // the sensors and the pull-ups run from SENSOR_EN, as on the board
+  GPIO_PinModeSet(gpioPortB, 10, gpioModePushPull, 0);
+  sim_bus_power_pin(0, gpioPortB, 10);
+  for(uint32_t n = 0; n < PROBE_SENSORS; n++)
+  {
+      if(n == PROBE_MISSING)
+      {
+          sim_mem_init(&probe_missing, SI7021_ADDR + n);
+          probe_missing.nack_addr = PROBE_NACK_ALL;
+          sim_bus_attach(0, &probe_missing.slave);
+          continue;
+      }
+      sim_si7021_init(&probe_si[n], SI7021_ADDR + n, 0);
+      sim_bus_attach(0, &probe_si[n].slave);
+  }
+  probe_si[PROBE_BAD_CRC].id_crc_xor = 0x01;
+  probe_si[PROBE_UNKNOWN].serial_b = (PROBE_UNKNOWN_DEV << 24) | (probe_si[PROBE_UNKNOWN].serial_b & 0x00FFFFFF);
+  GPIO_PinModeSet(gpioPortC, 11, gpioModeWiredAnd, 1);
+  GPIO_PinModeSet(gpioPortC, 10, gpioModeWiredAnd, 1);
+
+  // power up and register; the probes wait for the power-up time
+  si7021_power_on(true);
+  si7021_i2c_open(I2C0);
+  for(uint32_t n = 0; n < PROBE_SENSORS; n++)
+  {
+      probe_sensor[n] = si7021_register(I2C0, SI7021_ADDR + n, PROBE_SAMPLE_CB(n));
+  }
+
+  // a resolution change while the good part is still being probed waits for it
+  TEST_CHECK(si7021_identity(probe_sensor[PROBE_GOOD])->probe == si7021_probe_pending);
+  TEST_CHECK(si7021_set_resolution(probe_sensor[PROBE_GOOD], si7021_res_rh8_t12, PROBE_RES_CB));
+  TEST_CHECK(sim_run_while(probe_probing, NULL, SIM_MS(1000)));
+  probe_wait(PROBE_RES_CB);
+
+  // the good part: identified, identity cached, then the resolution written
+  const SI7021_ID_STRUCT *id = si7021_identity(probe_sensor[PROBE_GOOD]);
+  TEST_CHECK(id->probe == si7021_probe_ok);
+  TEST_CHECK((id->serial_a == probe_si[PROBE_GOOD].serial_a) && (id->serial_b == probe_si[PROBE_GOOD].serial_b));
+  TEST_CHECK((id->device == SI7021_DEV_SI7021) && (id->fw_rev == SI7021_FW_2_0));
+  TEST_CHECK(id->caps == (SI7021_CAP_RH | SI7021_CAP_T | SI7021_CAP_HEATER));
+  TEST_CHECK(probe_si[PROBE_GOOD].reg1 == ((SI7021_REG1_RESET & ~SI7021_REG1_RES_MASK) | si7021_res_rh8_t12));
+
+  // the faulty parts: the right verdict, each after the reads it needed
+  TEST_CHECK(si7021_identity(probe_sensor[PROBE_MISSING])->probe == si7021_probe_absent);
+  TEST_CHECK(si7021_identity(probe_sensor[PROBE_BAD_CRC])->probe == si7021_probe_invalid);
+  TEST_CHECK(si7021_identity(probe_sensor[PROBE_UNKNOWN])->probe == si7021_probe_unsupported);
+  TEST_CHECK(si7021_identity(probe_sensor[PROBE_UNKNOWN])->device == PROBE_UNKNOWN_DEV);
+  for(uint32_t n = PROBE_MISSING; n < PROBE_SENSORS; n++)
+  {
+      TEST_CHECK(si7021_status(probe_sensor[n]) == si7021_status_absent);
+  }
+  // SNA read addressed, first try and retry, then given up
+  TEST_CHECK((probe_missing.addr_nacks == (1 + SI7021_PROBE_RETRIES)) && (probe_missing.addr_acks == 0));
+  // SNA read: write and read address
+  TEST_CHECK(probe_si[PROBE_BAD_CRC].addr_acks == 2);
+  // SNA and SNB reads
+  TEST_CHECK(probe_si[PROBE_UNKNOWN].addr_acks == 4);
+  printf("probes: ok, absent after %u NACKed addresses, invalid after %u reads, unsupported (device 0x%02X) after %u\n",
+         probe_missing.addr_nacks, probe_si[PROBE_BAD_CRC].addr_acks / 2, PROBE_UNKNOWN_DEV,
+         probe_si[PROBE_UNKNOWN].addr_acks / 2);
+
+  // from here on, nothing but the good part is addressed
+  for(uint32_t n = 0; n < PROBE_SENSORS; n++)
+  {
+      acks[n] = probe_si[n].addr_acks;
+  }
+  uint32_t missing_nacks = probe_missing.addr_nacks;
+  for(uint32_t r = 0; r < PROBE_ROUNDS; r++)
+  {
+      TEST_CHECK(si7021_sample_all() == 1);
+      probe_wait(PROBE_SAMPLE_CB(PROBE_GOOD));
+      TEST_CHECK(si7021_status(probe_sensor[PROBE_GOOD]) == si7021_status_ok);
+  }
+  for(uint32_t n = PROBE_MISSING; n < PROBE_SENSORS; n++)
+  {
+      TEST_CHECK(!si7021_set_resolution(probe_sensor[n], si7021_res_rh12_t14, PROBE_RES_CB));
+      si7021_i2c_read_rh_t(probe_sensor[n], PROBE_READ_CB);
+      sim_run(SIM_MS(50));
+      TEST_CHECK(si7021_status(probe_sensor[n]) == si7021_status_absent);
+  }
+  remove_scheduled_event(PROBE_READ_CB);
+  TEST_CHECK(probe_si[PROBE_GOOD].conversions == PROBE_ROUNDS);
+  TEST_CHECK(probe_si[PROBE_GOOD].addr_acks > acks[PROBE_GOOD]);
+  TEST_CHECK(probe_missing.addr_nacks == missing_nacks);
+  TEST_CHECK(probe_si[PROBE_BAD_CRC].addr_acks == acks[PROBE_BAD_CRC]);
+  TEST_CHECK(probe_si[PROBE_UNKNOWN].addr_acks == acks[PROBE_UNKNOWN]);
+  TEST_CHECK((probe_si[PROBE_BAD_CRC].conversions == 0) && (probe_si[PROBE_UNKNOWN].conversions == 0));
+  TEST_CHECK((probe_si[PROBE_BAD_CRC].bad_cmds == 0) && (probe_si[PROBE_UNKNOWN].bad_cmds == 0));
+  printf("%u sampling rounds: %u conversions on the good part, none on the others, which were not addressed again\n",
+         PROBE_ROUNDS, probe_si[PROBE_GOOD].conversions);
+
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,197 @@
+/***************************************************************************//**
+ * @file
+ *   test_stats.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Streaming statistics against a brute-force recompute of the window
+ *
+ * @details
+ *   Feeds sample streams of every shape the monotonic queues care about
+ *   (uniform noise, rising and falling ramps, constant runs, alternating
+ *   extremes, and RH-like noise around 30.00 %RH) into stats_add(), one
+ *   stream per EWMA weight. After every sample the summary must equal a
+ *   recompute over the last STATS_WINDOW samples exactly: count, min, max,
+ *   the mean rounded toward zero and the population variance. The EWMA
+ *   must stay within STATS_EWMA_TOL of a double precision reference. Then
+ *   reports the host cost of stats_add().
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include <math.h>
+
+#include "test_util.h"
+#include "stats.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define STATS_SAMPLES       200000                  // samples per stream
+#define STATS_SEGMENT       (3 * STATS_WINDOW)      // samples per shape before the next one
+#define STATS_RANGE         30000                   // samples are within +/- this: the variance fits in 32 bits
+#define STATS_RH_CENTER     3000                    // RH-like shape: 30.00 %RH ...
+#define STATS_RH_NOISE      60                      // ... +/- 0.60 %RH
+#define STATS_EWMA_TOL      2                       // EWMA against the reference, in sample units
+#define STATS_BENCH_SAMPLES (1 << 22)               // samples in the benchmark
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+// shape of a stretch of samples
+typedef enum
+{
+  stats_shape_uniform,      /* uniform over the whole range */
+  stats_shape_rising,       /* ramp up: every sample is a new maximum */
+  stats_shape_falling,      /* ramp down: every sample is a new minimum */
+  stats_shape_constant,     /* one value repeated: ties in both queues */
+  stats_shape_alternating,  /* the two extremes in turn */
+  stats_shape_rh,           /* RH noise around the LED threshold */
+  stats_shape_count,
+}STATS_SHAPE_Typedef;
+
+
+//***********************************************************************************
+// private data
+//***********************************************************************************
+static uint32_t stats_seed = 12345;                       // sample generator
+static const uint32_t stats_shifts[] = { 0, 3, 6 };       // EWMA weights under test; 3 is the app's
+static volatile int32_t stats_sink;
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+static uint32_t stats_random(uint32_t range)
+{
+  stats_seed = (stats_seed * 1103515245UL) + 12345UL;
+  return (stats_seed >> 8) % range;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sample n of a stream
+ ******************************************************************************/
+static int32_t stats_sample(uint32_t n)
+{
+  STATS_SHAPE_Typedef shape = (STATS_SHAPE_Typedef)((n / STATS_SEGMENT) % stats_shape_count);
+  int32_t step = (int32_t)(n % STATS_SEGMENT);
+
+  switch(shape)
+  {
+    case stats_shape_rising:
+      return -STATS_RANGE + (step * ((2 * STATS_RANGE) / STATS_SEGMENT));
+    case stats_shape_falling:
+      return STATS_RANGE - (step * ((2 * STATS_RANGE) / STATS_SEGMENT));
+    case stats_shape_constant:
+      return (int32_t)(n / STATS_SEGMENT) - STATS_RANGE / 2;
+    case stats_shape_alternating:
+      return (step & 1) ? STATS_RANGE : -STATS_RANGE;
+    case stats_shape_rh:
+      return STATS_RH_CENTER - STATS_RH_NOISE + (int32_t)stats_random((2 * STATS_RH_NOISE) + 1);
+    default:
+      return (int32_t)stats_random((2 * STATS_RANGE) + 1) - STATS_RANGE;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Summary of the last count samples, recomputed from scratch
+ ******************************************************************************/
+static void stats_brute(const int32_t *window, uint32_t count, STATS_SUMMARY_STRUCT *summary)
+{
+  int64_t sum = 0;
+  int64_t dev_sq = 0;
+
+  summary->count = count;
+  summary->min = window[0];
+  summary->max = window[0];
+  for(uint32_t i = 0; i < count; i++)
+  {
+      sum += window[i];
+      summary->min = (window[i] < summary->min) ? window[i] : summary->min;
+      summary->max = (window[i] > summary->max) ? window[i] : summary->max;
+  }
+  summary->mean = (int32_t)(sum / count);
+
+  // two-pass population variance, exact in rationals: sum((n x - sum)^2) / n^3
+  for(uint32_t i = 0; i < count; i++)
+  {
+      int64_t dev = ((int64_t)count * window[i]) - sum;
+      dev_sq += dev * dev;
+  }
+  summary->variance = (int32_t)(dev_sq / ((int64_t)count * count * count));
+}
+
+
+int main(void)
+{
+  static STATS_STRUCT stats;
+  STATS_SUMMARY_STRUCT got;
+  STATS_SUMMARY_STRUCT want;
+  int32_t window[STATS_WINDOW];
+
+  for(uint32_t s = 0; s < sizeof(stats_shifts) / sizeof(stats_shifts[0]); s++)
+  {
+      uint32_t shift = stats_shifts[s];
+      double ewma_ref = 0;
+      double ewma_err_max = 0;
+
+      stats_init(&stats, shift);
+      TEST_CHECK(!stats_summary(&stats, &got));
+
+      for(uint32_t n = 0; n < STATS_SAMPLES; n++)
+      {
+          int32_t sample = stats_sample(n);
+          stats_add(&stats, sample);
+
+          // the last STATS_WINDOW samples, oldest first
+          uint32_t count = (n < STATS_WINDOW) ? n + 1 : STATS_WINDOW;
+          if(n >= STATS_WINDOW)
+          {
+              for(uint32_t i = 1; i < STATS_WINDOW; i++)
+              {
+                  window[i - 1] = window[i];
+              }
+          }
+          window[count - 1] = sample;
+
+          TEST_CHECK(stats_summary(&stats, &got));
+          stats_brute(window, count, &want);
+          TEST_CHECK(got.count == want.count);
+          TEST_CHECK(got.min == want.min);
+          TEST_CHECK(got.max == want.max);
+          TEST_CHECK(got.mean == want.mean);
+          TEST_CHECK(got.variance == want.variance);
+
+          // the first sample seeds the reference as it does the EWMA
+          ewma_ref = n ? ewma_ref + ((sample - ewma_ref) / (double)(1UL << shift)) : sample;
+          ewma_err_max = fmax(ewma_err_max, fabs(got.ewma - ewma_ref));
+      }
+      TEST_CHECK(ewma_err_max <= STATS_EWMA_TOL);
+      printf("EWMA 1/%u: %u samples, window summaries exact; EWMA error max %.2f\n",
+             1U << shift, STATS_SAMPLES, ewma_err_max);
+  }
+
+  // stats_add() alone
+  stats_init(&stats, stats_shifts[1]);
+  uint64_t start = test_host_ns();
+  for(uint32_t n = 0; n < STATS_BENCH_SAMPLES; n++)
+  {
+      stats_add(&stats, (int32_t)(n * 2654435761UL) >> 17);
+  }
+  uint64_t host_ns = test_host_ns() - start;
+  TEST_CHECK(stats_summary(&stats, &got));
+  stats_sink = got.variance;
+  printf("%.1f ns host per stats_add()\n", (double)host_ns / STATS_BENCH_SAMPLES);
+
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,109 @@
+/***************************************************************************//**
+ * @file
+ *   test_util.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   10/16/2026
+ * @brief
+ *   Checks and bus set-up shared by the host tests
+ ******************************************************************************/
+#ifndef TEST_UTIL_HG
+#define TEST_UTIL_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// developer included files
+#include "sim.h"
+#include "i2c.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+// fail the test, with the condition and its location, unless cond holds
+#define TEST_CHECK(cond)    do { if(!(cond)) { sim_fail("%s:%d: %s", __FILE__, __LINE__, #cond); } } while(0)
+#define TEST_MEM_ADDR       0x50                    // address of the register file slave
+#define TEST_TXN_TIMEOUT    SIM_MS(1000)            // longest a single transaction may take
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   Opens I2Cn at 392 kHz, 6:3, the way si7021_i2c_open() does
+ ******************************************************************************/
+static inline void test_i2c_open(I2C_TypeDef *i2c, uint32_t clto)
+{
+  I2C_OPEN_STRUCT app_i2c_open =
+  {
+      .enable = true,
+      .master = true,
+      .refFreq = I2C_PROFILE_REFFREQ,
+      .freq = I2C_FREQ,
+      .clhr = I2C_CLHR_6_3,
+      .scl_loc0 = I2C_SCL_ROUTE,
+      .sda_loc0 = I2C_SDA_ROUTE,
+      .scl_pen = I2C_SCL_PEN,
+      .sda_pen = I2C_SDA_PEN,
+      .scl_port = gpioPortC,
+      .scl_pin = 11,
+      .sda_port = gpioPortC,
+      .sda_pin = 10,
+      .clto = clto,
+  };
+
+  // the pins as gpio_open() leaves them
+  GPIO_PinModeSet(gpioPortC, 11, gpioModeWiredAnd, 1);
+  GPIO_PinModeSet(gpioPortC, 10, gpioModeWiredAnd, 1);
+  i2c_open(i2c, &app_i2c_open);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   sim_run_while() condition: a transaction has not completed
+ ******************************************************************************/
+static inline bool test_txn_pending(void *txn)
+{
+  return ((I2C_TRANSACTION_STRUCT *)txn)->status == i2c_status_pending;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Submits a transaction and runs the simulator until it completes
+ *
+ * @return
+ *   Completion status
+ ******************************************************************************/
+static inline I2C_STATUS_Typedef test_txn_run(I2C_TypeDef *i2c, I2C_TRANSACTION_STRUCT *txn)
+{
+  TEST_CHECK(i2c_init_sm(i2c, txn));
+  TEST_CHECK(sim_run_while(test_txn_pending, txn, TEST_TXN_TIMEOUT));
+  return txn->status;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Host monotonic clock in nanoseconds
+ ******************************************************************************/
+static inline uint64_t test_host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+#endif